@@ -0,0 +1,317 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unistd.h>
+#include <json/json.h>
+
+// Utilidades de medición para los experimentos: reloj en nanosegundos, lotes
+// con número de iteraciones calibrado (así operaciones de decenas de ns se
+// miden sin truncar), calentamiento explícito, corridas en frío vaciando la
+// caché, intervalos de confianza y la prueba de Welch para comparar motores.
+
+// Reloj monotónico en nanosegundos
+inline uint64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Impide que el compilador descarte un resultado que no se usa
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Función beta incompleta regularizada I_x(a, b) por fracción continua (Lentz)
+inline double incompleteBeta(double a, double b, double x) {
+    if (x <= 0.0) {
+        return 0.0;
+    }
+    if (x >= 1.0) {
+        return 1.0;
+    }
+    // La fracción converge rápido para x < (a + 1) / (a + b + 2); si no, por simetría
+    if (x > (a + 1.0) / (a + b + 2.0)) {
+        return 1.0 - incompleteBeta(b, a, 1.0 - x);
+    }
+
+    const double tiny = 1e-300;
+    double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) +
+                            a * std::log(x) + b * std::log(1.0 - x)) / a;
+    double c = 1.0;
+    double d = 1.0 - (a + b) * x / (a + 1.0);
+    d = 1.0 / (std::abs(d) < tiny ? tiny : d);
+    double f = d;
+    for (int m = 1; m <= 300; m++) {
+        // Términos par e impar de la fracción
+        double numerator = m * (b - m) * x / ((a + 2.0 * m - 1.0) * (a + 2.0 * m));
+        d = 1.0 + numerator * d;
+        d = 1.0 / (std::abs(d) < tiny ? tiny : d);
+        c = 1.0 + numerator / (std::abs(c) < tiny ? tiny : c);
+        f *= c * d;
+
+        numerator = -(a + m) * (a + b + m) * x / ((a + 2.0 * m) * (a + 2.0 * m + 1.0));
+        d = 1.0 + numerator * d;
+        d = 1.0 / (std::abs(d) < tiny ? tiny : d);
+        c = 1.0 + numerator / (std::abs(c) < tiny ? tiny : c);
+        double delta = c * d;
+        f *= delta;
+        if (std::abs(delta - 1.0) < 1e-12) {
+            break;
+        }
+    }
+    return front * f;
+}
+
+// P(|T| >= t) para una t de Student con `df` grados de libertad
+inline double studentTwoSidedP(double t, double df) {
+    if (!(df > 0) || std::isnan(t)) {
+        return 1.0;
+    }
+    return incompleteBeta(df / 2.0, 0.5, df / (df + t * t));
+}
+
+// Valor crítico t de dos colas para un nivel de confianza (0.95 = 95%), por bisección
+inline double studentCritical(double df, double confidence = 0.95) {
+    double alpha = 1.0 - confidence;
+    double lo = 0.0;
+    double hi = 1000.0;
+    for (int i = 0; i < 100; i++) {
+        double mid = (lo + hi) / 2.0;
+        if (studentTwoSidedP(mid, df) > alpha) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo + hi) / 2.0;
+}
+
+// Resumen de una medición; los tiempos son ns por operación de cada muestra
+struct BenchStats {
+    std::string name;
+    bool cold;             // Muestras tomadas con la caché vaciada
+    long long iterations;  // Operaciones por muestra
+    std::vector<double> values;
+    double mean;
+    double stddev;         // Desviación estándar muestral
+    double ci95;           // Semiamplitud del intervalo de confianza del 95% de la media
+    double median;
+    double p90;
+    double p99;
+    double min;
+    double max;
+
+    BenchStats()
+        : cold(false), iterations(0), mean(0), stddev(0), ci95(0), median(0), p90(0), p99(0), min(0), max(0) {}
+};
+
+inline BenchStats summarizeBench(const std::string& name, const std::vector<double>& values, long long iterations,
+                                 bool cold) {
+    BenchStats stats;
+    stats.name = name;
+    stats.cold = cold;
+    stats.iterations = iterations;
+    stats.values = values;
+    if (values.empty()) {
+        return stats;
+    }
+
+    std::vector<double> sorted(values);
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+    stats.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / n;
+    double var = 0.0;
+    for (double value : sorted) {
+        var += (value - stats.mean) * (value - stats.mean);
+    }
+    stats.stddev = n > 1 ? std::sqrt(var / (n - 1)) : 0.0;
+    stats.ci95 = n > 1 ? studentCritical(n - 1.0) * stats.stddev / std::sqrt(static_cast<double>(n)) : 0.0;
+    stats.median = sorted[n / 2];
+    stats.p90 = sorted[std::min(n - 1, static_cast<size_t>(n * 0.9))];
+    stats.p99 = sorted[std::min(n - 1, static_cast<size_t>(n * 0.99))];
+    stats.min = sorted.front();
+    stats.max = sorted.back();
+    return stats;
+}
+
+// Resultado de la prueba t de Welch (varianzas distintas) entre dos mediciones
+struct WelchResult {
+    double t;
+    double df;
+    double p_value; // Dos colas
+
+    bool significant(double alpha = 0.05) const {
+        return p_value < alpha;
+    }
+};
+
+inline WelchResult welchTest(const std::vector<double>& a, const std::vector<double>& b) {
+    WelchResult result = {0.0, 0.0, 1.0};
+    if (a.size() < 2 || b.size() < 2) {
+        return result;
+    }
+    BenchStats sa = summarizeBench("", a, 0, false);
+    BenchStats sb = summarizeBench("", b, 0, false);
+    double va = sa.stddev * sa.stddev / a.size();
+    double vb = sb.stddev * sb.stddev / b.size();
+    if (va + vb <= 0.0) {
+        result.p_value = sa.mean == sb.mean ? 1.0 : 0.0;
+        return result;
+    }
+    result.t = (sa.mean - sb.mean) / std::sqrt(va + vb);
+    result.df = (va + vb) * (va + vb) / (va * va / (a.size() - 1) + vb * vb / (b.size() - 1));
+    result.p_value = studentTwoSidedP(result.t, result.df);
+    return result;
+}
+
+// Vacía la caché recorriendo (y escribiendo) un búfer mayor que el último
+// nivel de caché, así la siguiente operación encuentra sus datos en memoria
+class CacheFlusher {
+private:
+    std::vector<char> buffer;
+    char sink;
+
+public:
+    // `bytes` = 0: el doble de la caché de último nivel (64 MB si no se conoce)
+    explicit CacheFlusher(size_t bytes = 0) : sink(0) {
+        if (bytes == 0) {
+            long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+            if (llc <= 0) {
+                llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+            }
+            bytes = llc > 0 ? 2 * static_cast<size_t>(llc) : (64u << 20);
+        }
+        buffer.assign(bytes, 1);
+    }
+
+    void flush() {
+        for (size_t i = 0; i < buffer.size(); i += 64) {
+            buffer[i] += sink;
+            sink ^= buffer[i];
+        }
+        doNotOptimize(sink);
+    }
+
+    size_t size() const {
+        return buffer.size();
+    }
+};
+
+// Parámetros de una medición
+struct BenchOptions {
+    int samples;         // Muestras cronometradas
+    int warmup;          // Lotes de calentamiento sin medir
+    double min_batch_us; // Duración mínima de una muestra en caliente (calibra las iteraciones)
+    bool cold;           // Una operación por muestra tras vaciar la caché
+
+    explicit BenchOptions(int samples = 30, int warmup = 3, double min_batch_us = 200.0, bool cold = false)
+        : samples(samples), warmup(warmup), min_batch_us(min_batch_us), cold(cold) {}
+};
+
+// Medir `op(i)` (i crece en cada llamada, p. ej. para rotar las consultas).
+// En caliente se duplica el número de iteraciones hasta que un lote dura al
+// menos min_batch_us, se descartan `warmup` lotes y cada muestra es el tiempo
+// medio por operación de un lote. En frío cada muestra es una sola operación
+// después de flusher.flush() (el vaciado no se cronometra).
+template <typename Op>
+BenchStats runBenchmark(const std::string& name, Op op, const BenchOptions& options,
+                        CacheFlusher* flusher = nullptr) {
+    long long next = 0;
+    std::vector<double> values;
+
+    if (options.cold) {
+        std::unique_ptr<CacheFlusher> owned;
+        if (!flusher) {
+            owned.reset(new CacheFlusher());
+            flusher = owned.get();
+        }
+        for (int s = 0; s < options.samples; s++) {
+            flusher->flush();
+            uint64_t start = nowNanos();
+            op(next++);
+            values.push_back(static_cast<double>(nowNanos() - start));
+        }
+        return summarizeBench(name, values, 1, true);
+    }
+
+    long long iterations = 1;
+    const long long max_iterations = 1LL << 24;
+    while (iterations < max_iterations) {
+        uint64_t start = nowNanos();
+        for (long long i = 0; i < iterations; i++) {
+            op(next++);
+        }
+        if ((nowNanos() - start) >= options.min_batch_us * 1000.0) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    for (int w = 0; w < options.warmup; w++) {
+        for (long long i = 0; i < iterations; i++) {
+            op(next++);
+        }
+    }
+
+    for (int s = 0; s < options.samples; s++) {
+        uint64_t start = nowNanos();
+        for (long long i = 0; i < iterations; i++) {
+            op(next++);
+        }
+        values.push_back(static_cast<double>(nowNanos() - start) / iterations);
+    }
+    return summarizeBench(name, values, iterations, false);
+}
+
+// Guardar mediciones en CSV (una fila por medición, tiempos en ns)
+inline void writeBenchCsv(const std::string& filename, const std::vector<BenchStats>& results) {
+    std::ofstream file(filename);
+    file << "Name,Mode,Samples,Iterations,Mean_ns,StdDev_ns,CI95_ns,Median_ns,P90_ns,P99_ns,Min_ns,Max_ns\n";
+    for (const auto& stats : results) {
+        file << stats.name << "," << (stats.cold ? "cold" : "warm") << "," << stats.values.size() << ","
+             << stats.iterations << "," << stats.mean << "," << stats.stddev << "," << stats.ci95 << ","
+             << stats.median << "," << stats.p90 << "," << stats.p99 << "," << stats.min << "," << stats.max << "\n";
+    }
+}
+
+// Guardar mediciones en JSON, con las muestras crudas
+inline void writeBenchJson(const std::string& filename, const std::vector<BenchStats>& results) {
+    Json::Value root(Json::arrayValue);
+    for (const auto& stats : results) {
+        Json::Value entry;
+        entry["name"] = stats.name;
+        entry["mode"] = stats.cold ? "cold" : "warm";
+        entry["iterations"] = static_cast<Json::Int64>(stats.iterations);
+        entry["mean_ns"] = stats.mean;
+        entry["stddev_ns"] = stats.stddev;
+        entry["ci95_ns"] = stats.ci95;
+        entry["median_ns"] = stats.median;
+        entry["p90_ns"] = stats.p90;
+        entry["p99_ns"] = stats.p99;
+        entry["min_ns"] = stats.min;
+        entry["max_ns"] = stats.max;
+        Json::Value samples(Json::arrayValue);
+        for (double value : stats.values) {
+            samples.append(value);
+        }
+        entry["samples_ns"] = samples;
+        root.append(entry);
+    }
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "  ";
+    std::ofstream file(filename);
+    file << Json::writeString(builder, root) << "\n";
+}
+
+#endif // BENCHMARK_H
\ No newline at end of file
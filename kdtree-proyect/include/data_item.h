@@ -0,0 +1,14 @@
+#ifndef DATA_ITEM_H
+#define DATA_ITEM_H
+
+#include <string>
+#include <Eigen/Dense>
+
+using Point = Eigen::VectorXd;
+
+struct DataItem {
+    std::string text;
+    Point embedding;
+};
+
+#endif // DATA_ITEM_H
\ No newline at end of file
@@ -0,0 +1,383 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <cstdint>
+
+// Kernels de distancia euclidiana al cuadrado y producto punto sobre arreglos
+// contiguos (el producto punto es el de las métricas coseno y producto
+// interno, ver Metric en vector_store.h). Se elige en compilación la
+// implementación SIMD disponible (AVX-512, AVX2+FMA o NEON) con un resto
+// escalar; definir KDTREE_NO_SIMD fuerza la versión escalar.
+//
+// Cada kernel recibe además la longitud como parámetro de plantilla: con N > 0
+// el número de elementos es una constante (el argumento `n` se ignora), los
+// bucles tienen trip count conocido y el compilador los desenrolla y elimina
+// los restos; N = 0 (el valor por omisión) usa `n`. dispatchDimension elige la
+// instancia para las dimensiones comunes; definir KDTREE_NO_FIXED_DIMS deja
+// solo la versión dinámica.
+
+#if !defined(KDTREE_NO_SIMD)
+#if defined(__AVX512F__)
+#define KDTREE_SIMD_AVX512 1
+#include <immintrin.h>
+#elif defined(__AVX2__) && defined(__FMA__)
+#define KDTREE_SIMD_AVX2 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define KDTREE_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+// Nombre de la implementación compilada (para los reportes de experimentos)
+inline const char* simdKernelName() {
+#if defined(KDTREE_SIMD_AVX512)
+    return "avx512";
+#elif defined(KDTREE_SIMD_AVX2)
+    return "avx2";
+#elif defined(KDTREE_SIMD_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+#if defined(KDTREE_SIMD_AVX2) || defined(KDTREE_SIMD_AVX512)
+inline float horizontalSum(__m256 v) {
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 0x55));
+    return _mm_cvtss_f32(lo);
+}
+
+inline double horizontalSum(__m256d v) {
+    __m128d lo = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    lo = _mm_add_sd(lo, _mm_unpackhi_pd(lo, lo));
+    return _mm_cvtsd_f64(lo);
+}
+#endif
+
+#if defined(KDTREE_SIMD_AVX512)
+// Reducciones vía memoria: los intrínsecos de extracción/reducción de 512 bits
+// disparan un falso -Wuninitialized en GCC 12
+inline float horizontalSum(__m512 v) {
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, v);
+    return horizontalSum(_mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8)));
+}
+
+inline double horizontalSum(__m512d v) {
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, v);
+    return horizontalSum(_mm256_add_pd(_mm256_load_pd(lanes), _mm256_load_pd(lanes + 4)));
+}
+#endif
+
+template <int N = 0>
+inline double squaredL2Distance(const double* a, const double* b, int n) {
+    n = N > 0 ? N : n;
+    int i = 0;
+    double sum = 0.0;
+#if defined(KDTREE_SIMD_AVX512)
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+    for (; i + 16 <= n; i += 16) {
+        __m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+        __m512d d1 = _mm512_sub_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8));
+        acc0 = _mm512_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm512_fmadd_pd(d1, d1, acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m512d d = _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+        acc0 = _mm512_fmadd_pd(d, d, acc0);
+    }
+    sum = horizontalSum(_mm512_add_pd(acc0, acc1));
+#elif defined(KDTREE_SIMD_AVX2)
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    for (; i + 8 <= n; i += 8) {
+        __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+        __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4));
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm256_fmadd_pd(d1, d1, acc1);
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m256d d = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+        acc0 = _mm256_fmadd_pd(d, d, acc0);
+    }
+    sum = horizontalSum(_mm256_add_pd(acc0, acc1));
+#elif defined(KDTREE_SIMD_NEON)
+    float64x2_t acc0 = vdupq_n_f64(0.0), acc1 = vdupq_n_f64(0.0);
+    for (; i + 4 <= n; i += 4) {
+        float64x2_t d0 = vsubq_f64(vld1q_f64(a + i), vld1q_f64(b + i));
+        float64x2_t d1 = vsubq_f64(vld1q_f64(a + i + 2), vld1q_f64(b + i + 2));
+        acc0 = vfmaq_f64(acc0, d0, d0);
+        acc1 = vfmaq_f64(acc1, d1, d1);
+    }
+    sum = vaddvq_f64(vaddq_f64(acc0, acc1));
+#endif
+    for (; i < n; i++) {
+        double d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+template <int N = 0>
+inline float squaredL2Distance(const float* a, const float* b, int n) {
+    n = N > 0 ? N : n;
+    int i = 0;
+    float sum = 0.0f;
+#if defined(KDTREE_SIMD_AVX512)
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    for (; i + 32 <= n; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m512 d = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        acc0 = _mm512_fmadd_ps(d, d, acc0);
+    }
+    sum = horizontalSum(_mm512_add_ps(acc0, acc1));
+#elif defined(KDTREE_SIMD_AVX2)
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        acc0 = _mm256_fmadd_ps(d, d, acc0);
+    }
+    sum = horizontalSum(_mm256_add_ps(acc0, acc1));
+#elif defined(KDTREE_SIMD_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+        float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        acc0 = vfmaq_f32(acc0, d0, d0);
+        acc1 = vfmaq_f32(acc1, d1, d1);
+    }
+    sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+    for (; i < n; i++) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+// Distancia sobre códigos int8 con escala por dimensión.
+// `q` es la consulta ya dividida por la escala y `w` la escala al cuadrado:
+// sum_i (q_i * s_i - c_i * s_i)^2 = sum_i w_i * (q_i - c_i)^2
+template <int N = 0>
+inline float squaredL2Distance(const float* q, const int8_t* codes, const float* w, int n) {
+    n = N > 0 ? N : n;
+    int i = 0;
+    float sum = 0.0f;
+#if defined(KDTREE_SIMD_AVX512)
+    __m512 acc = _mm512_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        __m512 c = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i))));
+        __m512 d = _mm512_sub_ps(_mm512_loadu_ps(q + i), c);
+        acc = _mm512_fmadd_ps(_mm512_mul_ps(d, _mm512_loadu_ps(w + i)), d, acc);
+    }
+    sum = horizontalSum(acc);
+#elif defined(KDTREE_SIMD_AVX2)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m256 c = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(codes + i))));
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(q + i), c);
+        acc = _mm256_fmadd_ps(_mm256_mul_ps(d, _mm256_loadu_ps(w + i)), d, acc);
+    }
+    sum = horizontalSum(acc);
+#elif defined(KDTREE_SIMD_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t c16 = vmovl_s8(vld1_s8(codes + i));
+        float32x4_t c0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16(c16)));
+        float32x4_t c1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(c16)));
+        float32x4_t d0 = vsubq_f32(vld1q_f32(q + i), c0);
+        float32x4_t d1 = vsubq_f32(vld1q_f32(q + i + 4), c1);
+        acc = vfmaq_f32(acc, vmulq_f32(d0, vld1q_f32(w + i)), d0);
+        acc = vfmaq_f32(acc, vmulq_f32(d1, vld1q_f32(w + i + 4)), d1);
+    }
+    sum = vaddvq_f32(acc);
+#endif
+    for (; i < n; i++) {
+        float d = q[i] - static_cast<float>(codes[i]);
+        sum += w[i] * d * d;
+    }
+    return sum;
+}
+
+template <int N = 0>
+inline double dotProduct(const double* a, const double* b, int n) {
+    n = N > 0 ? N : n;
+    int i = 0;
+    double sum = 0.0;
+#if defined(KDTREE_SIMD_AVX512)
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+        acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+    }
+    sum = horizontalSum(_mm512_add_pd(acc0, acc1));
+#elif defined(KDTREE_SIMD_AVX2)
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), acc1);
+    }
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+    }
+    sum = horizontalSum(_mm256_add_pd(acc0, acc1));
+#elif defined(KDTREE_SIMD_NEON)
+    float64x2_t acc0 = vdupq_n_f64(0.0), acc1 = vdupq_n_f64(0.0);
+    for (; i + 4 <= n; i += 4) {
+        acc0 = vfmaq_f64(acc0, vld1q_f64(a + i), vld1q_f64(b + i));
+        acc1 = vfmaq_f64(acc1, vld1q_f64(a + i + 2), vld1q_f64(b + i + 2));
+    }
+    sum = vaddvq_f64(vaddq_f64(acc0, acc1));
+#endif
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+template <int N = 0>
+inline float dotProduct(const float* a, const float* b, int n) {
+    n = N > 0 ? N : n;
+    int i = 0;
+    float sum = 0.0f;
+#if defined(KDTREE_SIMD_AVX512)
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    }
+    sum = horizontalSum(_mm512_add_ps(acc0, acc1));
+#elif defined(KDTREE_SIMD_AVX2)
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    sum = horizontalSum(_mm256_add_ps(acc0, acc1));
+#elif defined(KDTREE_SIMD_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Producto punto con códigos int8: `q` es la consulta ya multiplicada por la
+// escala, así q.x = sum_i (q_i * s_i) * c_i
+template <int N = 0>
+inline float dotProduct(const float* q, const int8_t* codes, int n) {
+    n = N > 0 ? N : n;
+    int i = 0;
+    float sum = 0.0f;
+#if defined(KDTREE_SIMD_AVX512)
+    __m512 acc = _mm512_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        __m512 c = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + i))));
+        acc = _mm512_fmadd_ps(_mm512_loadu_ps(q + i), c, acc);
+    }
+    sum = horizontalSum(acc);
+#elif defined(KDTREE_SIMD_AVX2)
+    __m256 acc = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m256 c = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(codes + i))));
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(q + i), c, acc);
+    }
+    sum = horizontalSum(acc);
+#elif defined(KDTREE_SIMD_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t c16 = vmovl_s8(vld1_s8(codes + i));
+        acc = vfmaq_f32(acc, vld1q_f32(q + i), vcvtq_f32_s32(vmovl_s16(vget_low_s16(c16))));
+        acc = vfmaq_f32(acc, vld1q_f32(q + i + 4), vcvtq_f32_s32(vmovl_s16(vget_high_s16(c16))));
+    }
+    sum = vaddvq_f32(acc);
+#endif
+    for (; i < n; i++) {
+        sum += q[i] * static_cast<float>(codes[i]);
+    }
+    return sum;
+}
+
+// Distancia asimétrica de un código de cuantización por producto (IVF-PQ): la
+// suma de table[j * ksub + codes[j]] sobre los `m` subespacios, donde la tabla
+// tiene la distancia de la consulta a cada centroide de cada subespacio. Con
+// AVX-512/AVX2 se leen 16/8 entradas de la tabla por instrucción (gather)
+inline float adcDistance(const float* table, const uint8_t* codes, int m, int ksub) {
+    int j = 0;
+    float sum = 0.0f;
+#if defined(KDTREE_SIMD_AVX512)
+    __m512 acc = _mm512_setzero_ps();
+    const __m512i lanes = _mm512_mullo_epi32(
+        _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0), _mm512_set1_epi32(ksub));
+    for (; j + 16 <= m; j += 16) {
+        __m512i index = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + j)));
+        index = _mm512_add_epi32(index, _mm512_add_epi32(lanes, _mm512_set1_epi32(j * ksub)));
+        acc = _mm512_add_ps(acc, _mm512_i32gather_ps(index, table, 4));
+    }
+    sum = horizontalSum(acc);
+#elif defined(KDTREE_SIMD_AVX2)
+    __m256 acc = _mm256_setzero_ps();
+    const __m256i lanes = _mm256_mullo_epi32(_mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0), _mm256_set1_epi32(ksub));
+    for (; j + 8 <= m; j += 8) {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(codes + j)));
+        index = _mm256_add_epi32(index, _mm256_add_epi32(lanes, _mm256_set1_epi32(j * ksub)));
+        acc = _mm256_add_ps(acc, _mm256_i32gather_ps(table, index, 4));
+    }
+    sum = horizontalSum(acc);
+#endif
+    for (; j < m; j++) {
+        sum += table[j * ksub + codes[j]];
+    }
+    return sum;
+}
+
+// Llamar a fn.template run<N>() con N = dims si es una de las dimensiones con
+// instancia propia (128, 384, 768: elementos por fila, ya con el relleno del
+// almacén), o con N = 0 (longitud dinámica) en otro caso. Se despacha una vez
+// por consulta, fuera de los bucles calientes
+template <typename Fn>
+inline void dispatchDimension(int dims, const Fn& fn) {
+    switch (dims) {
+#if !defined(KDTREE_NO_FIXED_DIMS)
+        case 128: fn.template run<128>(); break;
+        case 384: fn.template run<384>(); break;
+        case 768: fn.template run<768>(); break;
+#endif
+        default: fn.template run<0>(); break;
+    }
+}
+
+#endif // DISTANCE_H
\ No newline at end of file
@@ -0,0 +1,577 @@
+#ifndef DYNAMIC_KDTREE_H
+#define DYNAMIC_KDTREE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <cmath>
+#include <iostream>
+#include "kdtree.h"
+#include "distance.h"
+#include "topk.h"
+
+// Parámetros del índice dinámico
+struct DynamicKDTreeOptions {
+    KDTreeOptions tree;       // Parámetros de los árboles de cada segmento
+    int buffer_size;          // Inserciones buscadas por fuerza bruta antes de sellarse en un árbol
+    double merge_ratio;       // Un segmento se fusiona con los más nuevos si no supera merge_ratio veces su total
+    double max_deleted_ratio; // Fracción de borrados que dispara la reconstrucción de un segmento
+    bool background;          // Fusiones en un hilo de fondo (false = en el hilo que escribe)
+
+    explicit DynamicKDTreeOptions(const KDTreeOptions& tree = KDTreeOptions(), int buffer_size = 256,
+                                  double merge_ratio = 2.0, double max_deleted_ratio = 0.25,
+                                  bool background = true)
+        : tree(tree), buffer_size(buffer_size), merge_ratio(merge_ratio),
+          max_deleted_ratio(max_deleted_ratio), background(background) {}
+};
+
+// KD-tree con inserciones y borrados en línea, estructurado como un log de
+// segmentos inmutables (método logarítmico de Bentley-Saxe):
+//
+//   - Las inserciones van a un búfer que se busca por fuerza bruta; cuando se
+//     llena se sella en un KD-tree pequeño al final de la lista de segmentos.
+//   - Los borrados marcan el id en un mapa de bits de lápidas; las búsquedas
+//     filtran los segmentos con kNearestFiltered, así la poda no cambia.
+//   - En segundo plano, los segmentos más nuevos se fusionan mientras el
+//     anterior no sea mucho mayor que su total (hay O(log n) segmentos y cada
+//     punto se reconstruye O(log n) veces), y un segmento con demasiadas
+//     lápidas se reconstruye solo, sin tocar el resto.
+//
+// Todo vive en una instantánea inmutable que los escritores reemplazan de forma
+// atómica: una búsqueda toma la instantánea vigente y la recorre completa, sin
+// bloqueos y sin ver escrituras a medias, aunque en paralelo se inserte, se
+// borre o se fusione. Los ids son globales y crecientes (los de la carga
+// inicial coinciden con las posiciones de la base) y nunca se reutilizan.
+class DynamicKDTree {
+private:
+    // Segmento inmutable: los registros (el árbol no guarda textos, y los
+    // vectores exactos sirven para reconstruirlo) y el id global de cada fila
+    struct Segment {
+        std::vector<DataItem> items;
+        std::vector<int> ids; // Crecientes
+        std::unique_ptr<KDTree> tree;
+
+        // Fila local de `id` o -1
+        int local(int id) const {
+            std::vector<int>::const_iterator it = std::lower_bound(ids.begin(), ids.end(), id);
+            return (it != ids.end() && *it == id) ? static_cast<int>(it - ids.begin()) : -1;
+        }
+    };
+
+    // Búfer de inserciones: tiene su capacidad desde el principio y los
+    // escritores solo llenan ranuras nuevas, así una instantánea lee sus
+    // primeras `buffered` ranuras mientras se escriben las siguientes
+    struct Buffer {
+        std::vector<DataItem> items;
+
+        explicit Buffer(int capacity) : items(capacity) {}
+    };
+
+    static bool isDeleted(const IdBitmap& deleted, int id) {
+        return static_cast<size_t>(id) < deleted.capacity() && deleted.contains(id);
+    }
+
+    // Filtro de un segmento: acepta las filas locales cuyo id global sigue vivo
+    struct LiveFilter {
+        const std::vector<int>& ids;
+        const IdBitmap& deleted;
+
+        bool operator()(int row) const {
+            return !isDeleted(deleted, ids[row]);
+        }
+    };
+
+    // Memoria de trabajo por hilo para combinar los resultados de los segmentos
+    struct MergeScratch {
+        TopK top;
+        std::vector<Neighbor> partial;
+        std::vector<std::pair<double, int>> rows;
+
+        static MergeScratch& local() {
+            static thread_local MergeScratch scratch;
+            return scratch;
+        }
+    };
+
+public:
+    // Vista consistente del índice en un instante. Se puede conservar el
+    // tiempo que haga falta (p. ej. para consultar y luego pedir los textos)
+    class Snapshot {
+    private:
+        friend class DynamicKDTree;
+
+        std::vector<std::shared_ptr<const Segment>> segments; // Del más viejo al más nuevo, ids crecientes
+        std::vector<int> segment_deleted;                      // Lápidas de cada segmento
+        std::shared_ptr<Buffer> buffer;
+        int buffer_first_id; // Id de la ranura 0 del búfer
+        int buffered;        // Ranuras visibles del búfer
+        std::shared_ptr<const IdBitmap> deleted;
+        int next_id;
+        int live;
+        Metric metric;       // La de los árboles, para las ranuras del búfer
+
+        // Segmento que contiene el rango de `id` (-1 si es del búfer o no existe)
+        int findSegment(int id) const {
+            int lo = 0;
+            int hi = static_cast<int>(segments.size());
+            while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (segments[mid]->ids.back() < id) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            return lo < static_cast<int>(segments.size()) ? lo : -1;
+        }
+
+        int segmentLive(int s) const {
+            return static_cast<int>(segments[s]->ids.size()) - segment_deleted[s];
+        }
+
+    public:
+        Snapshot()
+            : buffer_first_id(0), buffered(0), deleted(std::make_shared<IdBitmap>()), next_id(0), live(0),
+              metric(Metric::L2) {}
+
+        // k vecinos vivos en `out`, de menor a mayor distancia. Con params
+        // aproximados cada segmento revisa hasta max_checks hojas
+        void kNearest(const Point& query, int k, const SearchParams& params, KDSearchContext& context,
+                      std::vector<Neighbor>& out) const {
+            out.clear();
+            if (k <= 0) {
+                return;
+            }
+            MergeScratch& scratch = MergeScratch::local();
+            TopK& top = scratch.top;
+            top.reset(k);
+            const IdBitmap& tombstones = *deleted;
+
+            for (size_t s = 0; s < segments.size(); s++) {
+                const Segment& segment = *segments[s];
+                LiveFilter filter = {segment.ids, tombstones};
+                segment.tree->kNearestFiltered(query, k, filter, params, context, scratch.partial);
+                for (const auto& neighbor : scratch.partial) {
+                    top.push(neighbor.first, segment.ids[neighbor.second]);
+                }
+            }
+
+            for (int slot = 0; slot < buffered; slot++) {
+                int id = buffer_first_id + slot;
+                if (isDeleted(tombstones, id)) {
+                    continue;
+                }
+                const Point& point = buffer->items[slot].embedding;
+                SearchCounters::distance();
+                top.push(metricDistance(metric, query, point), id);
+            }
+
+            top.extractSorted(scratch.rows);
+            out.assign(scratch.rows.begin(), scratch.rows.end());
+        }
+
+        std::vector<Neighbor> kNearest(const Point& query, int k, const SearchParams& params = SearchParams()) const {
+            std::vector<Neighbor> result;
+            kNearest(query, k, params, KDSearchContext::local(), result);
+            return result;
+        }
+
+        // true si `id` existe y no fue borrado
+        bool contains(int id) const {
+            return id >= 0 && id < next_id && !isDeleted(*deleted, id);
+        }
+
+        // Texto del documento `id` ("" si no está vivo en esta instantánea)
+        std::string text(int id) const {
+            if (!contains(id)) {
+                return "";
+            }
+            if (id >= buffer_first_id) {
+                return buffer->items[id - buffer_first_id].text;
+            }
+            int s = findSegment(id);
+            int row = s >= 0 ? segments[s]->local(id) : -1;
+            return row >= 0 ? segments[s]->items[row].text : "";
+        }
+
+        // Documentos vivos
+        int size() const {
+            return live;
+        }
+
+        int getSegmentCount() const {
+            return static_cast<int>(segments.size());
+        }
+
+        int getBufferedCount() const {
+            return buffered;
+        }
+
+        int getDeletedCount() const {
+            return next_id - live;
+        }
+    };
+
+private:
+    DynamicKDTreeOptions options;
+    std::shared_ptr<const Snapshot> current; // Se lee y se reemplaza con atomic_load/atomic_store
+    std::mutex write_mutex;                  // Serializa a los escritores (y la publicación de las fusiones)
+    std::mutex maintenance_mutex;            // Una sola fusión a la vez
+    int dimensions;
+    std::atomic<long long> rebuilds;         // Segmentos construidos por fusiones o reconstrucciones
+    std::atomic<long long> rebuilt_points;
+
+    // Si el hilo de fondo se atrasa y quedan más segmentos que esto, el que
+    // inserta también fusiona (así las búsquedas no recorren una lista sin cota)
+    static const int kMaxSegments = 32;
+
+    std::thread worker;
+    std::mutex signal_mutex;
+    std::condition_variable signal;
+    bool pending;
+    bool stopping;
+
+    // Construir un segmento con los registros y sus ids globales
+    std::shared_ptr<const Segment> makeSegment(std::vector<DataItem>&& items, std::vector<int>&& ids) const {
+        std::shared_ptr<Segment> segment = std::make_shared<Segment>();
+        segment->items.swap(items);
+        segment->ids.swap(ids);
+        segment->tree.reset(new KDTree(segment->items, options.tree, false));
+        return segment;
+    }
+
+    static int countDeleted(const Segment& segment, const IdBitmap& deleted) {
+        int count = 0;
+        for (int id : segment.ids) {
+            count += isDeleted(deleted, id);
+        }
+        return count;
+    }
+
+    void publish(const std::shared_ptr<Snapshot>& next) {
+        std::atomic_store(&current, std::shared_ptr<const Snapshot>(next));
+    }
+
+    // Sellar el búfer de `next` en un segmento (se copia: instantáneas
+    // anteriores pueden seguir leyéndolo) y abrir uno vacío
+    void sealBuffer(Snapshot& next) const {
+        if (next.buffered > 0) {
+            std::vector<DataItem> items(next.buffer->items.begin(), next.buffer->items.begin() + next.buffered);
+            std::vector<int> ids(next.buffered);
+            for (int slot = 0; slot < next.buffered; slot++) {
+                ids[slot] = next.buffer_first_id + slot;
+            }
+            std::shared_ptr<const Segment> segment = makeSegment(std::move(items), std::move(ids));
+            next.segments.push_back(segment);
+            next.segment_deleted.push_back(countDeleted(*segment, *next.deleted));
+        }
+        next.buffer = std::make_shared<Buffer>(std::max(1, options.buffer_size));
+        next.buffer_first_id = next.next_id;
+        next.buffered = 0;
+    }
+
+    // Rango [begin, end) de segmentos a reconstruir según la política: primero
+    // la fusión de la cola, después un segmento con demasiadas lápidas
+    bool pickTask(const Snapshot& snapshot, int& begin, int& end) const {
+        int n = snapshot.getSegmentCount();
+        if (n >= 2) {
+            long long total = snapshot.segmentLive(n - 1);
+            begin = n - 1;
+            while (begin > 0 && snapshot.segmentLive(begin - 1) <= options.merge_ratio * total) {
+                begin--;
+                total += snapshot.segmentLive(begin);
+            }
+            if (begin < n - 1) {
+                end = n;
+                return true;
+            }
+        }
+        for (int s = 0; s < n; s++) {
+            if (snapshot.segment_deleted[s] > 0 &&
+                snapshot.segment_deleted[s] >= options.max_deleted_ratio * snapshot.segments[s]->ids.size()) {
+                begin = s;
+                end = s + 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Una fusión o reconstrucción: el árbol nuevo se construye fuera del
+    // candado de escritura (las búsquedas y escrituras siguen sobre la
+    // instantánea vigente) y luego reemplaza a los segmentos que cubre
+    bool runTask() {
+        std::shared_ptr<const Snapshot> snapshot = this->snapshot();
+        int begin = 0;
+        int end = 0;
+        if (!pickTask(*snapshot, begin, end)) {
+            return false;
+        }
+
+        std::vector<DataItem> items;
+        std::vector<int> ids;
+        for (int s = begin; s < end; s++) {
+            const Segment& segment = *snapshot->segments[s];
+            for (size_t row = 0; row < segment.ids.size(); row++) {
+                if (!isDeleted(*snapshot->deleted, segment.ids[row])) {
+                    items.push_back(segment.items[row]);
+                    ids.push_back(segment.ids[row]);
+                }
+            }
+        }
+        rebuilt_points += ids.size();
+        std::shared_ptr<const Segment> merged;
+        if (!ids.empty()) {
+            merged = makeSegment(std::move(items), std::move(ids));
+        }
+
+        std::lock_guard<std::mutex> lock(write_mutex);
+        std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>(*current);
+        // Solo las fusiones quitan segmentos y los sellados agregan al final,
+        // así el rango sigue contiguo; se ubica por puntero
+        std::vector<std::shared_ptr<const Segment>>::iterator first =
+            std::find(next->segments.begin(), next->segments.end(), snapshot->segments[begin]);
+        int offset = static_cast<int>(first - next->segments.begin());
+        next->segments.erase(first, first + (end - begin));
+        next->segment_deleted.erase(next->segment_deleted.begin() + offset,
+                                    next->segment_deleted.begin() + offset + (end - begin));
+        if (merged) {
+            next->segments.insert(next->segments.begin() + offset, merged);
+            next->segment_deleted.insert(next->segment_deleted.begin() + offset,
+                                         countDeleted(*merged, *next->deleted));
+        }
+        publish(next);
+        rebuilds++;
+        return true;
+    }
+
+    // Avisar al hilo de fondo, o reconstruir aquí si no hay hilo
+    void scheduleMaintenance() {
+        if (!options.background) {
+            maintain();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(signal_mutex);
+            pending = true;
+        }
+        signal.notify_one();
+    }
+
+    void maintenanceLoop() {
+        std::unique_lock<std::mutex> lock(signal_mutex);
+        while (true) {
+            signal.wait(lock, [this] { return stopping || pending; });
+            if (stopping) {
+                return;
+            }
+            pending = false;
+            lock.unlock();
+            maintain();
+            lock.lock();
+        }
+    }
+
+public:
+    // Carga inicial: `data` forma el primer segmento con ids 0..n-1
+    explicit DynamicKDTree(const std::vector<DataItem>& data,
+                           const DynamicKDTreeOptions& options = DynamicKDTreeOptions())
+        : options(options), dimensions(data.empty() ? 0 : static_cast<int>(data[0].embedding.size())),
+          rebuilds(0), rebuilt_points(0), pending(false), stopping(false) {
+        std::shared_ptr<Snapshot> initial = std::make_shared<Snapshot>();
+        initial->next_id = static_cast<int>(data.size());
+        initial->live = initial->next_id;
+        initial->metric = options.tree.metric;
+        if (!data.empty()) {
+            std::vector<DataItem> items(data);
+            std::vector<int> ids(data.size());
+            for (size_t i = 0; i < ids.size(); i++) {
+                ids[i] = static_cast<int>(i);
+            }
+            initial->segments.push_back(makeSegment(std::move(items), std::move(ids)));
+            initial->segment_deleted.push_back(0);
+        }
+        sealBuffer(*initial);
+        publish(initial);
+
+        if (options.background) {
+            worker = std::thread(&DynamicKDTree::maintenanceLoop, this);
+        }
+    }
+
+    ~DynamicKDTree() {
+        if (worker.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(signal_mutex);
+                stopping = true;
+            }
+            signal.notify_one();
+            worker.join();
+        }
+    }
+
+    DynamicKDTree(const DynamicKDTree&) = delete;
+    DynamicKDTree& operator=(const DynamicKDTree&) = delete;
+
+    // Instantánea vigente
+    std::shared_ptr<const Snapshot> snapshot() const {
+        return std::atomic_load(&current);
+    }
+
+    // Insertar un documento; devuelve su id (-1 si la dimensión no coincide)
+    int insert(const std::string& text, const Point& embedding) {
+        bool sealed = false;
+        bool backlog = false;
+        int id = -1;
+        {
+            std::lock_guard<std::mutex> lock(write_mutex);
+            if (dimensions == 0) {
+                dimensions = static_cast<int>(embedding.size());
+            }
+            if (embedding.size() != dimensions) {
+                std::cerr << "Error: el embedding tiene " << embedding.size() << " dimensiones y el índice "
+                          << dimensions << std::endl;
+                return -1;
+            }
+
+            std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>(*current);
+            DataItem& slot = next->buffer->items[next->buffered];
+            slot.text = text;
+            slot.embedding = embedding;
+            id = next->next_id++;
+            next->buffered++;
+            next->live++;
+            if (next->buffered == static_cast<int>(next->buffer->items.size())) {
+                sealBuffer(*next);
+                sealed = true;
+                backlog = next->getSegmentCount() > kMaxSegments;
+            }
+            publish(next);
+        }
+        if (backlog) {
+            maintain();
+        } else if (sealed) {
+            scheduleMaintenance();
+        }
+        return id;
+    }
+
+    int insert(const DataItem& item) {
+        return insert(item.text, item.embedding);
+    }
+
+    // Borrar el documento `id`; false si no existe o ya estaba borrado. Copia
+    // el mapa de lápidas (n / 8 bytes) para no tocar el de las instantáneas vivas
+    bool remove(int id) {
+        bool rebuild = false;
+        {
+            std::lock_guard<std::mutex> lock(write_mutex);
+            if (!current->contains(id)) {
+                return false;
+            }
+
+            std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>(*current);
+            std::shared_ptr<IdBitmap> deleted = std::make_shared<IdBitmap>(*next->deleted);
+            deleted->resize(next->next_id);
+            deleted->set(id);
+            next->deleted = deleted;
+            next->live--;
+            if (id < next->buffer_first_id) {
+                int s = next->findSegment(id);
+                next->segment_deleted[s]++;
+                rebuild = next->segment_deleted[s] >= options.max_deleted_ratio * next->segments[s]->ids.size();
+            }
+            publish(next);
+        }
+        if (rebuild) {
+            scheduleMaintenance();
+        }
+        return true;
+    }
+
+    // Ejecutar las fusiones y reconstrucciones pendientes en este hilo
+    void maintain() {
+        std::lock_guard<std::mutex> lock(maintenance_mutex);
+        while (runTask()) {
+        }
+    }
+
+    // Sellar el búfer aunque no esté lleno y dejar el índice compactado
+    void flush() {
+        {
+            std::lock_guard<std::mutex> lock(write_mutex);
+            std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>(*current);
+            sealBuffer(*next);
+            publish(next);
+        }
+        maintain();
+    }
+
+    void kNearest(const Point& query, int k, const SearchParams& params, KDSearchContext& context,
+                  std::vector<Neighbor>& out) const {
+        snapshot()->kNearest(query, k, params, context, out);
+    }
+
+    std::vector<Neighbor> kNearest(const Point& query, int k, const SearchParams& params = SearchParams()) const {
+        return snapshot()->kNearest(query, k, params);
+    }
+
+    Neighbor nearest(const Point& query, const SearchParams& params = SearchParams()) const {
+        std::vector<Neighbor> result = kNearest(query, 1, params);
+        return result.empty() ? Neighbor(std::numeric_limits<double>::max(), -1) : result[0];
+    }
+
+    std::string text(int id) const {
+        return snapshot()->text(id);
+    }
+
+    int size() const {
+        return snapshot()->size();
+    }
+
+    int getSegmentCount() const {
+        return snapshot()->getSegmentCount();
+    }
+
+    long long getRebuildCount() const {
+        return rebuilds;
+    }
+
+    long long getRebuiltPoints() const {
+        return rebuilt_points;
+    }
+
+    // Memoria de la instantánea vigente: árboles e ids de los segmentos, los
+    // registros que se guardan para reconstruir (vectores exactos y textos), el
+    // búfer completo (se reserva de entrada) y las lápidas
+    MemoryUsage memoryUsage() const {
+        std::shared_ptr<const Snapshot> view = snapshot();
+        MemoryUsage usage;
+        usage.structure = sizeof(*this) + sizeof(Snapshot) + vectorBytes(view->segments) +
+                          vectorBytes(view->segment_deleted) + view->deleted->memoryBytes();
+        for (const auto& segment : view->segments) {
+            MemoryUsage tree_usage = segment->tree->memoryUsage();
+            usage.vectors += tree_usage.vectors;
+            usage.structure += tree_usage.structure + sizeof(Segment) + vectorBytes(segment->ids);
+            addDataItems(segment->items, usage);
+        }
+        addDataItems(view->buffer->items, usage);
+        const MergeScratch& scratch = MergeScratch::local();
+        usage.scratch = KDSearchContext::local().memoryBytes() + scratch.top.memoryBytes() +
+                        vectorBytes(scratch.partial) + vectorBytes(scratch.rows);
+        return usage;
+    }
+
+    size_t memoryBytes() const {
+        return memoryUsage().total();
+    }
+};
+
+#endif // DYNAMIC_KDTREE_H
\ No newline at end of file
@@ -2,13 +2,154 @@
 #define EMBEDDINGS_H
 
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <random>
 #include <cctype>
-#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
 #include <Eigen/Dense>
+#include "thread_pool.h"
+
+// Caché acotada de vectores de token (en float) indexada por el hash del
+// token. El vector de un token depende solo de seed + hash, así que dos
+// tokens con el mismo hash tienen el mismo vector y la clave es exacta.
+// Repartida en shards con su propio mutex para que los hilos de la ingesta no
+// se bloqueen entre sí. Al llenarse deja de admitir tokens nuevos: los
+// frecuentes aparecen antes y son los que quedan.
+class TokenEmbeddingCache {
+private:
+    static const int kShards = 16;
+    
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, uint32_t> slots; // hash -> fila de `vectors`
+        std::vector<float> vectors;
+    };
+    
+    int dims;
+    size_t shard_capacity;
+    Shard shards[kShards];
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    
+    Shard& shardFor(uint64_t hash) {
+        return shards[(hash ^ (hash >> 29)) % kShards];
+    }
+    
+public:
+    TokenEmbeddingCache(int dims, size_t capacity) : dims(dims), shard_capacity(0), hits(0), misses(0) {
+        setCapacity(capacity);
+    }
+    
+    // Tokens como máximo (0 = sin caché); no descarta los ya guardados
+    void setCapacity(size_t capacity) {
+        shard_capacity = (capacity + kShards - 1) / kShards;
+    }
+    
+    size_t getCapacity() const {
+        return shard_capacity * kShards;
+    }
+    
+    // Sumar a `sum` (dims doubles) el vector de `hash` si está en la caché
+    bool addTo(uint64_t hash, double* sum) {
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.slots.find(hash);
+        if (it == shard.slots.end()) {
+            misses++;
+            return false;
+        }
+        hits++;
+        const float* vec = shard.vectors.data() + static_cast<size_t>(it->second) * dims;
+        for (int i = 0; i < dims; i++) {
+            sum[i] += vec[i];
+        }
+        return true;
+    }
+    
+    // Guardar el vector de `hash` si queda lugar (y no estaba ya)
+    void insert(uint64_t hash, const float* vector) {
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.slots.size() >= shard_capacity || shard.slots.count(hash)) {
+            return;
+        }
+        shard.slots[hash] = static_cast<uint32_t>(shard.slots.size());
+        shard.vectors.insert(shard.vectors.end(), vector, vector + dims);
+    }
+    
+    size_t size() {
+        size_t total = 0;
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.slots.size();
+        }
+        return total;
+    }
+    
+    uint64_t getHits() const {
+        return hits.load();
+    }
+    
+    uint64_t getMisses() const {
+        return misses.load();
+    }
+    
+    size_t memoryBytes() {
+        size_t bytes = 0;
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            bytes += shard.vectors.capacity() * sizeof(float) +
+                     shard.slots.size() * (sizeof(uint64_t) + sizeof(uint32_t) + 2 * sizeof(void*));
+        }
+        return bytes;
+    }
+    
+    // Recorrer las entradas (hash, vector); para persistir la caché
+    template <typename Fn>
+    void forEach(Fn fn) {
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& entry : shard.slots) {
+                fn(entry.first, shard.vectors.data() + static_cast<size_t>(entry.second) * dims);
+            }
+        }
+    }
+};
+
+// Archivo de la tabla de vectores de token (por convención embeddings_model.bin):
+//
+//   [cabecera 32 B][count x (hash uint64, dims x float32)]
+//
+// La semilla y la dimensión se guardan para no mezclar tablas de otro
+// embedder. Enteros little-endian.
+const char kTokenTableMagic[8] = {'K', 'D', 'T', 'O', 'K', 'E', 'N', '\0'};
+const uint32_t kTokenTableVersion = 1;
+
+struct TokenTableHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dims;
+    uint32_t seed;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+static_assert(sizeof(TokenTableHeader) == 32, "la cabecera de la tabla de tokens debe medir 32 bytes");
+
+// Token de un texto: el tramo original (con mayúsculas y puntuación) y el hash
+// del token normalizado, que es lo único que necesita el embedding
+struct TokenView {
+    const char* data;
+    size_t length;
+    uint64_t hash;
+};
 
 class DeterministicEmbedder {
 private:
@@ -18,6 +159,9 @@ private:
     // Semilla para generación determinista de embeddings
     unsigned int seed = 42;
     
+    // Vectores de token ya generados
+    TokenEmbeddingCache cache;
+    
     // Función hash para strings 
     size_t hashString(const std::string& str) const {
         size_t hash = 0;
@@ -26,78 +170,225 @@ private:
         }
         return hash;
     }
+    
+    // Generar el vector de un token a partir de su hash, redondeado a float
+    // como los de la caché (así el resultado no depende de si hubo acierto)
+    void generateTokenVector(uint64_t hash, float* out) const {
+        // Usar la semilla + hash del token para inicializar el generador
+        std::mt19937 rng(seed + hash);
+        std::normal_distribution<double> dist(0.0, 1.0);
+        
+        // Generar valores aleatorios pero deterministas
+        thread_local std::vector<double> buffer;
+        buffer.resize(embedding_dim);
+        Eigen::Map<Eigen::VectorXd> vec(buffer.data(), embedding_dim);
+        for (int i = 0; i < embedding_dim; ++i) {
+            vec(i) = dist(rng);
+        }
+        
+        // Normalizar
+        vec.normalize();
+        Eigen::Map<Eigen::VectorXf>(out, embedding_dim) = vec.cast<float>();
+    }
+    
+    // Sumar a `sum` el vector del token, generándolo solo si no está en la caché
+    void addTokenEmbedding(uint64_t hash, double* sum) {
+        if (cache.addTo(hash, sum)) {
+            return;
+        }
+        thread_local std::vector<float> vec;
+        vec.resize(embedding_dim);
+        generateTokenVector(hash, vec.data());
+        cache.insert(hash, vec.data());
+        for (int i = 0; i < embedding_dim; ++i) {
+            sum[i] += vec[i];
+        }
+    }
 
 public:
+    // Tokens en caché por defecto (~1.5 KB cada uno con 384 dimensiones)
+    static const size_t kDefaultCacheTokens = 1 << 16;
+    
     // Constructor
-    DeterministicEmbedder(int dim = 384) : embedding_dim(dim) {}
+    DeterministicEmbedder(int dim = 384, size_t cache_tokens = kDefaultCacheTokens)
+        : embedding_dim(dim), cache(dim, cache_tokens) {}
+    
+    // Recorrer los tokens de `text` en una pasada, sin copiar: separa por
+    // espacios, pasa a minúsculas y descarta lo que no es alfanumérico mientras
+    // calcula el hash. Los tramos sin ningún carácter alfanumérico no son tokens.
+    template <typename Fn>
+    static void forEachToken(const char* text, size_t length, Fn fn) {
+        size_t i = 0;
+        while (i < length) {
+            while (i < length && std::isspace(static_cast<unsigned char>(text[i]))) {
+                i++;
+            }
+            size_t start = i;
+            uint64_t hash = 0;
+            bool any = false;
+            for (; i < length && !std::isspace(static_cast<unsigned char>(text[i])); i++) {
+                unsigned char c = static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(text[i])));
+                if (std::isalnum(c)) {
+                    hash = hash * 31 + c;
+                    any = true;
+                }
+            }
+            if (any) {
+                TokenView token = {text + start, i - start, hash};
+                fn(token);
+            }
+        }
+    }
     
-    // Tokenizar texto
+    // Tokenizar texto (copia cada token normalizado; el embedding no lo usa)
     std::vector<std::string> tokenize(const std::string& text) {
         std::vector<std::string> tokens;
-        std::istringstream iss(text);
-        std::string token;
-        
-        while (iss >> token) {
-            // Convertir a minúsculas
-            std::transform(token.begin(), token.end(), token.begin(),
-                           [](unsigned char c){ return std::tolower(c); });
-            
-            // Eliminar puntuación
-            token.erase(std::remove_if(token.begin(), token.end(), 
-                                      [](unsigned char c){ return !std::isalnum(c); }),
-                       token.end());
-            
-            if (!token.empty()) {
-                tokens.push_back(token);
+        forEachToken(text.data(), text.size(), [&tokens](const TokenView& view) {
+            std::string token;
+            for (size_t i = 0; i < view.length; i++) {
+                unsigned char c = static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(view.data[i])));
+                if (std::isalnum(c)) {
+                    token.push_back(static_cast<char>(c));
+                }
             }
-        }
-        
+            tokens.push_back(token);
+        });
         return tokens;
     }
     
-    // Obtener embedding para un texto - método puramente determinista
-    Eigen::VectorXd getEmbedding(const std::string& text) {
-        std::vector<std::string> tokens = tokenize(text);
+    // Obtener embedding para un texto en `out` (dims doubles) - método
+    // puramente determinista y sin reservar memoria con la caché caliente.
+    // Seguro entre hilos: la caché de tokens tiene su propio bloqueo
+    void getEmbedding(const char* text, size_t length, double* out) {
+        std::fill(out, out + embedding_dim, 0.0);
         
-        if (tokens.empty()) {
-            // Devolver vector aleatorio pero determinista para texto vacío
-            return getTokenEmbedding(text);
-        }
-        
-        // Vector resultante
-        Eigen::VectorXd result = Eigen::VectorXd::Zero(embedding_dim);
+        // Para cada token, sumar su vector determinista
+        bool any = false;
+        forEachToken(text, length, [&](const TokenView& token) {
+            addTokenEmbedding(token.hash, out);
+            any = true;
+        });
         
-        // Para cada token, generar un vector determinista y sumarlo
-        for (const auto& token : tokens) {
-            result += getTokenEmbedding(token);
+        if (!any) {
+            // Vector aleatorio pero determinista para texto sin tokens
+            addTokenEmbedding(hashString(std::string(text, length)), out);
+            return;
         }
         
         // Normalizar
+        Eigen::Map<Eigen::VectorXd> result(out, embedding_dim);
         double norm = result.norm();
         if (norm > 0) {
             result /= norm;
         }
-        
+    }
+    
+    // Embedding en un vector del llamador (solo se redimensiona si hace falta)
+    void getEmbedding(const std::string& text, Eigen::VectorXd& out) {
+        out.resize(embedding_dim);
+        getEmbedding(text.data(), text.size(), out.data());
+    }
+    
+    Eigen::VectorXd getEmbedding(const std::string& text) {
+        Eigen::VectorXd result(embedding_dim);
+        getEmbedding(text.data(), text.size(), result.data());
         return result;
     }
     
+    // Embeddings de un lote en las columnas de `out` (dims x n, se redimensiona
+    // si hace falta), repartidos en `threads` hilos del pool compartido
+    void getEmbeddings(const std::vector<std::string>& texts, Eigen::MatrixXd& out, int threads = 1) {
+        out.resize(embedding_dim, static_cast<Eigen::Index>(texts.size()));
+        ThreadPool::global().parallelFor(static_cast<int>(texts.size()), threads, [&](int i) {
+            getEmbedding(texts[i].data(), texts[i].size(), out.col(i).data());
+        });
+    }
+    
     // Generar embedding determinista para un token
     Eigen::VectorXd getTokenEmbedding(const std::string& token) {
         Eigen::VectorXd vec = Eigen::VectorXd::Zero(embedding_dim);
-        
-        // Usar la semilla + hash del token para inicializar el generador
-        std::mt19937 rng(seed + hashString(token));
-        std::normal_distribution<double> dist(0.0, 1.0);
-        
-        // Generar valores aleatorios pero deterministas
-        for (int i = 0; i < embedding_dim; ++i) {
-            vec(i) = dist(rng);
+        addTokenEmbedding(hashString(token), vec.data());
+        return vec;
+    }
+    
+    // Precalcular los vectores de todos los tokens de `text`
+    void precompute(const std::string& text) {
+        thread_local std::vector<double> sink;
+        sink.resize(embedding_dim);
+        forEachToken(text.data(), text.size(), [this](const TokenView& token) {
+            addTokenEmbedding(token.hash, sink.data());
+        });
+    }
+    
+    // Cargar una tabla guardada con saveTokenCache. Los archivos de otro
+    // formato (como el embeddings_model.bin original) o de otra semilla o
+    // dimensión se ignoran
+    bool loadTokenCache(const std::string& filename) {
+        std::ifstream infile(filename, std::ios::binary);
+        if (!infile.is_open()) {
+            return false;
+        }
+        TokenTableHeader header;
+        infile.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!infile || std::memcmp(header.magic, kTokenTableMagic, sizeof(kTokenTableMagic)) != 0 ||
+            header.version != kTokenTableVersion) {
+            std::cerr << "Aviso: " << filename << " no es una tabla de tokens; se ignora" << std::endl;
+            return false;
+        }
+        if (static_cast<int>(header.dims) != embedding_dim || header.seed != seed) {
+            std::cerr << "Aviso: la tabla de tokens " << filename << " es de otro embedder (dimensión "
+                      << header.dims << ", semilla " << header.seed << "); se ignora" << std::endl;
+            return false;
         }
         
-        // Normalizar
-        vec.normalize();
+        std::vector<float> vec(embedding_dim);
+        uint64_t loaded = 0;
+        for (; loaded < header.count; loaded++) {
+            uint64_t hash;
+            infile.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+            infile.read(reinterpret_cast<char*>(vec.data()), sizeof(float) * embedding_dim);
+            if (!infile) {
+                std::cerr << "Aviso: la tabla de tokens " << filename << " está truncada" << std::endl;
+                break;
+            }
+            cache.insert(hash, vec.data());
+        }
+        std::cout << "Tabla de tokens cargada: " << cache.size() << " tokens desde " << filename << std::endl;
+        return true;
+    }
+    
+    // Guardar los vectores de token en caché
+    bool saveTokenCache(const std::string& filename) {
+        std::ofstream outfile(filename, std::ios::binary);
+        if (!outfile.is_open()) {
+            std::cerr << "Error: No se pudo abrir " << filename << " para escribir" << std::endl;
+            return false;
+        }
+        TokenTableHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kTokenTableMagic, sizeof(header.magic));
+        header.version = kTokenTableVersion;
+        header.dims = static_cast<uint32_t>(embedding_dim);
+        header.seed = seed;
+        header.count = cache.size();
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
         
-        return vec;
+        size_t dims = static_cast<size_t>(embedding_dim);
+        cache.forEach([&outfile, dims](uint64_t hash, const float* vec) {
+            outfile.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+            outfile.write(reinterpret_cast<const char*>(vec), sizeof(float) * dims);
+        });
+        outfile.close();
+        if (!outfile) {
+            std::cerr << "Error al escribir " << filename << std::endl;
+            return false;
+        }
+        std::cout << "Tabla de tokens guardada en " << filename << " (" << header.count << " tokens)" << std::endl;
+        return true;
+    }
+    
+    TokenEmbeddingCache& getCache() {
+        return cache;
     }
     
     // Obtener dimensión de los embeddings
@@ -0,0 +1,131 @@
+#ifndef GROUND_TRUTH_H
+#define GROUND_TRUTH_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include "kdtree.h"
+#include "linear_search.h"
+#include "mapped_database.h"
+#include "thread_pool.h"
+
+// Identificador del archivo de ground truth
+const char kGroundTruthMagic[8] = {'K', 'D', 'G', 'T', 'R', 'U', 'T', 'H'};
+
+// Vecinos exactos de un conjunto de consultas, para medir recall sin repetir
+// la búsqueda lineal en cada corrida. La clave liga el archivo a la base
+// (su checksum), a los embeddings de las consultas, a k y a la métrica: si
+// algo cambia, la clave no coincide y se recalcula.
+struct GroundTruth {
+    uint64_t key;
+    int k;
+    std::vector<std::vector<Neighbor>> neighbors; // Uno por consulta, de menor a mayor distancia
+
+    GroundTruth() : key(0), k(0) {}
+
+    bool save(const std::string& filename) const {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        int32_t header[2] = {static_cast<int32_t>(neighbors.size()), k};
+        file.write(kGroundTruthMagic, sizeof(kGroundTruthMagic));
+        file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        for (const auto& row : neighbors) {
+            int32_t count = static_cast<int32_t>(row.size());
+            file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            for (const auto& neighbor : row) {
+                int32_t id = neighbor.second;
+                file.write(reinterpret_cast<const char*>(&neighbor.first), sizeof(double));
+                file.write(reinterpret_cast<const char*>(&id), sizeof(id));
+            }
+        }
+        return static_cast<bool>(file);
+    }
+
+    // Cargar solo si el archivo existe y fue calculado con `expected_key`
+    bool load(const std::string& filename, uint64_t expected_key) {
+        std::ifstream file(filename, std::ios::binary);
+        char magic[sizeof(kGroundTruthMagic)];
+        uint64_t stored_key = 0;
+        int32_t header[2] = {0, 0};
+        if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, kGroundTruthMagic, sizeof(magic)) != 0 ||
+            !file.read(reinterpret_cast<char*>(&stored_key), sizeof(stored_key)) || stored_key != expected_key ||
+            !file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] < 0) {
+            return false;
+        }
+        std::vector<std::vector<Neighbor>> rows(header[0]);
+        for (auto& row : rows) {
+            int32_t count = 0;
+            if (!file.read(reinterpret_cast<char*>(&count), sizeof(count)) || count < 0 || count > header[1]) {
+                return false;
+            }
+            row.resize(count);
+            for (auto& neighbor : row) {
+                int32_t id = 0;
+                if (!file.read(reinterpret_cast<char*>(&neighbor.first), sizeof(double)) ||
+                    !file.read(reinterpret_cast<char*>(&id), sizeof(id))) {
+                    return false;
+                }
+                neighbor.second = id;
+            }
+        }
+        key = stored_key;
+        k = header[1];
+        neighbors.swap(rows);
+        return true;
+    }
+};
+
+// Clave del ground truth: checksum de la base, bytes de las consultas, k y
+// métrica (L2 no entra en la clave, así sirven los archivos ya calculados)
+inline uint64_t groundTruthKey(uint64_t database_checksum, const std::vector<Point>& queries, int k,
+                               Metric metric = Metric::L2) {
+    uint64_t key = checksum64(&k, sizeof(k), database_checksum);
+    if (metric != Metric::L2) {
+        int32_t code = static_cast<int32_t>(metric);
+        key = checksum64(&code, sizeof(code), key);
+    }
+    for (const auto& query : queries) {
+        key = checksum64(query.data(), query.size() * sizeof(double), key);
+    }
+    return key;
+}
+
+// Vecinos exactos por fuerza bruta en double (sin cuantizar aunque la base
+// lo esté), repartiendo las consultas entre `threads` hilos (0 = todos los núcleos)
+inline GroundTruth computeGroundTruth(const MappedDatabase& database, const std::vector<Point>& queries, int k,
+                                      int threads = 0, Metric metric = Metric::L2) {
+    GroundTruth truth;
+    truth.key = groundTruthKey(database.getChecksum(), queries, k, metric);
+    truth.k = k;
+    truth.neighbors.resize(queries.size());
+    LinearSearch linear(database, ElementType::Float64, metric);
+    int parallelism = threads > 0 ? threads : ThreadPool::hardwareThreads();
+    ThreadPool::global().parallelFor(static_cast<int>(queries.size()), parallelism, [&](int q) {
+        truth.neighbors[q] = linear.kNearest(queries[q], k);
+    });
+    return truth;
+}
+
+// Cargar el ground truth de `filename` o, si no está o es de otros datos,
+// calcularlo y guardarlo ahí
+inline GroundTruth cachedGroundTruth(const std::string& filename, const MappedDatabase& database,
+                                     const std::vector<Point>& queries, int k, int threads = 0,
+                                     bool* from_cache = nullptr, Metric metric = Metric::L2) {
+    GroundTruth truth;
+    bool cached = truth.load(filename, groundTruthKey(database.getChecksum(), queries, k, metric));
+    if (!cached) {
+        truth = computeGroundTruth(database, queries, k, threads, metric);
+        truth.save(filename);
+    }
+    if (from_cache) {
+        *from_cache = cached;
+    }
+    return truth;
+}
+
+#endif // GROUND_TRUTH_H
\ No newline at end of file
@@ -0,0 +1,488 @@
+#ifndef HNSW_H
+#define HNSW_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <random>
+#include <utility>
+#include <cmath>
+#include "kdtree.h"
+#include "mapped_database.h"
+#include "thread_pool.h"
+#include "topk.h"
+#include "vector_store.h"
+
+// Parámetros del grafo HNSW
+struct HNSWOptions {
+    int M;                     // Vecinos por nodo en las capas superiores (2M en la capa 0)
+    int ef_construction;       // Lista de candidatos al insertar
+    int ef_search;             // Lista de candidatos por defecto al consultar
+    ElementType element_type;  // Tipo de elemento de los vectores del índice
+    int rerank;                // Candidatos a re-rankear con la copia exacta (solo int8)
+    unsigned int seed;         // Semilla del sorteo de niveles
+    Metric metric;             // Métrica de las búsquedas (ver vector_store.h)
+
+    explicit HNSWOptions(int M = 16, int ef_construction = 200, int ef_search = 50,
+                         ElementType element_type = ElementType::Float64, int rerank = 0)
+        : M(M), ef_construction(ef_construction), ef_search(ef_search),
+          element_type(element_type), rerank(rerank), seed(42), metric(Metric::L2) {}
+};
+
+// Grafo jerárquico navegable de mundo pequeño (HNSW). Cada punto vive en las
+// capas 0..nivel, con el nivel sorteado con distribución geométrica; la
+// búsqueda baja en forma voraz por las capas superiores y explora la capa 0
+// con una lista de ef candidatos. Los vecinos se eligen con la heurística de
+// diversidad (un candidato entra solo si está más cerca del nodo que de los
+// vecinos ya elegidos).
+class HNSW {
+private:
+    VectorStore points;             // Una fila por punto, en el orden de inserción (fila = id)
+    TextTable texts;                // Tabla de textos indexada por id
+    int M;
+    int max_m0;                     // Vecinos máximos en la capa 0
+    int ef_construction;
+    int ef_search;
+    int rerank;
+    int entry_point;
+    int max_level;
+    std::vector<int> levels;             // Nivel más alto de cada nodo
+    std::vector<int> links0;             // Capa 0: n listas de (cuenta, max_m0 vecinos)
+    std::vector<std::vector<int>> upper; // Capas 1..nivel de cada nodo, (cuenta, M vecinos) por capa
+
+    // Marcas de visitado por hilo; una época nueva por búsqueda evita limpiar el arreglo
+    struct VisitedMarks {
+        std::vector<unsigned int> tags;
+        unsigned int epoch;
+
+        VisitedMarks() : epoch(0) {}
+
+        void begin(size_t n) {
+            if (tags.size() < n) {
+                tags.resize(n, 0);
+            }
+            if (++epoch == 0) {
+                std::fill(tags.begin(), tags.end(), 0);
+                epoch = 1;
+            }
+        }
+
+        // Devuelve true la primera vez que se visita `i` en esta época
+        bool visit(int i) {
+            if (tags[i] == epoch) {
+                return false;
+            }
+            tags[i] = epoch;
+            return true;
+        }
+    };
+
+    static VisitedMarks& visitedMarks() {
+        static thread_local VisitedMarks marks;
+        return marks;
+    }
+
+    int* linkList(int node, int level) {
+        return level == 0 ? &links0[static_cast<size_t>(node) * (max_m0 + 1)]
+                          : &upper[node][static_cast<size_t>(level - 1) * (M + 1)];
+    }
+
+    const int* linkList(int node, int level) const {
+        return level == 0 ? &links0[static_cast<size_t>(node) * (max_m0 + 1)]
+                          : &upper[node][static_cast<size_t>(level - 1) * (M + 1)];
+    }
+
+    // Bajada voraz por una capa: moverse al vecino más cercano mientras mejore.
+    // N es la longitud de fila de los kernels (0 = dinámica, ver dispatchDimension)
+    template <int N>
+    void greedyDescend(const VectorStore::Query& q, int level, int& current, double& current_dist) const {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            const int* list = linkList(current, level);
+            SearchCounters::node();
+            SearchCounters::distance(list[0]);
+            for (int j = 1; j <= list[0]; j++) {
+                double dist = points.distance<N>(q, list[j]);
+                if (dist < current_dist) {
+                    current_dist = dist;
+                    current = list[j];
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // Búsqueda en una capa desde `entry` con una lista de `ef` candidatos;
+    // deja en `out` los pares (distancia, id) ordenados de menor a mayor
+    template <int N>
+    void searchLayer(const VectorStore::Query& q, int entry, double entry_dist, int ef, int level,
+                     std::vector<std::pair<double, int>>& out) const {
+        typedef std::pair<double, int> Candidate;
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+        TopK top(ef);
+
+        VisitedMarks& marks = visitedMarks();
+        marks.begin(levels.size());
+        marks.visit(entry);
+        candidates.push(std::make_pair(entry_dist, entry));
+        top.push(entry_dist, entry);
+
+        while (!candidates.empty()) {
+            Candidate current = candidates.top();
+            if (current.first > top.threshold()) {
+                break;
+            }
+            candidates.pop();
+            SearchCounters::node();
+
+            const int* list = linkList(current.second, level);
+            for (int j = 1; j <= list[0]; j++) {
+                int neighbor = list[j];
+                if (!marks.visit(neighbor)) {
+                    continue;
+                }
+                SearchCounters::distance();
+                double dist = points.distance<N>(q, neighbor);
+                if (dist < top.threshold()) {
+                    SearchCounters::explored();
+                    candidates.push(std::make_pair(dist, neighbor));
+                    top.push(dist, neighbor);
+                } else {
+                    SearchCounters::pruned();
+                }
+            }
+        }
+
+        top.extractSorted(out);
+    }
+
+    // Consultas preparadas de las filas durante la construcción: se preparan
+    // al usarse en dos consultas de trabajo reutilizadas, en lugar de guardar
+    // una por punto durante todo el build
+    struct BuildScratch {
+        std::function<void(int, VectorStore::Query&)> prepare; // Preparar la fila `i`
+        VectorStore::Query node;                // El nodo que se inserta
+        VectorStore::Query other;               // El candidato o vecino de selectNeighbors y addLink
+        std::vector<VectorStore::Query> chosen; // Los vecinos elegidos por selectNeighbors
+    };
+
+    // Heurística de selección: recorre los candidatos de menor a mayor y
+    // descarta los que quedan más cerca de un vecino ya elegido que del nodo.
+    // Con L2 y coseno la distancia es simétrica y se mide desde los elegidos
+    // (una consulta preparada por elegido, a lo sumo m); con producto interno,
+    // desde cada candidato
+    template <int N>
+    void selectNeighbors(BuildScratch& scratch, const std::vector<std::pair<double, int>>& candidates, int m,
+                         std::vector<int>& selected) const {
+        bool symmetric = points.getMetric() != Metric::InnerProduct;
+        if (symmetric && static_cast<int>(scratch.chosen.size()) < m) {
+            scratch.chosen.resize(m);
+        }
+        selected.clear();
+        for (size_t i = 0; i < candidates.size() && static_cast<int>(selected.size()) < m; i++) {
+            int candidate = candidates[i].second;
+            if (!symmetric && !selected.empty()) {
+                scratch.prepare(candidate, scratch.other);
+            }
+            bool diverse = true;
+            for (size_t j = 0; j < selected.size(); j++) {
+                double dist = symmetric ? points.distance<N>(scratch.chosen[j], candidate)
+                                        : points.distance<N>(scratch.other, selected[j]);
+                if (dist < candidates[i].first) {
+                    diverse = false;
+                    break;
+                }
+            }
+            if (diverse) {
+                if (symmetric) {
+                    scratch.prepare(candidate, scratch.chosen[selected.size()]);
+                }
+                selected.push_back(candidate);
+            }
+        }
+    }
+
+    // Agregar `node` a la lista de `neighbor`; si se llena, volver a elegir
+    // sus vecinos con la heurística
+    template <int N>
+    void addLink(BuildScratch& scratch, int neighbor, int node, int level) {
+        int capacity = level == 0 ? max_m0 : M;
+        int* list = linkList(neighbor, level);
+        if (list[0] < capacity) {
+            list[++list[0]] = node;
+            return;
+        }
+
+        std::vector<std::pair<double, int>> candidates;
+        candidates.reserve(capacity + 1);
+        scratch.prepare(neighbor, scratch.other);
+        for (int j = 1; j <= list[0]; j++) {
+            candidates.push_back(std::make_pair(points.distance<N>(scratch.other, list[j]), list[j]));
+        }
+        candidates.push_back(std::make_pair(points.distance<N>(scratch.other, node), node));
+        std::sort(candidates.begin(), candidates.end());
+
+        std::vector<int> selected;
+        selectNeighbors<N>(scratch, candidates, capacity, selected);
+        list[0] = static_cast<int>(selected.size());
+        std::copy(selected.begin(), selected.end(), list + 1);
+    }
+
+    template <int N>
+    void insert(BuildScratch& scratch, int node, int level) {
+        levels[node] = level;
+        upper[node].assign(static_cast<size_t>(level) * (M + 1), 0);
+        if (entry_point < 0) {
+            entry_point = node;
+            max_level = level;
+            return;
+        }
+
+        scratch.prepare(node, scratch.node);
+        const VectorStore::Query& q = scratch.node;
+        int current = entry_point;
+        double current_dist = points.distance<N>(q, current);
+        for (int l = max_level; l > level; l--) {
+            greedyDescend<N>(q, l, current, current_dist);
+        }
+
+        std::vector<std::pair<double, int>> candidates;
+        std::vector<int> selected;
+        for (int l = std::min(level, max_level); l >= 0; l--) {
+            searchLayer<N>(q, current, current_dist, ef_construction, l, candidates);
+            selectNeighbors<N>(scratch, candidates, M, selected);
+
+            int* list = linkList(node, l);
+            list[0] = static_cast<int>(selected.size());
+            std::copy(selected.begin(), selected.end(), list + 1);
+            for (size_t j = 0; j < selected.size(); j++) {
+                addLink<N>(scratch, selected[j], node, l);
+            }
+
+            current = candidates[0].second;
+            current_dist = candidates[0].first;
+        }
+
+        if (level > max_level) {
+            entry_point = node;
+            max_level = level;
+        }
+    }
+
+    // Insertar las `n` filas; si el almacén ya está listo (vista de una base
+    // mapeada) solo se construye el grafo
+    template <typename RowFn>
+    void build(int dims, int n, RowFn row, const HNSWOptions& options, bool store_ready) {
+        if (!store_ready) {
+            bool keep_exact = options.element_type == ElementType::Int8 && rerank > 0;
+            points.build(options.element_type, dims, n, row, keep_exact, options.metric);
+        }
+
+        levels.assign(n, 0);
+        links0.assign(static_cast<size_t>(n) * (max_m0 + 1), 0);
+        upper.assign(n, std::vector<int>());
+
+        // Las distancias entre nodos usan la fila de entrada preparada como consulta
+        BuildScratch scratch;
+        scratch.prepare = [this](int i, VectorStore::Query& q) { points.prepareRow(i, q); };
+
+        std::mt19937 rng(options.seed);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        double level_mult = 1.0 / std::log(static_cast<double>(std::max(2, M)));
+        std::vector<int> node_levels(n);
+        for (int i = 0; i < n; i++) {
+            node_levels[i] = static_cast<int>(-std::log(1.0 - uniform(rng)) * level_mult);
+        }
+        InsertAll inserts = {*this, scratch, node_levels};
+        dispatchDimension(points.kernelDimension(), inserts);
+    }
+
+    struct InsertAll {
+        HNSW& graph;
+        BuildScratch& scratch;
+        const std::vector<int>& node_levels;
+
+        template <int N>
+        void run() const {
+            for (size_t i = 0; i < node_levels.size(); i++) {
+                graph.insert<N>(scratch, static_cast<int>(i), node_levels[i]);
+            }
+        }
+    };
+
+    // Vecinos (distancia reportada, id) ordenados de menor a mayor; `ef` <= 0 usa ef_search
+    std::vector<std::pair<double, int>> searchIds(const Point& query, int k, int ef) const {
+        std::vector<std::pair<double, int>> result;
+        if (entry_point < 0 || k <= 0) {
+            return result;
+        }
+        IdSearch search = {*this, query, k, ef, result};
+        dispatchDimension(points.kernelDimension(), search);
+        return result;
+    }
+
+    struct IdSearch {
+        const HNSW& graph;
+        const Point& query;
+        int k;
+        int ef;
+        std::vector<std::pair<double, int>>& result;
+
+        template <int N>
+        void run() const {
+            graph.searchIdsFixed<N>(query, k, ef, result);
+        }
+    };
+
+    // searchIds con los kernels de longitud de fila N
+    template <int N>
+    void searchIdsFixed(const Point& query, int k, int ef, std::vector<std::pair<double, int>>& result) const {
+        SearchCounters::query();
+        VectorStore::Query q;
+        points.prepare(query, q);
+
+        bool use_rerank = points.hasExact() && rerank > k;
+        int candidates = use_rerank ? rerank : k;
+        ef = std::max(ef > 0 ? ef : ef_search, candidates);
+
+        int current = entry_point;
+        SearchCounters::distance();
+        double current_dist = points.distance<N>(q, current);
+        for (int l = max_level; l > 0; l--) {
+            greedyDescend<N>(q, l, current, current_dist);
+        }
+        searchLayer<N>(q, current, current_dist, ef, 0, result);
+        if (static_cast<int>(result.size()) > candidates) {
+            result.resize(candidates);
+        }
+
+        if (points.hasExact()) {
+            rerankCandidates<N>(points, q, result, k);
+        }
+        for (size_t i = 0; i < result.size(); i++) {
+            result[i].first = points.reportedDistance(result[i].first, q.norm2);
+        }
+    }
+
+public:
+    HNSW(const std::vector<DataItem>& data, const HNSWOptions& options = HNSWOptions())
+        : M(std::max(2, options.M)), max_m0(2 * std::max(2, options.M)),
+          ef_construction(std::max(1, options.ef_construction)),
+          ef_search(std::max(1, options.ef_search)), rerank(std::max(0, options.rerank)),
+          entry_point(-1), max_level(0) {
+        build(data.empty() ? 0 : static_cast<int>(data[0].embedding.size()), static_cast<int>(data.size()),
+              [&](int i) -> const Point& { return data[i].embedding; }, options, false);
+        texts.assign(data);
+    }
+
+    // Sobre una base mapeada: si el tipo de elemento coincide con el del archivo
+    // los vectores y textos se usan sin copiar y solo el grafo vive en memoria.
+    // `database` debe vivir más que el índice.
+    HNSW(const MappedDatabase& database, const HNSWOptions& options = HNSWOptions())
+        : M(std::max(2, options.M)), max_m0(2 * std::max(2, options.M)),
+          ef_construction(std::max(1, options.ef_construction)),
+          ef_search(std::max(1, options.ef_search)), rerank(std::max(0, options.rerank)),
+          entry_point(-1), max_level(0) {
+        bool store_ready = options.element_type == database.getElementType() &&
+                           points.view(options.element_type, database.getDimensions(), database.size(),
+                                       database.getStride(), database.rows(), options.metric);
+        build(database.getDimensions(), database.size(),
+              [&](int i) { return database.embedding(i); }, options, store_ready);
+        texts.view(database);
+    }
+
+    // Vecino más cercano; `ef` <= 0 usa el ef_search del índice
+    Neighbor nearest(const Point& query, int ef = 0) const {
+        std::vector<std::pair<double, int>> ids = searchIds(query, 1, ef);
+        if (ids.empty()) {
+            return Neighbor(std::numeric_limits<double>::max(), -1);
+        }
+        return ids[0];
+    }
+
+    std::vector<Neighbor> kNearest(const Point& query, int k, int ef = 0) const {
+        return searchIds(query, k, ef);
+    }
+
+    std::string text(int id) const {
+        return texts[id];
+    }
+
+    std::vector<std::vector<Neighbor>> nearestBatch(const std::vector<Point>& queries, int k, int threads = 0,
+                                                    int ef = 0) const {
+        std::vector<std::vector<Neighbor>> results(queries.size());
+        if (threads <= 0) {
+            threads = ThreadPool::hardwareThreads();
+        }
+
+        ThreadPool::global().parallelFor(static_cast<int>(queries.size()), threads, [&](int q) {
+            results[q] = kNearest(queries[q], k, ef);
+        });
+
+        return results;
+    }
+
+    void setEfSearch(int ef) {
+        ef_search = std::max(1, ef);
+    }
+
+    int getEfSearch() const {
+        return ef_search;
+    }
+
+    int getM() const {
+        return M;
+    }
+
+    int getMaxLevel() const {
+        return max_level;
+    }
+
+    int getPointCount() const {
+        return points.size();
+    }
+
+    // Aristas dirigidas de todas las capas
+    size_t getEdgeCount() const {
+        size_t edges = 0;
+        for (int i = 0; i < static_cast<int>(levels.size()); i++) {
+            for (int l = 0; l <= levels[i]; l++) {
+                edges += linkList(i, l)[0];
+            }
+        }
+        return edges;
+    }
+
+    ElementType getElementType() const {
+        return points.getElementType();
+    }
+
+    size_t getVectorBytes() const {
+        return points.memoryBytes();
+    }
+
+    // Bytes de las listas de adyacencia y los niveles
+    size_t getGraphBytes() const {
+        size_t bytes = vectorBytes(links0) + vectorBytes(levels) + vectorBytes(upper);
+        for (const auto& lists : upper) {
+            bytes += vectorBytes(lists);
+        }
+        return bytes;
+    }
+
+    // Memoria por componente; la de trabajo son las marcas de visitado del hilo que llama
+    MemoryUsage memoryUsage() const {
+        MemoryUsage usage;
+        usage.vectors = points.memoryBytes();
+        usage.structure = sizeof(*this) + getGraphBytes();
+        usage.payload = texts.memoryBytes();
+        usage.scratch = vectorBytes(visitedMarks().tags);
+        return usage;
+    }
+};
+
+#endif // HNSW_H
\ No newline at end of file
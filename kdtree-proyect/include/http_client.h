@@ -0,0 +1,291 @@
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <curl/curl.h>
+
+// curl_global_init no es seguro entre hilos y debe llamarse una sola vez por
+// proceso: se hace al crear el primer cliente y se libera al salir
+struct CurlGlobal {
+    CurlGlobal() {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+    }
+
+    ~CurlGlobal() {
+        curl_global_cleanup();
+    }
+
+    static void ensure() {
+        static CurlGlobal global;
+    }
+};
+
+// Resultado de una solicitud; tiempos en milisegundos (fraccionarios) con reloj monótono
+struct HttpResponse {
+    long status;       // Código HTTP (0 si no hubo respuesta)
+    std::string body;  // Vacío si el cuerpo se entregó por fragmentos
+    std::string error; // Falla de red, límite de tiempo o código >= 400
+    double total_ms;   // Desde que la solicitud sale de la cola hasta el último byte
+
+    HttpResponse() : status(0), total_ms(0) {}
+
+    bool ok() const {
+        return error.empty();
+    }
+};
+
+struct HttpClientOptions {
+    int max_connections;              // Conexiones persistentes (keep-alive) por servidor
+    long timeout_ms;                  // Límite por solicitud si no se da otro (0 = sin límite)
+    std::vector<std::string> headers; // Cabeceras de todas las solicitudes
+
+    HttpClientOptions() : max_connections(4), timeout_ms(60000) {}
+};
+
+// Cliente HTTP asíncrono sobre curl_multi: un hilo propio atiende todas las
+// solicitudes en curso, los handles se reusan y la caché de conexiones de
+// curl_multi mantiene abiertas hasta max_connections por servidor, así las
+// solicitudes seguidas no pagan un handshake TCP cada una. Las cabeceras se
+// arman una sola vez. post()/get() no bloquean: el resultado llega a un
+// callback desde el hilo del cliente (que no debe bloquearse ahí), y el
+// cuerpo puede recibirse por fragmentos a medida que llega.
+class HttpClient {
+public:
+    typedef std::function<void(const char*, size_t)> DataCallback;
+    typedef std::function<void(HttpResponse&&)> DoneCallback;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Transfer {
+        std::string url;
+        std::string body;
+        bool post;
+        long timeout_ms;
+        DataCallback on_data;
+        DoneCallback on_done;
+        CURL* easy;
+        HttpResponse response;
+        Clock::time_point sent;
+    };
+
+    HttpClientOptions options;
+    CURLM* multi;
+    struct curl_slist* headers;
+    std::vector<CURL*> idle;                       // Handles listos para reusar
+    std::vector<std::unique_ptr<Transfer>> in_flight;
+    std::deque<std::unique_ptr<Transfer>> incoming; // Protegida por `mutex`
+    std::mutex mutex;
+    std::atomic<bool> stopping;
+    std::thread loop;
+
+    static size_t writeCallback(char* data, size_t size, size_t nmemb, void* user) {
+        Transfer* transfer = static_cast<Transfer*>(user);
+        size_t length = size * nmemb;
+        try {
+            if (transfer->on_data) {
+                transfer->on_data(data, length);
+            } else {
+                transfer->response.body.append(data, length);
+            }
+        } catch (const std::exception&) {
+            return 0;
+        }
+        return length;
+    }
+
+    void startTransfers() {
+        std::deque<std::unique_ptr<Transfer>> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batch.swap(incoming);
+        }
+        for (auto& transfer : batch) {
+            if (idle.empty()) {
+                idle.push_back(curl_easy_init());
+            }
+            CURL* easy = idle.back();
+            idle.pop_back();
+            curl_easy_reset(easy);
+            transfer->easy = easy;
+            transfer->sent = Clock::now();
+
+            curl_easy_setopt(easy, CURLOPT_URL, transfer->url.c_str());
+            curl_easy_setopt(easy, CURLOPT_HTTPHEADER, headers);
+            if (transfer->post) {
+                curl_easy_setopt(easy, CURLOPT_POSTFIELDS, transfer->body.data());
+                curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, static_cast<long>(transfer->body.size()));
+            }
+            curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &HttpClient::writeCallback);
+            curl_easy_setopt(easy, CURLOPT_WRITEDATA, transfer.get());
+            curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer.get());
+            curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+            curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, transfer->timeout_ms);
+            curl_multi_add_handle(multi, easy);
+            in_flight.push_back(std::move(transfer));
+        }
+    }
+
+    void finishTransfer(CURL* easy, CURLcode result) {
+        Transfer* raw = nullptr;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, reinterpret_cast<char**>(&raw));
+        curl_multi_remove_handle(multi, easy);
+        idle.push_back(easy);
+
+        std::unique_ptr<Transfer> transfer;
+        for (size_t i = 0; i < in_flight.size(); i++) {
+            if (in_flight[i].get() == raw) {
+                transfer = std::move(in_flight[i]);
+                in_flight.erase(in_flight.begin() + i);
+                break;
+            }
+        }
+        if (!transfer) {
+            return;
+        }
+
+        HttpResponse& response = transfer->response;
+        response.total_ms = std::chrono::duration<double, std::milli>(Clock::now() - transfer->sent).count();
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &response.status);
+        if (result != CURLE_OK) {
+            response.error = std::string("Error en CURL: ") + curl_easy_strerror(result);
+        } else if (response.status >= 400) {
+            response.error = "HTTP " + std::to_string(response.status);
+        }
+        if (transfer->on_done) {
+            transfer->on_done(std::move(response));
+        }
+    }
+
+    bool hasIncoming() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !incoming.empty();
+    }
+
+    void eventLoop() {
+        while (!stopping || hasIncoming() || !in_flight.empty()) {
+            startTransfers();
+            int running = 0;
+            curl_multi_perform(multi, &running);
+            int queued = 0;
+            while (CURLMsg* message = curl_multi_info_read(multi, &queued)) {
+                if (message->msg == CURLMSG_DONE) {
+                    finishTransfer(message->easy_handle, message->data.result);
+                }
+            }
+            // Esperar actividad de red o una solicitud nueva (curl_multi_wakeup)
+            curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+        }
+    }
+
+    void enqueue(std::unique_ptr<Transfer> transfer) {
+        if (!multi || stopping) {
+            transfer->response.error = "Error: CURL no inicializado";
+            if (transfer->on_done) {
+                transfer->on_done(std::move(transfer->response));
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            incoming.push_back(std::move(transfer));
+        }
+        curl_multi_wakeup(multi);
+    }
+
+public:
+    explicit HttpClient(const HttpClientOptions& options = HttpClientOptions())
+        : options(options), multi(nullptr), headers(nullptr), stopping(false) {
+        CurlGlobal::ensure();
+        multi = curl_multi_init();
+        if (!multi) {
+            std::cerr << "Error: No se pudo inicializar CURL" << std::endl;
+            return;
+        }
+        long connections = static_cast<long>(std::max(1, options.max_connections));
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, connections);
+        curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, connections * 4);
+        // "Expect:" vacío evita la espera de 100-continue con cuerpos de más de 1 KB
+        headers = curl_slist_append(headers, "Expect:");
+        for (const auto& header : options.headers) {
+            headers = curl_slist_append(headers, header.c_str());
+        }
+        loop = std::thread(&HttpClient::eventLoop, this);
+    }
+
+    // Termina las solicitudes pendientes y en curso antes de liberar las conexiones
+    ~HttpClient() {
+        stopping = true;
+        if (loop.joinable()) {
+            curl_multi_wakeup(multi);
+            loop.join();
+        }
+        for (CURL* easy : idle) {
+            curl_easy_cleanup(easy);
+        }
+        if (multi) {
+            curl_multi_cleanup(multi);
+        }
+        curl_slist_free_all(headers);
+    }
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    // POST de `body`; `on_data` recibe el cuerpo por fragmentos (si no, llega
+    // entero en la respuesta). timeout_ms < 0 usa el del cliente
+    void post(const std::string& url, const std::string& body, const DoneCallback& on_done,
+              const DataCallback& on_data = DataCallback(), long timeout_ms = -1) {
+        std::unique_ptr<Transfer> transfer(new Transfer());
+        transfer->url = url;
+        transfer->body = body;
+        transfer->post = true;
+        transfer->timeout_ms = timeout_ms >= 0 ? timeout_ms : options.timeout_ms;
+        transfer->on_data = on_data;
+        transfer->on_done = on_done;
+        enqueue(std::move(transfer));
+    }
+
+    void get(const std::string& url, const DoneCallback& on_done, long timeout_ms = -1) {
+        std::unique_ptr<Transfer> transfer(new Transfer());
+        transfer->url = url;
+        transfer->post = false;
+        transfer->timeout_ms = timeout_ms >= 0 ? timeout_ms : options.timeout_ms;
+        transfer->on_done = on_done;
+        enqueue(std::move(transfer));
+    }
+
+    // Versiones bloqueantes (no llamar desde un callback del cliente)
+    HttpResponse postAndWait(const std::string& url, const std::string& body, long timeout_ms = -1) {
+        std::shared_ptr<std::promise<HttpResponse>> promise = std::make_shared<std::promise<HttpResponse>>();
+        std::future<HttpResponse> future = promise->get_future();
+        post(url, body, [promise](HttpResponse&& response) { promise->set_value(std::move(response)); },
+             DataCallback(), timeout_ms);
+        return future.get();
+    }
+
+    HttpResponse getAndWait(const std::string& url, long timeout_ms = -1) {
+        std::shared_ptr<std::promise<HttpResponse>> promise = std::make_shared<std::promise<HttpResponse>>();
+        std::future<HttpResponse> future = promise->get_future();
+        get(url, [promise](HttpResponse&& response) { promise->set_value(std::move(response)); }, timeout_ms);
+        return future.get();
+    }
+
+    const HttpClientOptions& getOptions() const {
+        return options;
+    }
+};
+
+#endif // HTTP_CLIENT_H
\ No newline at end of file
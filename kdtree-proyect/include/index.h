@@ -0,0 +1,381 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <memory>
+#include <utility>
+#include "kdtree.h"
+#include "kdforest.h"
+#include "linear_search.h"
+#include "hnsw.h"
+#include "ivfpq.h"
+#include "dynamic_kdtree.h"
+#include "mapped_database.h"
+#include "thread_pool.h"
+
+// Interfaz común de los motores de búsqueda: construir sobre una base, consultar
+// uno o k vecinos (distancia de la métrica del motor, euclidiana por defecto,
+// e id del documento, de menor a mayor; ver Metric), resolver el texto de un
+// id y reportar memoria. Los parámetros de búsqueda que un motor no usa se ignoran.
+class Index {
+public:
+    virtual ~Index() {}
+
+    virtual std::string name() const = 0;
+
+    // Construir (o reconstruir) el índice sobre `data`
+    virtual void build(const std::vector<DataItem>& data) = 0;
+
+    // Construir sobre una base mapeada, que debe vivir más que el índice. Por
+    // defecto se copia a DataItem; los motores que guardan las filas en el
+    // orden de la base la usan sin copiar
+    virtual void build(const MappedDatabase& database) {
+        build(database.toDataItems());
+    }
+
+    virtual std::vector<Neighbor> kNearest(const Point& query, int k,
+                                           const SearchParams& params = SearchParams()) const = 0;
+
+    virtual Neighbor nearest(const Point& query, const SearchParams& params = SearchParams()) const {
+        std::vector<Neighbor> result = kNearest(query, 1, params);
+        if (result.empty()) {
+            return Neighbor(std::numeric_limits<double>::max(), -1);
+        }
+        return result[0];
+    }
+
+    // k vecinos para un lote de consultas repartido en `threads` hilos del pool
+    // compartido (0 = todos los núcleos)
+    virtual std::vector<std::vector<Neighbor>> nearestBatch(
+            const std::vector<Point>& queries, int k, int threads = 0,
+            const SearchParams& params = SearchParams()) const {
+        std::vector<std::vector<Neighbor>> results(queries.size());
+        if (threads <= 0) {
+            threads = ThreadPool::hardwareThreads();
+        }
+
+        ThreadPool::global().parallelFor(static_cast<int>(queries.size()), threads, [&](int q) {
+            results[q] = kNearest(queries[q], k, params);
+        });
+
+        return results;
+    }
+
+    // Texto del documento `id`; se pide solo para los resultados que se muestran
+    virtual std::string text(int id) const = 0;
+
+    virtual int size() const = 0;
+
+    // Memoria del índice por componente (ver memory_usage.h): vectores,
+    // estructura (nodos, grafo, ids), textos propios y memoria de trabajo
+    virtual MemoryUsage memoryUsage() const = 0;
+
+    size_t memoryBytes() const {
+        return memoryUsage().total();
+    }
+};
+
+class KDTreeIndex : public Index {
+private:
+    KDTreeOptions options;
+    std::unique_ptr<KDTree> tree;
+
+public:
+    explicit KDTreeIndex(const KDTreeOptions& options = KDTreeOptions()) : options(options) {}
+
+    // Si la base trae un árbol guardado con los mismos parámetros (incluida la
+    // métrica, ver KDTree::matches) se carga sin reconstruir; si no, se
+    // construye sobre la base sin copiar sus DataItem
+    void build(const MappedDatabase& database) override {
+        std::unique_ptr<KDTree> saved = KDTree::loadFromDatabase(database);
+        if (saved && saved->matches(options)) {
+            std::cout << "Árbol KD cargado desde la base (leaf_size = " << saved->getLeafSize() << ", tipo = "
+                      << elementTypeName(saved->getElementType()) << ", métrica = "
+                      << metricName(saved->getMetric()) << ")" << std::endl;
+            tree = std::move(saved);
+            return;
+        }
+        if (saved) {
+            std::cout << "El árbol guardado usa leaf_size = " << saved->getLeafSize() << ", tipo = "
+                      << elementTypeName(saved->getElementType()) << ", rerank = " << saved->getRerank()
+                      << ", métrica = " << metricName(saved->getMetric())
+                      << ", división = " << (saved->getSplitRule() == SplitRule::RoundRobin ? "round-robin" :
+                                             "varianza") << ", semilla = " << saved->getSeed()
+                      << "; se reconstruye con los parámetros pedidos" << std::endl;
+        }
+        tree.reset(new KDTree(database, options));
+    }
+
+    std::string name() const override {
+        return "KDTree";
+    }
+
+    void build(const std::vector<DataItem>& data) override {
+        tree.reset(new KDTree(data, options));
+    }
+
+    std::vector<Neighbor> kNearest(const Point& query, int k,
+                                   const SearchParams& params = SearchParams()) const override {
+        return tree->kNearest(query, k, params);
+    }
+
+    Neighbor nearest(const Point& query, const SearchParams& params = SearchParams()) const override {
+        return tree->nearest(query, params);
+    }
+
+    std::string text(int id) const override {
+        return tree->text(id);
+    }
+
+    int size() const override {
+        return tree ? tree->getPointCount() : 0;
+    }
+
+    MemoryUsage memoryUsage() const override {
+        return tree ? tree->memoryUsage() : MemoryUsage();
+    }
+};
+
+class KDForestIndex : public Index {
+private:
+    int num_trees;
+    KDTreeOptions options;
+    std::unique_ptr<KDForest> forest;
+
+public:
+    explicit KDForestIndex(int num_trees, const KDTreeOptions& options = KDTreeOptions())
+        : num_trees(num_trees), options(options) {}
+
+    std::string name() const override {
+        return "KDForest";
+    }
+
+    void build(const std::vector<DataItem>& data) override {
+        forest.reset(new KDForest(data, num_trees, options));
+    }
+
+    void build(const MappedDatabase& database) override {
+        forest.reset(new KDForest(database, num_trees, options));
+    }
+
+    std::vector<Neighbor> kNearest(const Point& query, int k,
+                                   const SearchParams& params = SearchParams()) const override {
+        return forest->kNearest(query, k, params);
+    }
+
+    std::string text(int id) const override {
+        return forest->text(id);
+    }
+
+    int size() const override {
+        return forest ? forest->getPointCount() : 0;
+    }
+
+    MemoryUsage memoryUsage() const override {
+        return forest ? forest->memoryUsage() : MemoryUsage();
+    }
+};
+
+// La búsqueda lineal es exacta: ignora los parámetros de búsqueda
+class LinearIndex : public Index {
+private:
+    ElementType element_type;
+    Metric metric;
+    std::unique_ptr<LinearSearch> search;
+
+public:
+    explicit LinearIndex(ElementType element_type = ElementType::Float64, Metric metric = Metric::L2)
+        : element_type(element_type), metric(metric) {}
+
+    std::string name() const override {
+        return "Linear";
+    }
+
+    void build(const std::vector<DataItem>& data) override {
+        search.reset(new LinearSearch(data, element_type, metric));
+    }
+
+    void build(const MappedDatabase& database) override {
+        search.reset(new LinearSearch(database, element_type, metric));
+    }
+
+    std::vector<Neighbor> kNearest(const Point& query, int k,
+                                   const SearchParams& = SearchParams()) const override {
+        return search->kNearest(query, k);
+    }
+
+    Neighbor nearest(const Point& query, const SearchParams& = SearchParams()) const override {
+        return search->nearest(query);
+    }
+
+    // Camino por bloques tipo GEMM de LinearSearch
+    std::vector<std::vector<Neighbor>> nearestBatch(
+            const std::vector<Point>& queries, int k, int threads = 0,
+            const SearchParams& = SearchParams()) const override {
+        return search->nearestBatch(queries, k, threads);
+    }
+
+    std::string text(int id) const override {
+        return search->text(id);
+    }
+
+    int size() const override {
+        return search ? static_cast<int>(search->getSize()) : 0;
+    }
+
+    // Vectores y la norma de cada fila (nada de eso si son una vista de la base)
+    MemoryUsage memoryUsage() const override {
+        return search ? search->memoryUsage() : MemoryUsage();
+    }
+};
+
+// HNSW: params.ef elige la lista de candidatos de la consulta (<= 0 = ef_search)
+class HNSWIndex : public Index {
+private:
+    HNSWOptions options;
+    std::unique_ptr<HNSW> graph;
+
+public:
+    explicit HNSWIndex(const HNSWOptions& options = HNSWOptions()) : options(options) {}
+
+    std::string name() const override {
+        return "HNSW";
+    }
+
+    void build(const std::vector<DataItem>& data) override {
+        graph.reset(new HNSW(data, options));
+    }
+
+    void build(const MappedDatabase& database) override {
+        graph.reset(new HNSW(database, options));
+    }
+
+    std::vector<Neighbor> kNearest(const Point& query, int k,
+                                   const SearchParams& params = SearchParams()) const override {
+        return graph->kNearest(query, k, params.ef);
+    }
+
+    std::string text(int id) const override {
+        return graph->text(id);
+    }
+
+    int size() const override {
+        return graph ? graph->getPointCount() : 0;
+    }
+
+    MemoryUsage memoryUsage() const override {
+        return graph ? graph->memoryUsage() : MemoryUsage();
+    }
+};
+
+// IVF-PQ: params.max_checks elige las listas a revisar (<= 0 = nprobe del índice)
+class IVFPQIndex : public Index {
+private:
+    IVFPQOptions options;
+    std::unique_ptr<IVFPQ> index;
+
+public:
+    explicit IVFPQIndex(const IVFPQOptions& options = IVFPQOptions()) : options(options) {}
+
+    std::string name() const override {
+        return "IVFPQ";
+    }
+
+    void build(const std::vector<DataItem>& data) override {
+        index.reset(new IVFPQ(data, options));
+    }
+
+    void build(const MappedDatabase& database) override {
+        index.reset(new IVFPQ(database, options));
+    }
+
+    std::vector<Neighbor> kNearest(const Point& query, int k,
+                                   const SearchParams& params = SearchParams()) const override {
+        return index->kNearest(query, k, params.max_checks);
+    }
+
+    std::string text(int id) const override {
+        return index->text(id);
+    }
+
+    int size() const override {
+        return index ? index->getPointCount() : 0;
+    }
+
+    MemoryUsage memoryUsage() const override {
+        return index ? index->memoryUsage() : MemoryUsage();
+    }
+};
+
+// KD-tree dinámico: acepta inserciones y borrados después de construirse
+// (getTree()); las consultas ven siempre una instantánea consistente
+class DynamicKDTreeIndex : public Index {
+private:
+    DynamicKDTreeOptions options;
+    std::unique_ptr<DynamicKDTree> tree;
+
+public:
+    explicit DynamicKDTreeIndex(const DynamicKDTreeOptions& options = DynamicKDTreeOptions())
+        : options(options) {}
+
+    using Index::build;
+
+    std::string name() const override {
+        return "DynamicKDTree";
+    }
+
+    void build(const std::vector<DataItem>& data) override {
+        tree.reset(new DynamicKDTree(data, options));
+    }
+
+    std::vector<Neighbor> kNearest(const Point& query, int k,
+                                   const SearchParams& params = SearchParams()) const override {
+        return tree->kNearest(query, k, params);
+    }
+
+    std::string text(int id) const override {
+        return tree->text(id);
+    }
+
+    int size() const override {
+        return tree ? tree->size() : 0;
+    }
+
+    MemoryUsage memoryUsage() const override {
+        return tree ? tree->memoryUsage() : MemoryUsage();
+    }
+
+    DynamicKDTree& getTree() {
+        return *tree;
+    }
+};
+
+// Motor por nombre ("kdtree", "forest", "hnsw", "ivfpq", "linear", "dynamic"); nullptr si no
+// existe. La métrica sale de tree_options (la de HNSW e IVF-PQ, de sus opciones)
+inline std::unique_ptr<Index> createIndex(const std::string& engine, const KDTreeOptions& tree_options,
+                                          int forest_trees, const HNSWOptions& hnsw_options,
+                                          const IVFPQOptions& ivfpq_options = IVFPQOptions()) {
+    if (engine == "kdtree") {
+        return std::unique_ptr<Index>(new KDTreeIndex(tree_options));
+    }
+    if (engine == "forest") {
+        return std::unique_ptr<Index>(new KDForestIndex(forest_trees, tree_options));
+    }
+    if (engine == "hnsw") {
+        return std::unique_ptr<Index>(new HNSWIndex(hnsw_options));
+    }
+    if (engine == "ivfpq") {
+        return std::unique_ptr<Index>(new IVFPQIndex(ivfpq_options));
+    }
+    if (engine == "linear") {
+        return std::unique_ptr<Index>(new LinearIndex(tree_options.element_type, tree_options.metric));
+    }
+    if (engine == "dynamic") {
+        return std::unique_ptr<Index>(new DynamicKDTreeIndex(DynamicKDTreeOptions(tree_options)));
+    }
+    return std::unique_ptr<Index>();
+}
+
+#endif // INDEX_H
\ No newline at end of file
@@ -0,0 +1,558 @@
+#ifndef IVFPQ_H
+#define IVFPQ_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <cstdint>
+#include <cmath>
+#include "kdtree.h"
+#include "mapped_database.h"
+#include "thread_pool.h"
+#include "topk.h"
+#include "vector_store.h"
+
+// Centroides por subespacio del PQ: un byte por código
+const int kPQCentroids = 256;
+
+// Parámetros del índice IVF-PQ
+struct IVFPQOptions {
+    int nlist;          // Listas invertidas, centroides del cuantizador grueso (0 = 4 * sqrt(n))
+    int m;              // Subespacios del PQ = bytes por vector
+    int nprobe;         // Listas a revisar por defecto en cada consulta
+    int rerank;         // Candidatos a re-rankear con los vectores completos (0 = sin re-rank)
+    int train_size;     // Vectores de la muestra de entrenamiento (0 = 64 por centroide)
+    int iterations;     // Iteraciones de k-means
+    int build_threads;  // Hilos del entrenamiento y la codificación (0 = todos los núcleos)
+    bool precompute;    // Términos de cada lista precalculados (nlist * m * 256 floats, ver IVFPQ);
+                        // apagado por defecto: salvo con nlist < n / 1024 la tabla ocupa más que los códigos
+    unsigned int seed;  // Semilla de la muestra y de los centroides iniciales
+    Metric metric;      // Métrica de las búsquedas (ver vector_store.h)
+
+    explicit IVFPQOptions(int nlist = 0, int m = 48, int nprobe = 8, int rerank = 0)
+        : nlist(nlist), m(m), nprobe(nprobe), rerank(rerank), train_size(0), iterations(10),
+          build_threads(0), precompute(false), seed(42), metric(Metric::L2) {}
+};
+
+// Distancias al cuadrado de `x` (dim componentes) a los k centroides guardados
+// por componente (componente d del centroide c en transposed[d * k + c]): el
+// bucle interno recorre los centroides y el compilador lo vectoriza
+inline void centroidDistances(const float* x, const float* transposed, int dim, int k, float* out) {
+    std::fill(out, out + k, 0.0f);
+    for (int d = 0; d < dim; d++) {
+        const float* column = transposed + static_cast<size_t>(d) * k;
+        float v = x[d];
+        for (int c = 0; c < k; c++) {
+            float diff = v - column[c];
+            out[c] += diff * diff;
+        }
+    }
+}
+
+// -x.c para los k centroides (mismo formato que centroidDistances): con
+// producto interno, menor sigue siendo mejor
+inline void centroidNegativeDots(const float* x, const float* transposed, int dim, int k, float* out) {
+    std::fill(out, out + k, 0.0f);
+    for (int d = 0; d < dim; d++) {
+        const float* column = transposed + static_cast<size_t>(d) * k;
+        float v = x[d];
+        for (int c = 0; c < k; c++) {
+            out[c] -= v * column[c];
+        }
+    }
+}
+
+// Centroides de k filas de dim componentes (row-major) guardados por componente
+inline std::vector<float> transposeCentroids(const std::vector<float>& centroids, int k, int dim) {
+    std::vector<float> transposed(static_cast<size_t>(k) * dim);
+    for (int c = 0; c < k; c++) {
+        for (int d = 0; d < dim; d++) {
+            transposed[static_cast<size_t>(d) * k + c] = centroids[static_cast<size_t>(c) * dim + d];
+        }
+    }
+    return transposed;
+}
+
+inline int argMin(const float* values, int n) {
+    return static_cast<int>(std::min_element(values, values + n) - values);
+}
+
+// k-means de Lloyd sobre `n` filas de `dim` floats: parte de k filas distintas
+// al azar y, si un grupo queda vacío, parte en dos el más grande. La
+// asignación se reparte en `threads` hilos. Devuelve los centroides por
+// componente (ver centroidDistances)
+inline std::vector<float> trainKMeans(const float* data, int n, int dim, int k, int iterations,
+                                      std::mt19937& rng, int threads) {
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    for (int c = 0; c < k; c++) {
+        std::uniform_int_distribution<int> pick(c, n - 1);
+        std::swap(order[c], order[pick(rng)]);
+    }
+    std::vector<float> centroids(static_cast<size_t>(k) * dim);
+    for (int c = 0; c < k; c++) {
+        std::copy(data + static_cast<size_t>(order[c]) * dim, data + static_cast<size_t>(order[c] + 1) * dim,
+                  centroids.begin() + static_cast<size_t>(c) * dim);
+    }
+
+    const int block = 256;
+    int num_blocks = (n + block - 1) / block;
+    std::vector<int> assignment(n);
+    for (int it = 0; it < iterations; it++) {
+        std::vector<float> transposed = transposeCentroids(centroids, k, dim);
+        ThreadPool::global().parallelFor(num_blocks, threads, [&](int b) {
+            std::vector<float> dist(k);
+            for (int i = b * block; i < std::min(n, (b + 1) * block); i++) {
+                centroidDistances(data + static_cast<size_t>(i) * dim, transposed.data(), dim, k, dist.data());
+                assignment[i] = argMin(dist.data(), k);
+            }
+        });
+
+        std::vector<double> sums(static_cast<size_t>(k) * dim, 0.0);
+        std::vector<int> counts(k, 0);
+        for (int i = 0; i < n; i++) {
+            const float* row = data + static_cast<size_t>(i) * dim;
+            double* sum = sums.data() + static_cast<size_t>(assignment[i]) * dim;
+            for (int d = 0; d < dim; d++) {
+                sum[d] += row[d];
+            }
+            counts[assignment[i]]++;
+        }
+        for (int c = 0; c < k; c++) {
+            if (counts[c] == 0) {
+                continue;
+            }
+            for (int d = 0; d < dim; d++) {
+                centroids[static_cast<size_t>(c) * dim + d] =
+                    static_cast<float>(sums[static_cast<size_t>(c) * dim + d] / counts[c]);
+            }
+        }
+        for (int c = 0; c < k; c++) {
+            if (counts[c] > 0) {
+                continue;
+            }
+            int largest = static_cast<int>(std::max_element(counts.begin(), counts.end()) - counts.begin());
+            for (int d = 0; d < dim; d++) {
+                float v = centroids[static_cast<size_t>(largest) * dim + d];
+                centroids[static_cast<size_t>(c) * dim + d] = v * (1.0f + 1e-4f);
+                centroids[static_cast<size_t>(largest) * dim + d] = v * (1.0f - 1e-4f);
+            }
+            counts[c] = counts[largest] / 2;
+            counts[largest] -= counts[c];
+        }
+    }
+    return transposeCentroids(centroids, k, dim);
+}
+
+// Índice de listas invertidas con cuantización por producto (IVF-PQ) para
+// bases que no caben en memoria ni en float32. Un k-means grueso reparte los
+// vectores en nlist listas; cada vector guarda el id y m bytes: el código de
+// su residuo (vector menos centroide de la lista) en cada uno de m
+// subespacios, con 256 centroides por subespacio entrenados sobre una muestra.
+// La consulta revisa las nprobe listas de centroide más cercano; por lista
+// arma una tabla con la distancia de su residuo a cada centroide de cada
+// subespacio y la distancia a un vector es la suma de m entradas (distancia
+// asimétrica, adcDistance). Con rerank > k los mejores candidatos se
+// recalculan con los vectores completos, leídos de la base mapeada sin copiar.
+//
+// La tabla de una lista sale de ||q - c - r||^2 = ||q - c||^2 + (||r||^2 + 2 c.r) - 2 q.r:
+// el primer término es la distancia al centroide grueso, el segundo depende
+// solo de la lista y se puede precalcular al construir (precompute), y el
+// tercero se calcula una vez por consulta; así cada lista cuesta una suma de
+// tablas en lugar de las m * 256 distancias de su residuo. Esa tabla ocupa
+// nlist * m * 256 floats, más que los m bytes por vector de los códigos con
+// el nlist por defecto, así que sin precompute se calculan las distancias.
+// Coseno normaliza filas y consultas y se resuelve como L2; producto interno
+// usa q.c + q.r con la misma tabla para todas las listas.
+class IVFPQ {
+private:
+    int count;
+    int dims;
+    int m;
+    int dsub;                        // Componentes por subespacio (dims se rellena con ceros hasta m * dsub)
+    int ksub;                        // Centroides por subespacio (menos de 256 solo con muestras chicas)
+    int nlist;
+    int nprobe;
+    int rerank;
+    Metric metric;
+    std::vector<float> coarse;       // Centroides gruesos por componente (ver centroidDistances)
+    std::vector<float> codebooks;    // Un libro de ksub centroides por subespacio, también por componente
+    std::vector<float> list_terms;   // ||r||^2 + 2 c.r de cada lista, subespacio y centroide (si se precalcula)
+    std::vector<int> list_offsets;   // Inicio de cada lista en list_ids y list_codes (nlist + 1)
+    std::vector<int> list_ids;       // Ids agrupados por lista
+    std::vector<uint8_t> list_codes; // m bytes por vector, en el orden de list_ids
+    VectorStore exact;               // Vectores completos del re-rank (vista de la base o copia float32)
+    TextTable texts;                 // Tabla de textos indexada por id
+
+    // Memoria de trabajo de búsqueda por hilo
+    struct SearchScratch {
+        std::vector<float> query;      // Consulta en float con el relleno (normalizada con coseno)
+        std::vector<float> residual;
+        std::vector<float> coarse_dist;
+        std::vector<std::pair<float, int>> probes;
+        std::vector<float> table;      // m * ksub entradas
+        std::vector<float> query_terms; // -2 q.r (o -q.r con producto interno) por subespacio y centroide
+        TopK top;
+        std::vector<std::pair<double, int>> rows;
+        VectorStore::Query exact_query;
+
+        static SearchScratch& local() {
+            static thread_local SearchScratch scratch;
+            return scratch;
+        }
+
+        size_t memoryBytes() const {
+            return vectorBytes(query) + vectorBytes(residual) + vectorBytes(coarse_dist) + vectorBytes(probes) +
+                   vectorBytes(table) + vectorBytes(query_terms) + top.memoryBytes() + vectorBytes(rows) + VectorStore::queryBytes(exact_query);
+        }
+    };
+
+    int paddedDimensions() const {
+        return m * dsub;
+    }
+
+    // Fila como floats con el relleno, normalizada con coseno
+    void loadRow(const Point& point, float* out) const {
+        double factor = metric == Metric::Cosine ? unitScale(point) : 1.0;
+        for (int d = 0; d < dims; d++) {
+            out[d] = static_cast<float>(point(d) * factor);
+        }
+        std::fill(out + dims, out + paddedDimensions(), 0.0f);
+    }
+
+    // Residuo de `x` respecto del centroide grueso `list`
+    void residualOf(const float* x, int list, float* out) const {
+        for (int d = 0; d < paddedDimensions(); d++) {
+            out[d] = x[d] - coarse[static_cast<size_t>(d) * nlist + list];
+        }
+    }
+
+    const float* codebook(int j) const {
+        return codebooks.data() + static_cast<size_t>(j) * dsub * ksub;
+    }
+
+    // Lista y código PQ de `x`; `residual` y `dist` son memoria de trabajo
+    int encode(const float* x, uint8_t* code, float* residual, std::vector<float>& dist) const {
+        centroidDistances(x, coarse.data(), paddedDimensions(), nlist, dist.data());
+        int list = argMin(dist.data(), nlist);
+        residualOf(x, list, residual);
+        for (int j = 0; j < m; j++) {
+            centroidDistances(residual + j * dsub, codebook(j), dsub, ksub, dist.data());
+            code[j] = static_cast<uint8_t>(argMin(dist.data(), ksub));
+        }
+        return list;
+    }
+
+    // Entrenar los cuantizadores sobre una muestra de `rows` y codificar todas
+    // las filas (ItemRows o DatabaseRows, ver kdtree.h)
+    template <typename Rows>
+    void build(const Rows& rows, const IVFPQOptions& options) {
+        count = rows.size();
+        dims = rows.dimensions();
+        list_offsets.assign(1, 0);
+        if (count <= 0 || dims <= 0) {
+            count = 0;
+            nlist = 0;
+            return;
+        }
+        m = std::min(std::max(1, options.m), dims);
+        dsub = (dims + m - 1) / m;
+        int padded = paddedDimensions();
+        int threads = options.build_threads > 0 ? options.build_threads : ThreadPool::hardwareThreads();
+        int iterations = std::max(1, options.iterations);
+        std::mt19937 rng(options.seed);
+
+        // Muestra de entrenamiento sin reemplazo
+        nlist = options.nlist > 0 ? options.nlist : static_cast<int>(4.0 * std::sqrt(static_cast<double>(count)));
+        int train = options.train_size > 0 ? options.train_size : 64 * std::max(nlist, kPQCentroids);
+        train = std::min(train, count);
+        std::vector<int> sample(count);
+        std::iota(sample.begin(), sample.end(), 0);
+        for (int s = 0; s < train; s++) {
+            std::uniform_int_distribution<int> pick(s, count - 1);
+            std::swap(sample[s], sample[pick(rng)]);
+        }
+        std::vector<float> train_rows(static_cast<size_t>(train) * padded);
+        for (int s = 0; s < train; s++) {
+            loadRow(rows.point(sample[s]), &train_rows[static_cast<size_t>(s) * padded]);
+        }
+
+        nlist = std::min(std::max(1, nlist), train);
+        coarse = trainKMeans(train_rows.data(), train, padded, nlist, iterations, rng, threads);
+
+        // Residuos de la muestra y un k-means por subespacio
+        ksub = std::min(kPQCentroids, train);
+        std::vector<float> dist(std::max(nlist, ksub));
+        std::vector<float> train_residuals(train_rows.size());
+        for (int s = 0; s < train; s++) {
+            const float* x = &train_rows[static_cast<size_t>(s) * padded];
+            centroidDistances(x, coarse.data(), padded, nlist, dist.data());
+            residualOf(x, argMin(dist.data(), nlist), &train_residuals[static_cast<size_t>(s) * padded]);
+        }
+        codebooks.resize(static_cast<size_t>(m) * dsub * ksub);
+        std::vector<float> subspace(static_cast<size_t>(train) * dsub);
+        for (int j = 0; j < m; j++) {
+            for (int s = 0; s < train; s++) {
+                std::copy(&train_residuals[static_cast<size_t>(s) * padded + j * dsub],
+                          &train_residuals[static_cast<size_t>(s) * padded + (j + 1) * dsub],
+                          &subspace[static_cast<size_t>(s) * dsub]);
+            }
+            std::vector<float> book = trainKMeans(subspace.data(), train, dsub, ksub, iterations, rng, threads);
+            std::copy(book.begin(), book.end(), codebooks.begin() + static_cast<size_t>(j) * dsub * ksub);
+        }
+
+        // Términos de cada lista: ||r||^2 + 2 c.r sobre los centroides de cada subespacio
+        list_terms.clear();
+        if (options.precompute && metric != Metric::InnerProduct) {
+            list_terms.resize(static_cast<size_t>(nlist) * m * ksub);
+            for (int l = 0; l < nlist; l++) {
+                for (int j = 0; j < m; j++) {
+                    float* terms = &list_terms[(static_cast<size_t>(l) * m + j) * ksub];
+                    for (int c = 0; c < ksub; c++) {
+                        double sum = 0.0;
+                        for (int d = 0; d < dsub; d++) {
+                            double r = codebook(j)[static_cast<size_t>(d) * ksub + c];
+                            sum += r * r + 2.0 * coarse[static_cast<size_t>(j * dsub + d) * nlist + l] * r;
+                        }
+                        terms[c] = static_cast<float>(sum);
+                    }
+                }
+            }
+        }
+
+        // Codificar todas las filas y agruparlas por lista
+        std::vector<int> row_list(count);
+        std::vector<uint8_t> row_codes(static_cast<size_t>(count) * m);
+        const int block = 256;
+        ThreadPool::global().parallelFor((count + block - 1) / block, threads, [&](int b) {
+            std::vector<float> x(padded);
+            std::vector<float> residual(padded);
+            std::vector<float> scratch(std::max(nlist, ksub));
+            for (int i = b * block; i < std::min(count, (b + 1) * block); i++) {
+                loadRow(rows.point(i), x.data());
+                row_list[i] = encode(x.data(), &row_codes[static_cast<size_t>(i) * m], residual.data(), scratch);
+            }
+        });
+
+        list_offsets.assign(nlist + 1, 0);
+        for (int i = 0; i < count; i++) {
+            list_offsets[row_list[i] + 1]++;
+        }
+        std::partial_sum(list_offsets.begin(), list_offsets.end(), list_offsets.begin());
+        std::vector<int> fill(list_offsets.begin(), list_offsets.end() - 1);
+        list_ids.resize(count);
+        list_codes.resize(static_cast<size_t>(count) * m);
+        for (int i = 0; i < count; i++) {
+            int slot = fill[row_list[i]]++;
+            list_ids[slot] = rows.id(i);
+            std::copy(&row_codes[static_cast<size_t>(i) * m], &row_codes[static_cast<size_t>(i + 1) * m],
+                      &list_codes[static_cast<size_t>(slot) * m]);
+        }
+    }
+
+    // Candidatos (distancia reportada, id) de menor a mayor en scratch.rows
+    void searchIds(const Point& query, int k, int probes, SearchScratch& scratch) const {
+        scratch.rows.clear();
+        if (count == 0 || k <= 0) {
+            return;
+        }
+        SearchCounters::query();
+        int padded = paddedDimensions();
+        scratch.query.resize(padded);
+        scratch.residual.resize(padded);
+        scratch.coarse_dist.resize(nlist);
+        scratch.table.resize(static_cast<size_t>(m) * ksub);
+        loadRow(query, scratch.query.data());
+        const float* q = scratch.query.data();
+        bool inner_product = metric == Metric::InnerProduct;
+
+        // Listas a revisar: centroide más cercano (o de mayor producto interno)
+        SearchCounters::distance(nlist);
+        if (inner_product) {
+            centroidNegativeDots(q, coarse.data(), padded, nlist, scratch.coarse_dist.data());
+        } else {
+            centroidDistances(q, coarse.data(), padded, nlist, scratch.coarse_dist.data());
+        }
+        probes = std::min(nlist, probes > 0 ? probes : nprobe);
+        scratch.probes.resize(nlist);
+        for (int l = 0; l < nlist; l++) {
+            scratch.probes[l] = std::make_pair(scratch.coarse_dist[l], l);
+        }
+        std::partial_sort(scratch.probes.begin(), scratch.probes.begin() + probes, scratch.probes.end());
+
+        // -q.r por subespacio: con producto interno es la tabla de todas las
+        // listas y con términos precalculados, la mitad de la parte de la consulta
+        bool precomputed = !list_terms.empty();
+        if (inner_product || precomputed) {
+            scratch.query_terms.resize(scratch.table.size());
+            for (int j = 0; j < m; j++) {
+                centroidNegativeDots(q + j * dsub, codebook(j), dsub, ksub,
+                                     &scratch.query_terms[static_cast<size_t>(j) * ksub]);
+            }
+        }
+        if (precomputed) {
+            for (size_t i = 0; i < scratch.query_terms.size(); i++) {
+                scratch.query_terms[i] *= 2.0f;
+            }
+        }
+        const float* table = inner_product ? scratch.query_terms.data() : scratch.table.data();
+
+        bool use_rerank = exact.size() > 0 && rerank > k;
+        TopK& top = scratch.top;
+        top.reset(use_rerank ? rerank : k);
+        for (int p = 0; p < probes; p++) {
+            int list = scratch.probes[p].second;
+            double base = 0.0;
+            if (inner_product) {
+                base = scratch.probes[p].first;
+            } else if (precomputed) {
+                base = scratch.probes[p].first;
+                const float* terms = &list_terms[static_cast<size_t>(list) * m * ksub];
+                for (size_t i = 0; i < scratch.table.size(); i++) {
+                    scratch.table[i] = terms[i] + scratch.query_terms[i];
+                }
+            } else {
+                residualOf(q, list, scratch.residual.data());
+                for (int j = 0; j < m; j++) {
+                    centroidDistances(scratch.residual.data() + j * dsub, codebook(j), dsub, ksub,
+                                      &scratch.table[static_cast<size_t>(j) * ksub]);
+                }
+            }
+            SearchCounters::explored();
+            SearchCounters::distance(list_offsets[list + 1] - list_offsets[list]);
+            for (int e = list_offsets[list]; e < list_offsets[list + 1]; e++) {
+                double dist = base + adcDistance(table, &list_codes[static_cast<size_t>(e) * m], m, ksub);
+                if (dist < top.threshold()) {
+                    top.push(dist, list_ids[e]);
+                }
+            }
+        }
+        top.extractSorted(scratch.rows);
+
+        if (use_rerank) {
+            exact.prepare(query, scratch.exact_query);
+            rerankCandidates(exact, scratch.exact_query, scratch.rows, k);
+            for (size_t i = 0; i < scratch.rows.size(); i++) {
+                scratch.rows[i].first = exact.reportedDistance(scratch.rows[i].first, scratch.exact_query.norm2);
+            }
+            return;
+        }
+        for (size_t i = 0; i < scratch.rows.size(); i++) {
+            scratch.rows[i].first = reportedDistance(scratch.rows[i].first);
+        }
+    }
+
+    // Distancia reportada a partir de la asimétrica (ver Metric)
+    double reportedDistance(double dist) const {
+        switch (metric) {
+            case Metric::Cosine: return dist / 2.0;
+            case Metric::InnerProduct: return dist;
+            default: return std::sqrt(std::max(0.0, dist));
+        }
+    }
+
+    void reset(const IVFPQOptions& options) {
+        count = 0;
+        dims = 0;
+        m = 1;
+        dsub = 1;
+        ksub = 1;
+        nlist = 0;
+        nprobe = std::max(1, options.nprobe);
+        rerank = std::max(0, options.rerank);
+        metric = options.metric;
+    }
+
+public:
+    // Sobre un vector de DataItem; con re-rank se guarda una copia float32 de
+    // los vectores (la única parte que no está comprimida)
+    IVFPQ(const std::vector<DataItem>& data, const IVFPQOptions& options = IVFPQOptions()) {
+        reset(options);
+        build(ItemRows{data}, options);
+        if (rerank > 0 && count > 0) {
+            exact.build(ElementType::Float32, dims, count, [&](int i) -> const Point& { return data[i].embedding; },
+                        false, metric);
+        }
+        texts.assign(data);
+    }
+
+    // Sobre una base mapeada (p. ej. la que deja la ingesta del JSONL): se
+    // entrena y codifica leyendo sus filas, sin copiarlas, y el re-rank usa las
+    // filas del archivo. Si no se pueden usar tal cual (coseno con filas sin
+    // norma 1) el re-rank trabaja sobre una copia float32. `database` debe
+    // vivir más que el índice.
+    IVFPQ(const MappedDatabase& database, const IVFPQOptions& options = IVFPQOptions()) {
+        reset(options);
+        build(DatabaseRows{database, 0, database.size()}, options);
+        if (rerank > 0 && count > 0 &&
+            !exact.view(database.getElementType(), dims, count, database.getStride(), database.rows(), metric)) {
+            exact.build(ElementType::Float32, dims, count, [&](int i) { return database.embedding(i); }, false,
+                        metric);
+        }
+        texts.view(database);
+    }
+
+    // k vecinos; `probes` <= 0 usa el nprobe del índice
+    std::vector<Neighbor> kNearest(const Point& query, int k, int probes = 0) const {
+        SearchScratch& scratch = SearchScratch::local();
+        searchIds(query, k, probes, scratch);
+        return scratch.rows;
+    }
+
+    Neighbor nearest(const Point& query, int probes = 0) const {
+        std::vector<Neighbor> result = kNearest(query, 1, probes);
+        if (result.empty()) {
+            return Neighbor(std::numeric_limits<double>::max(), -1);
+        }
+        return result[0];
+    }
+
+    std::string text(int id) const {
+        return texts[id];
+    }
+
+    int getPointCount() const {
+        return count;
+    }
+
+    int getListCount() const {
+        return nlist;
+    }
+
+    int getSubspaces() const {
+        return m;
+    }
+
+    void setNprobe(int probes) {
+        nprobe = std::max(1, probes);
+    }
+
+    int getNprobe() const {
+        return nprobe;
+    }
+
+    // Bytes de los códigos PQ (sin ids ni re-rank)
+    size_t getCodeBytes() const {
+        return vectorBytes(list_codes);
+    }
+
+    // Memoria por componente: códigos y vectores propios del re-rank, los
+    // cuantizadores con listas e ids, los términos precalculados aparte, los
+    // textos y la memoria de trabajo del hilo
+    MemoryUsage memoryUsage() const {
+        MemoryUsage usage;
+        usage.vectors = vectorBytes(list_codes) + exact.memoryBytes();
+        usage.structure = sizeof(*this) + vectorBytes(coarse) + vectorBytes(codebooks) +
+                          vectorBytes(list_offsets) + vectorBytes(list_ids);
+        usage.tables = vectorBytes(list_terms);
+        usage.payload = texts.memoryBytes();
+        usage.scratch = SearchScratch::local().memoryBytes();
+        return usage;
+    }
+};
+
+#endif // IVFPQ_H
\ No newline at end of file
@@ -0,0 +1,259 @@
+#ifndef JSONL_INGEST_H
+#define JSONL_INGEST_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cctype>
+#include <functional>
+#include <json/json.h>
+#include "data_item.h"
+#include "embeddings.h"
+#include "thread_pool.h"
+
+// Ingesta de un JSONL (una línea ["título", "contenido"] por registro) en tres
+// etapas conectadas por colas acotadas:
+//
+//   lector (bloques de bytes cortados en fin de línea)
+//     -> trabajadores (parseo JSON + embedding, un bloque a la vez)
+//     -> escritor (el hilo que llama, entrega los bloques en el orden del archivo)
+//
+// Como mucho hay `queue_chunks` bloques en vuelo, así que la memoria no
+// depende del tamaño del archivo. Cada registro existe una sola vez: los bytes
+// del bloque se liberan al terminar de procesarlo y los DataItem se mueven al
+// consumidor, que debe vaciarlos.
+struct IngestOptions {
+    int threads;        // Trabajadores de parseo + embedding (0 = todos los núcleos)
+    size_t chunk_bytes; // Bytes leídos por bloque (crece si una línea no cabe)
+    int queue_chunks;   // Bloques en vuelo como máximo (0 = dos por trabajador)
+    int max_lines;      // Líneas a leer (-1 = todo el archivo)
+
+    IngestOptions(int threads = 0, size_t chunk_bytes = 256 * 1024, int queue_chunks = 0, int max_lines = -1)
+        : threads(threads), chunk_bytes(chunk_bytes), queue_chunks(queue_chunks), max_lines(max_lines) {}
+};
+
+struct IngestStats {
+    long long lines;   // Líneas leídas
+    long long records; // Registros entregados
+    long long skipped; // Líneas no vacías que no son un registro válido
+    double seconds;
+    int threads;
+
+    IngestStats() : lines(0), records(0), skipped(0), seconds(0), threads(0) {}
+
+    double recordsPerSecond() const {
+        return seconds > 0 ? records / seconds : 0.0;
+    }
+};
+
+// Recibe cada bloque de registros en orden; devolver false detiene la ingesta
+typedef std::function<bool(std::vector<DataItem>&)> IngestSink;
+
+namespace ingest_detail {
+
+// Bloque de líneas en vuelo: lo llena el lector, lo procesa un trabajador y lo
+// consume el escritor cuando `ready` se cumple
+struct Chunk {
+    std::string bytes;
+    long long lines;
+    long long skipped;
+    std::vector<DataItem> items;
+    std::promise<void> done;
+    std::future<void> ready;
+
+    Chunk() : lines(0), skipped(0), ready(done.get_future()) {}
+};
+
+// Recorta `bytes` a sus primeras `max_lines` líneas (< 0 = sin límite) y
+// devuelve cuántas contiene; la última puede no terminar en '\n'
+inline long long takeLines(std::string& bytes, long long max_lines) {
+    long long lines = 0;
+    size_t pos = 0;
+    while (pos < bytes.size() && (max_lines < 0 || lines < max_lines)) {
+        const void* newline = std::memchr(bytes.data() + pos, '\n', bytes.size() - pos);
+        pos = newline ? static_cast<const char*>(newline) - bytes.data() + 1 : bytes.size();
+        lines++;
+    }
+    bytes.resize(pos);
+    return lines;
+}
+
+// Parsear y embeber cada línea del bloque, reutilizando el parser del trabajador
+inline void processChunk(Chunk& chunk, Json::CharReader& reader, DeterministicEmbedder& embedder) {
+    const char* p = chunk.bytes.data();
+    const char* end = p + chunk.bytes.size();
+    Json::Value value;
+    std::string errors;
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* line_end = newline ? newline : end;
+        const char* q = p;
+        while (q < line_end && std::isspace(static_cast<unsigned char>(*q))) {
+            q++;
+        }
+        if (q < line_end) {
+            // Formato esperado: ["título", "contenido"]
+            if (reader.parse(q, line_end, &value, &errors) && value.isArray() && value.size() >= 2 &&
+                value[1].isString()) {
+                DataItem item;
+                item.text = value[1].asString();
+                embedder.getEmbedding(item.text, item.embedding);
+                chunk.items.push_back(std::move(item));
+            } else {
+                chunk.skipped++;
+            }
+        }
+        p = line_end + 1;
+    }
+    std::string().swap(chunk.bytes);
+}
+
+} // namespace ingest_detail
+
+// Ingerir `filename` entregando los registros a `sink` en el orden del archivo.
+// getEmbedding es seguro entre hilos, así que todos los trabajadores comparten
+// el embedder (y su caché de tokens). Devuelve false si el archivo no se pudo abrir o el sink se detuvo.
+inline bool ingestJsonl(const std::string& filename, DeterministicEmbedder& embedder, const IngestSink& sink,
+                        const IngestOptions& options = IngestOptions(), IngestStats* stats_out = nullptr) {
+    using ingest_detail::Chunk;
+    typedef std::shared_ptr<Chunk> ChunkPtr;
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: No se pudo abrir el archivo " << filename << std::endl;
+        return false;
+    }
+
+    IngestStats stats;
+    stats.threads = options.threads > 0 ? options.threads : ThreadPool::hardwareThreads();
+    size_t in_flight = options.queue_chunks > 0 ? options.queue_chunks : 2 * stats.threads;
+    size_t chunk_bytes = std::max<size_t>(1, options.chunk_bytes);
+
+    // `pending` lleva los bloques en orden al escritor y acota los que hay en
+    // vuelo; `work` los reparte entre los trabajadores
+    BoundedQueue<ChunkPtr> pending(in_flight);
+    BoundedQueue<ChunkPtr> work(in_flight);
+    std::atomic<bool> cancelled(false);
+    long long lines_read = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::thread reader([&]() {
+        std::vector<char> block(chunk_bytes);
+        std::string carry;
+        long long remaining = options.max_lines;
+        bool more = remaining != 0;
+        while (more && !cancelled) {
+            file.read(block.data(), block.size());
+            size_t got = static_cast<size_t>(file.gcount());
+            std::string bytes;
+            bytes.swap(carry);
+            bytes.append(block.data(), got);
+
+            // Cortar en el último fin de línea; el resto pasa al bloque siguiente
+            if (got == block.size()) {
+                size_t cut = bytes.rfind('\n');
+                if (cut == std::string::npos) {
+                    carry.swap(bytes);
+                    continue;
+                }
+                carry.assign(bytes, cut + 1, std::string::npos);
+                bytes.resize(cut + 1);
+            } else {
+                more = false;
+            }
+
+            ChunkPtr chunk = std::make_shared<Chunk>();
+            chunk->lines = ingest_detail::takeLines(bytes, remaining);
+            if (remaining >= 0) {
+                remaining -= chunk->lines;
+                more = more && remaining > 0;
+            }
+            lines_read += chunk->lines;
+            if (chunk->lines == 0) {
+                continue;
+            }
+            chunk->bytes.swap(bytes);
+            if (!pending.push(chunk) || !work.push(chunk)) {
+                break;
+            }
+        }
+        work.close();
+        pending.close();
+    });
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < stats.threads; t++) {
+        workers.push_back(std::thread([&]() {
+            Json::CharReaderBuilder builder;
+            std::unique_ptr<Json::CharReader> json(builder.newCharReader());
+            ChunkPtr chunk;
+            while (work.pop(chunk)) {
+                if (!cancelled) {
+                    ingest_detail::processChunk(*chunk, *json, embedder);
+                }
+                chunk->done.set_value();
+                chunk.reset();
+            }
+        }));
+    }
+
+    // Escritor: consumir los bloques en orden a medida que se completan
+    const long long progress_every = 100000;
+    long long reported = 0;
+    bool ok = true;
+    ChunkPtr chunk;
+    while (pending.pop(chunk)) {
+        chunk->ready.wait();
+        stats.records += chunk->items.size();
+        stats.skipped += chunk->skipped;
+        if (!sink(chunk->items)) {
+            ok = false;
+            cancelled = true;
+            pending.close();
+            work.close();
+            break;
+        }
+        chunk.reset();
+
+        if (stats.records / progress_every != reported / progress_every) {
+            reported = stats.records;
+            double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            std::cout << "Procesados " << stats.records << " elementos ("
+                      << static_cast<long long>(stats.records / elapsed) << " registros/s)..." << std::endl;
+        }
+    }
+    chunk.reset();
+
+    reader.join();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    stats.lines = lines_read;
+    stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    if (ok) {
+        std::cout << "Ingeridos " << stats.records << " registros de " << stats.lines << " líneas ("
+                  << stats.skipped << " omitidas) en " << stats.seconds << " s: "
+                  << static_cast<long long>(stats.recordsPerSecond()) << " registros/s con "
+                  << stats.threads << " hilos" << std::endl;
+        TokenEmbeddingCache& cache = embedder.getCache();
+        uint64_t lookups = cache.getHits() + cache.getMisses();
+        std::cout << "Caché de tokens: " << cache.size() << " tokens, "
+                  << (lookups > 0 ? 100.0 * cache.getHits() / lookups : 0.0) << "% aciertos ("
+                  << cache.memoryBytes() / 1024 << " KB)" << std::endl;
+    }
+    if (stats_out) {
+        *stats_out = stats;
+    }
+    return ok;
+}
+
+#endif // JSONL_INGEST_H
\ No newline at end of file
@@ -0,0 +1,273 @@
+#ifndef KDFOREST_H
+#define KDFOREST_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <limits>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include "kdtree.h"
+#include "thread_pool.h"
+#include "topk.h"
+
+// Bosque de KD-trees aleatorizados consultado con una única cola best-bin-first
+// que reúne las ramas de todos los árboles. Cada árbol corta sobre dimensiones
+// elegidas al azar entre las de mayor varianza de su rango, así los árboles
+// particionan el espacio de forma distinta y juntos cubren los vecinos que uno
+// solo se pierde.
+// Los vectores se guardan una sola vez en el bosque, en orden de id (o se
+// leen de la base mapeada de la que se construyó, sin copia); cada árbol solo
+// tiene sus nodos y la permutación de ids en orden de hojas, y los buckets se
+// recorren a través de esa permutación. Los textos también son del bosque.
+class KDForest {
+private:
+    std::vector<KDTree> trees;
+    VectorStore points; // Una fila por id, compartida por todos los árboles
+    TextTable texts;    // Tabla de textos indexada por id
+    int rerank;
+
+    // Candidatos (distancia al cuadrado, id) en context.rows, ordenados de menor a mayor
+    void searchIds(const Point& query, int k, const SearchParams& params, KDSearchContext& context) const {
+        context.rows.clear();
+        if (trees.empty() || texts.size() == 0 || k <= 0) {
+            return;
+        }
+        IdSearch search = {*this, query, k, params, context};
+        dispatchDimension(points.kernelDimension(), search);
+    }
+
+    struct IdSearch {
+        const KDForest& forest;
+        const Point& query;
+        int k;
+        const SearchParams& params;
+        KDSearchContext& context;
+
+        template <int N>
+        void run() const {
+            forest.searchIdsFixed<N>(query, k, params, context);
+        }
+    };
+
+    // searchIds con los kernels de longitud de fila N
+    template <int N>
+    void searchIdsFixed(const Point& query, int k, const SearchParams& params, KDSearchContext& context) const {
+        typedef KDSearchContext::Branch Branch;
+        std::vector<std::pair<double, int>>& result = context.rows;
+
+        SearchCounters::query();
+        int num_trees = static_cast<int>(trees.size());
+        context.queries.resize(1);
+        const VectorStore::Query& q = context.queries[0];
+        points.prepare(query, context.queries[0]);
+        const Point& descent = KDTree::descentQuery(points.getMetric(), query, context);
+
+        bool use_rerank = points.hasExact() && rerank > k;
+        TopK& top = context.top;
+        top.reset(use_rerank ? rerank : k);
+        context.beginVisits(texts.size()); // Un mismo id aparece en todos los árboles
+
+        std::vector<Branch>& branches = context.branches;
+        std::greater<Branch> later;
+        branches.clear();
+        for (int t = 0; t < num_trees; t++) {
+            Branch root = {0.0, t, 0};
+            branches.push_back(root);
+        }
+        std::make_heap(branches.begin(), branches.end(), later);
+
+        double scale = (1.0 + params.epsilon) * (1.0 + params.epsilon);
+        int checks = 0;
+
+        while (!branches.empty()) {
+            std::pop_heap(branches.begin(), branches.end(), later);
+            Branch branch = branches.back();
+            branches.pop_back();
+            if (branch.bound * scale >= top.threshold()) {
+                break;
+            }
+            SearchCounters::explored();
+
+            const KDTree& tree = trees[branch.tree];
+            int index = branch.node;
+            KDTREE_STATS_ONLY(int depth = branch.depth;)
+            while (tree.nodes[index].axis >= 0) {
+                const KDTree::Node& node = tree.nodes[index];
+                double diff = descent(node.axis) - node.split;
+                int near = (diff < 0) ? node.left : node.right;
+                int far = (diff < 0) ? node.right : node.left;
+                double far_bound = std::max(branch.bound, diff * diff);
+                SearchCounters::node();
+                if (far_bound * scale < top.threshold()) {
+                    Branch pending = {far_bound, branch.tree, far};
+                    KDTREE_STATS_ONLY(pending.depth = depth + 1;)
+                    branches.push_back(pending);
+                    std::push_heap(branches.begin(), branches.end(), later);
+                } else {
+                    SearchCounters::pruned();
+                }
+                index = near;
+                KDTREE_STATS_ONLY(depth++;)
+            }
+
+            SearchCounters::node();
+            SearchCounters::leaf(KDTREE_STATS_ONLY(depth));
+            const KDTree::Node& leaf = tree.nodes[index];
+            for (int i = leaf.left; i < leaf.right; i++) {
+                int id = tree.ids[i];
+                if (!context.visit(id)) {
+                    continue;
+                }
+                SearchCounters::distance();
+                double dist = points.distance<N>(q, id);
+                if (dist < top.threshold()) {
+                    top.push(dist, id);
+                }
+            }
+
+            if (params.max_checks > 0 && ++checks >= params.max_checks) {
+                break;
+            }
+        }
+
+        top.extractSorted(result);
+
+        // Re-rank exacto con la copia float32 (las filas del almacén son los ids)
+        if (points.hasExact()) {
+            rerankCandidates<N>(points, q, result, k);
+        }
+    }
+
+    // `num_trees` árboles de solo nodos e ids sobre las mismas filas
+    template <typename Rows>
+    void buildTrees(const Rows& rows, int num_trees, const KDTreeOptions& options) {
+        num_trees = std::max(1, num_trees);
+        trees.reserve(num_trees);
+        for (int t = 0; t < num_trees; t++) {
+            KDTreeOptions tree_options = options;
+            tree_options.split_rule = SplitRule::RandomTopVariance;
+            tree_options.seed = options.seed + 7919u * static_cast<unsigned int>(t);
+            trees.push_back(KDTree(KDTree::NodesOnly(), rows, tree_options));
+        }
+    }
+
+    double reportedDistance(double dist, const KDSearchContext& context) const {
+        return points.reportedDistance(dist, context.queries[0].norm2);
+    }
+
+public:
+    // Construir `num_trees` árboles con ejes aleatorios de alta varianza; la
+    // semilla de cada árbol se deriva de options.seed
+    KDForest(const std::vector<DataItem>& data, int num_trees,
+             const KDTreeOptions& options = KDTreeOptions())
+        : rerank(std::max(0, options.rerank)) {
+        if (!data.empty()) {
+            bool keep_exact = options.element_type == ElementType::Int8 && rerank > 0;
+            points.build(options.element_type, static_cast<int>(data[0].embedding.size()),
+                         static_cast<int>(data.size()), [&](int i) -> const Point& { return data[i].embedding; },
+                         keep_exact, options.metric);
+        }
+        buildTrees(ItemRows{data}, num_trees, options);
+        texts.assign(data);
+    }
+
+    // Sobre una base sin copiar sus DataItem: si el tipo de elemento coincide
+    // con el del archivo los árboles leen sus filas en su lugar y solo los
+    // nodos e ids viven en memoria; la base debe vivir más que el bosque
+    KDForest(const MappedDatabase& database, int num_trees, const KDTreeOptions& options = KDTreeOptions())
+        : rerank(std::max(0, options.rerank)) {
+        if (database.size() > 0 &&
+            (options.element_type != database.getElementType() ||
+             !points.view(options.element_type, database.getDimensions(), database.size(), database.getStride(),
+                          database.rows(), options.metric))) {
+            bool keep_exact = options.element_type == ElementType::Int8 && rerank > 0;
+            points.build(options.element_type, database.getDimensions(), database.size(),
+                         [&](int i) { return database.embedding(i); }, keep_exact, options.metric);
+        }
+        buildTrees(DatabaseRows{database, 0, database.size()}, num_trees, options);
+        texts.view(database);
+    }
+
+    Neighbor nearest(const Point& query, const SearchParams& params = SearchParams()) const {
+        KDSearchContext& context = KDSearchContext::local();
+        searchIds(query, 1, params, context);
+        if (context.rows.empty()) {
+            return Neighbor(std::numeric_limits<double>::max(), -1);
+        }
+        return Neighbor(reportedDistance(context.rows[0].first, context), context.rows[0].second);
+    }
+
+    // k vecinos en `out` usando la memoria de `context` (ver KDSearchContext)
+    void kNearest(const Point& query, int k, const SearchParams& params, KDSearchContext& context,
+                  std::vector<Neighbor>& out) const {
+        searchIds(query, k, params, context);
+        out.clear();
+        for (size_t i = 0; i < context.rows.size(); i++) {
+            out.push_back(Neighbor(reportedDistance(context.rows[i].first, context), context.rows[i].second));
+        }
+    }
+
+    std::vector<Neighbor> kNearest(const Point& query, int k, const SearchParams& params = SearchParams()) const {
+        std::vector<Neighbor> result;
+        kNearest(query, k, params, KDSearchContext::local(), result);
+        return result;
+    }
+
+    std::string text(int id) const {
+        return texts[id];
+    }
+
+    std::vector<std::vector<Neighbor>> nearestBatch(const std::vector<Point>& queries, int k, int threads = 0,
+                                                    const SearchParams& params = SearchParams()) const {
+        std::vector<std::vector<Neighbor>> results(queries.size());
+        if (threads <= 0) {
+            threads = ThreadPool::hardwareThreads();
+        }
+
+        ThreadPool::global().parallelFor(static_cast<int>(queries.size()), threads, [&](int q) {
+            results[q] = kNearest(queries[q], k, params);
+        });
+
+        return results;
+    }
+
+    int getTreeCount() const {
+        return static_cast<int>(trees.size());
+    }
+
+    // Nodos de todos los árboles
+    int getNodeCount() const {
+        int total = 0;
+        for (const auto& tree : trees) {
+            total += tree.getNodeCount();
+        }
+        return total;
+    }
+
+    int getPointCount() const {
+        return static_cast<int>(texts.size());
+    }
+
+    // Bytes de los vectores compartidos (0 si son una vista de la base)
+    size_t getVectorBytes() const {
+        return points.memoryBytes();
+    }
+
+    // Memoria por componente: los vectores compartidos, nodos e ids de cada
+    // árbol, los textos y el contexto del hilo que llama
+    MemoryUsage memoryUsage() const {
+        MemoryUsage usage;
+        usage.vectors = points.memoryBytes();
+        for (const auto& tree : trees) {
+            usage.structure += vectorBytes(tree.nodes) + vectorBytes(tree.ids);
+        }
+        usage.structure += sizeof(*this) + vectorBytes(trees);
+        usage.payload = texts.memoryBytes();
+        usage.scratch = KDSearchContext::local().memoryBytes();
+        return usage;
+    }
+};
+
+#endif // KDFOREST_H
\ No newline at end of file
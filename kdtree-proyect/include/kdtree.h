@@ -3,230 +3,1189 @@
 
 #include <vector>
 #include <algorithm>
+#include <iostream>
+#include <functional>
 #include <limits>
-#include <queue>
+#include <random>
 #include <utility>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
 #include <Eigen/Dense>
+#include "data_item.h"
+#include "mapped_database.h"
+#include "thread_pool.h"
+#include "topk.h"
+#include "vector_store.h"
 
-using Point = Eigen::VectorXd;
+// Regla para elegir el eje de corte de cada nodo
+enum class SplitRule {
+    RoundRobin,         // depth % dimensions
+    RandomTopVariance   // Eje al azar entre los de mayor varianza del rango (KD-forest)
+};
 
-struct DataItem {
-    std::string text;
-    Point embedding;
+// Parámetros de construcción del árbol
+struct KDTreeOptions {
+    int leaf_size;             // Tamaño del caso base
+    ElementType element_type;  // Tipo de elemento de los vectores del índice
+    int rerank;                // Candidatos a re-rankear con la copia exacta (solo int8)
+    int build_threads;         // Hilos para la construcción (0 = todos los núcleos)
+    SplitRule split_rule;
+    int top_variance_dims;     // Candidatos de mayor varianza para RandomTopVariance
+    unsigned int seed;         // Semilla de la elección aleatoria de ejes
+    Metric metric;             // Métrica de las búsquedas (ver vector_store.h)
+    
+    explicit KDTreeOptions(int leaf_size = 1, ElementType element_type = ElementType::Float64,
+                           int rerank = 0, int build_threads = 0)
+        : leaf_size(leaf_size), element_type(element_type), rerank(rerank),
+          build_threads(build_threads), split_rule(SplitRule::RoundRobin),
+          top_variance_dims(5), seed(42), metric(Metric::L2) {}
 };
 
-class KDTree {
+// Sección de un árbol guardado dentro del formato mapeable (ver mapped_database.h):
+//
+//   [cabecera 136 B][nodos][ids][filas en orden de hojas][escalas int8][copia exacta]
+//
+// Cada bloque empieza alineado a kVectorAlignment desde el inicio de la sección
+// (que a su vez está alineada en el archivo), así las filas se usan sin copiar.
+const char kTreeSectionMagic[8] = {'K', 'D', 'T', 'R', 'E', 'E', '\0', '\0'};
+const uint32_t kTreeSectionVersion = 2; // 2: agrega la métrica
+
+struct TreeSectionHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t element_type;
+    uint64_t dataset_checksum; // Checksum de la base sobre la que se construyó el árbol
+    uint64_t tree_checksum;    // Cabecera (con este campo en 0), nodos e ids
+    int32_t leaf_size;
+    int32_t dimensions;
+    int32_t rerank;
+    int32_t split_rule;
+    int32_t top_variance_dims;
+    uint32_t seed;
+    uint64_t node_count;
+    uint64_t point_count;
+    uint64_t nodes_offset;
+    uint64_t ids_offset;
+    uint64_t rows_offset;
+    uint64_t rows_bytes;
+    uint64_t scale_offset;     // 0 si no es int8
+    uint64_t exact_offset;     // 0 si no hay copia exacta
+    uint64_t exact_bytes;
+    int32_t metric;            // Métrica con la que se prepararon las filas (ver Metric)
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TreeSectionHeader) == 136, "la cabecera del árbol debe medir 136 bytes");
+
+// Parámetros de búsqueda aproximada (best-bin-first). Con los valores por
+// defecto la búsqueda es exacta.
+struct SearchParams {
+    int max_checks;  // Máximo de hojas a revisar (<= 0 = sin límite)
+    double epsilon;  // Poda (1+eps): descarta ramas con (1+eps)^2 * cota >= peor distancia
+    int ef;          // Lista de candidatos de los índices HNSW (<= 0 = la del índice)
+    
+    explicit SearchParams(int max_checks = 0, double epsilon = 0.0, int ef = 0)
+        : max_checks(max_checks), epsilon(epsilon), ef(ef) {}
+    
+    bool isExact() const {
+        return max_checks <= 0 && epsilon <= 0.0;
+    }
+};
+
+// Subconjunto de documentos (p. ej. los de un tenant o una categoría) para las
+// búsquedas filtradas, con un bit por id. Sirve directamente como filtro:
+// cualquier predicado bool(int id) también.
+class IdBitmap {
 private:
-    struct Node {
-        Point point;
-        std::string text;
+    std::vector<uint64_t> words;
+
+public:
+    explicit IdBitmap(size_t n = 0) : words((n + 63) / 64, 0) {}
+
+    void set(int id) {
+        words[id >> 6] |= uint64_t(1) << (id & 63);
+    }
+
+    void reset(int id) {
+        words[id >> 6] &= ~(uint64_t(1) << (id & 63));
+    }
+
+    // Ampliar para cubrir n ids; los nuevos quedan fuera del subconjunto
+    void resize(size_t n) {
+        words.resize((n + 63) / 64, 0);
+    }
+
+    // Ids que cubre el mapa (múltiplo de 64)
+    size_t capacity() const {
+        return words.size() * 64;
+    }
+
+    bool contains(int id) const {
+        return (words[id >> 6] >> (id & 63)) & 1;
+    }
+
+    bool operator()(int id) const {
+        return contains(id);
+    }
+
+    size_t memoryBytes() const {
+        return vectorBytes(words);
+    }
+
+    size_t count() const {
+        size_t total = 0;
+        for (uint64_t word : words) {
+            total += __builtin_popcountll(word);
+        }
+        return total;
+    }
+};
+
+// Filtro que acepta todos los documentos (búsqueda sin filtrar)
+struct AcceptAll {
+    bool operator()(int) const {
+        return true;
+    }
+};
+
+// Memoria de trabajo de una búsqueda en un KDTree o KDForest: consultas
+// preparadas, montículo de candidatos, pila o cola de ramas, desplazamientos
+// por eje y marcas de visitados. Crece en las primeras consultas y después se
+// reutiliza, así las búsquedas en régimen estable no reservan memoria. Un
+// contexto no se comparte entre hilos; los métodos sin contexto usan local().
+class KDSearchContext {
+private:
+    friend class KDTree;
+    friend class KDForest;
+    
+    // Rama pendiente de la búsqueda exacta: al retomarla se vuelve a los
+    // desplazamientos de undo[0, undo_depth) y se fija offsets[axis] = offset
+    struct StackEntry {
+        double bound;
+        int node;
         int axis;
-        Node* left;
-        Node* right;
-        
-        Node(const Point& p, const std::string& t, int a) 
-            : point(p), text(t), axis(a), left(nullptr), right(nullptr) {}
+        double offset;
+        size_t undo_depth;
+        KDTREE_STATS_ONLY(int depth;)
+    };
+    
+    // Rama pendiente del best-bin-first, ordenada por su cota
+    struct Branch {
+        double bound;
+        int tree;
+        int node;
+        KDTREE_STATS_ONLY(int depth;)
         
-        ~Node() {
-            delete left;
-            delete right;
+        bool operator>(const Branch& other) const {
+            return bound > other.bound;
         }
     };
     
-    Node* root;
+    std::vector<VectorStore::Query> queries;        // Una por árbol
+    TopK top;
+    std::vector<StackEntry> stack;
+    std::vector<std::pair<int, double>> undo;       // (eje, desplazamiento anterior)
+    std::vector<double> offsets;                    // Distancia de la consulta a la celda por eje
+    std::vector<Branch> branches;                   // Montículo de mínimos
+    std::vector<std::pair<double, int>> rows;       // Candidatos (distancia al cuadrado, fila o id)
+    std::vector<unsigned int> visited;
+    unsigned int epoch;
+    Point unit_query;                               // Consulta normalizada para descender (coseno)
+    
+    // Nueva época de marcas de visitados para n ids
+    void beginVisits(size_t n) {
+        if (visited.size() < n) {
+            visited.resize(n, 0);
+        }
+        if (++epoch == 0) {
+            std::fill(visited.begin(), visited.end(), 0);
+            epoch = 1;
+        }
+    }
+    
+    // true la primera vez que se visita `id` en esta época
+    bool visit(int id) {
+        if (visited[id] == epoch) {
+            return false;
+        }
+        visited[id] = epoch;
+        return true;
+    }
+    
+public:
+    KDSearchContext() : epoch(0) {}
+    
+    // Contexto propio del hilo que llama
+    static KDSearchContext& local() {
+        static thread_local KDSearchContext context;
+        return context;
+    }
+    
+    // Bytes reservados hasta ahora (crece con las consultas más exigentes)
+    size_t memoryBytes() const {
+        size_t bytes = vectorBytes(queries) + top.memoryBytes() + vectorBytes(stack) + vectorBytes(undo) +
+                       vectorBytes(offsets) + vectorBytes(branches) + vectorBytes(rows) + vectorBytes(visited) +
+                       eigenBytes(unit_query);
+        for (const auto& q : queries) {
+            bytes += VectorStore::queryBytes(q);
+        }
+        return bytes;
+    }
+};
+
+// Filas de entrada para construir un árbol, sin copiarlas: un vector de
+// DataItem (ids = posiciones) o el rango de ids [begin, end) de una base
+struct ItemRows {
+    const std::vector<DataItem>& data;
+    
+    int size() const {
+        return static_cast<int>(data.size());
+    }
+    
+    int dimensions() const {
+        return data.empty() ? 0 : static_cast<int>(data[0].embedding.size());
+    }
+    
+    int id(int row) const {
+        return row;
+    }
+    
+    double coordinate(int row, int axis) const {
+        return data[row].embedding(axis);
+    }
+    
+    const Point& point(int row) const {
+        return data[row].embedding;
+    }
+};
+
+struct DatabaseRows {
+    const MappedDatabase& database;
+    int begin;
+    int end;
+    
+    int size() const {
+        return end - begin;
+    }
+    
+    int dimensions() const {
+        return database.getDimensions();
+    }
+    
+    int id(int row) const {
+        return begin + row;
+    }
+    
+    double coordinate(int row, int axis) const {
+        return database.coordinate(begin + row, axis);
+    }
+    
+    Point point(int row) const {
+        return database.embedding(begin + row);
+    }
+};
+
+// Filas normalizadas a norma 1 (métrica coseno): el árbol corta sobre las
+// direcciones, que es lo que compara la métrica
+template <typename Rows>
+struct UnitRows {
+    const Rows& rows;
+    std::vector<double> scales; // unitScale de cada fila
+    
+    explicit UnitRows(const Rows& rows) : rows(rows), scales(rows.size()) {
+        for (int i = 0; i < rows.size(); i++) {
+            scales[i] = unitScale(rows.point(i));
+        }
+    }
+    
+    int size() const {
+        return rows.size();
+    }
+    
+    int dimensions() const {
+        return rows.dimensions();
+    }
+    
+    int id(int row) const {
+        return rows.id(row);
+    }
+    
+    double coordinate(int row, int axis) const {
+        return rows.coordinate(row, axis) * scales[row];
+    }
+    
+    Point point(int row) const {
+        return rows.point(row) * scales[row];
+    }
+};
+
+class KDTree {
+private:
+    friend class KDForest;
+    friend class DynamicKDTree;
+    
+    // Nodo compacto: los hijos se referencian por índice dentro de `nodes`.
+    // En las hojas (axis == -1) left/right delimitan el bucket [left, right)
+    // de filas dentro del almacén de vectores.
+    struct Node {
+        double split; // Valor de corte en el eje
+        int axis;
+        int left;
+        int right;
+    };
+    
+    static_assert(sizeof(Node) == 24, "el formato del árbol guardado asume nodos de 24 bytes");
+    
+    std::vector<Node> nodes;        // Nodos en preorden, la raíz es nodes[0]
+    VectorStore points;             // Una fila por punto, en el orden de las hojas
+    std::vector<int> ids;           // Id del documento de cada fila de `points`
+    TextTable texts;                // Tabla de textos indexada por id
     int leaf_size; // Tamaño del caso base
     int dimensions;
-    int node_count; // Contador de nodos para estimación de memoria
+    int rerank; // Candidatos a re-rankear con la copia exacta (0 = sin re-rank)
+    SplitRule split_rule;
+    int top_variance_dims;
+    unsigned int seed;
+    
+    // Puntos muestreados por nodo para estimar la varianza de cada dimensión
+    static const int kVarianceSample = 128;
+    
+    // Subárboles con al menos esta cantidad de puntos se construyen en paralelo
+    static const int kParallelBuildCutoff = 4096;
     
-    // Función auxiliar para construir el árbol
-    Node* buildTree(std::vector<DataItem>& data, int depth, int start, int end) {
-        if (start >= end) {
-            return nullptr;
+    // Número de nodos de un subárbol con n y n + 1 puntos. Los tamaños de los
+    // hijos solo toman dos valores consecutivos por nivel, así que basta con
+    // O(log n) pasos y la posición de cada subárbol en preorden se conoce antes
+    // de construirlo
+    static void subtreeNodeCounts(int n, int leaf, int& count_n, int& count_n1) {
+        if (n + 1 <= leaf) {
+            count_n = 1;
+            count_n1 = 1;
+            return;
         }
+        int half = n / 2;
+        int c_half, c_half1;
+        subtreeNodeCounts(half, leaf, c_half, c_half1);
+        
+        // n par: hijos (half, half); n impar: (half, half + 1)
+        count_n = n <= leaf ? 1 : 1 + c_half + (n % 2 == 0 ? c_half : c_half1);
+        // n + 1 par: (half + 1, half + 1) con n impar; impar: (half, half + 1) con n par
+        count_n1 = 1 + c_half1 + (n % 2 == 0 ? c_half : c_half1);
+    }
+    
+    static int subtreeNodeCount(int n, int leaf) {
+        int count_n, count_n1;
+        subtreeNodeCounts(n, leaf, count_n, count_n1);
+        return count_n;
+    }
+    
+    // Función auxiliar para construir el árbol sobre order[start, end), escribiendo
+    // el subárbol en nodes[index ...] (preorden)
+    template <typename Rows>
+    void buildTree(const Rows& data, std::vector<int>& order,
+                   int depth, int start, int end, int index, int threads) {
+        Node& node = nodes[index];
         
         // Si el número de elementos es menor o igual al tamaño de hoja, crear hoja
+        // que conserva todo el bucket; se recorre linealmente en tiempo de consulta
         if (end - start <= leaf_size) {
-            // Crear un nodo hoja con el primer elemento
-            Node* leaf = new Node(data[start].embedding, data[start].text, 0);
-            node_count++;
-            
-            // Para caso base > 1, realizar búsqueda lineal en tiempo de consulta
-            return leaf;
+            node.split = 0.0;
+            node.axis = -1;
+            node.left = start;
+            node.right = end;
+            return;
         }
         
-        int axis = depth % dimensions;
+        int axis = chooseAxis(data, order, depth, start, end, index);
         
-        // Ordenar los datos por el eje actual
-        std::sort(data.begin() + start, data.begin() + end,
-                 [axis](const DataItem& a, const DataItem& b) {
-                     return a.embedding(axis) < b.embedding(axis);
-                 });
+        // Selección lineal de la mediana sobre la coordenada del eje, copiada a un
+        // arreglo contiguo para no saltar entre los vectores de cada punto
+        int count = end - start;
+        int half = count / 2;
+        std::vector<std::pair<double, int>> keys(count);
+        for (int i = 0; i < count; i++) {
+            int id = order[start + i];
+            keys[i] = std::make_pair(data.coordinate(id, axis), id);
+        }
+        std::nth_element(keys.begin(), keys.begin() + half, keys.end());
+        for (int i = 0; i < count; i++) {
+            order[start + i] = keys[i].second;
+        }
         
-        // Encontrar la mediana
-        int mid = start + (end - start) / 2;
+        // [start, mid) a la izquierda, [mid, end) a la derecha
+        int mid = start + half;
         
-        // Crear nodo y construir subárboles recursivamente
-        Node* node = new Node(data[mid].embedding, data[mid].text, axis);
-        node_count++;
+        node.split = keys[half].first;
+        node.axis = axis;
+        node.left = index + 1;
+        node.right = index + 1 + subtreeNodeCount(half, leaf_size);
+        int left = node.left;
+        int right = node.right;
+        std::vector<std::pair<double, int>>().swap(keys);
         
-        node->left = buildTree(data, depth + 1, start, mid);
-        node->right = buildTree(data, depth + 1, mid + 1, end);
+        if (threads > 1 && count >= kParallelBuildCutoff) {
+            // Cada hijo escribe en su propio rango de nodes y de order
+            ThreadPool::global().parallelFor(2, 2, [&, depth, start, mid, end, left, right, threads](int child) {
+                if (child == 0) {
+                    buildTree(data, order, depth + 1, start, mid, left, threads / 2);
+                } else {
+                    buildTree(data, order, depth + 1, mid, end, right, threads - threads / 2);
+                }
+            });
+        } else {
+            buildTree(data, order, depth + 1, start, mid, left, 1);
+            buildTree(data, order, depth + 1, mid, end, right, 1);
+        }
+    }
+    
+    // Eje de corte del nodo `index` según la regla del árbol. RandomTopVariance
+    // estima la varianza con una muestra del rango y elige al azar entre las
+    // top_variance_dims dimensiones de mayor varianza; la semilla depende del
+    // nodo, así la construcción paralela es determinista.
+    template <typename Rows>
+    int chooseAxis(const Rows& data, const std::vector<int>& order,
+                   int depth, int start, int end, int index) const {
+        if (split_rule == SplitRule::RoundRobin) {
+            return depth % dimensions;
+        }
+        
+        int count = end - start;
+        int samples = std::min(count, kVarianceSample);
+        Eigen::VectorXd mean = Eigen::VectorXd::Zero(dimensions);
+        Eigen::VectorXd sq_mean = Eigen::VectorXd::Zero(dimensions);
+        for (int s = 0; s < samples; s++) {
+            const Point& p = data.point(order[start + static_cast<long long>(s) * count / samples]);
+            mean += p;
+            sq_mean += p.cwiseAbs2();
+        }
+        mean /= samples;
+        sq_mean /= samples;
+        Eigen::VectorXd variance = sq_mean - mean.cwiseAbs2();
         
-        return node;
+        int top = std::max(1, std::min(top_variance_dims, dimensions));
+        std::vector<int> dims(dimensions);
+        for (int d = 0; d < dimensions; d++) {
+            dims[d] = d;
+        }
+        std::partial_sort(dims.begin(), dims.begin() + top, dims.end(),
+                          [&variance](int a, int b) { return variance(a) > variance(b); });
+        
+        std::mt19937 rng(seed + 2654435761u * static_cast<unsigned int>(index));
+        std::uniform_int_distribution<int> pick(0, top - 1);
+        return dims[pick(rng)];
+    }
+    
+    // Construir nodos y almacén a partir de las filas (sin copiarlas); ids
+    // queda con el id de cada fila del almacén. Con with_store = false solo se
+    // construyen los nodos e ids (ver NodesOnly)
+    template <typename Rows>
+    void build(const Rows& data, const KDTreeOptions& options, bool with_store = true) {
+        if (options.metric == Metric::Cosine) {
+            buildRows(UnitRows<Rows>(data), options, with_store);
+        } else {
+            buildRows(data, options, with_store);
+        }
     }
     
-    // Función auxiliar para búsqueda de vecino más cercano
-    void nearestNeighbor(Node* node, const Point& query, double& best_dist, std::string& best_text) const {
-        if (!node) {
+    template <typename Rows>
+    void buildRows(const Rows& data, const KDTreeOptions& options, bool with_store) {
+        if (data.size() <= 0) {
+            dimensions = 0;
             return;
         }
         
-        // Calcular distancia euclidiana al cuadrado
-        double dist = (query - node->point).squaredNorm();
+        dimensions = data.dimensions();
+        int n = data.size();
+        int threads = options.build_threads > 0 ? options.build_threads : ThreadPool::hardwareThreads();
         
-        // Actualizar mejor distancia y texto si mejora
-        if (dist < best_dist) {
-            best_dist = dist;
-            best_text = node->text;
+        // Permutación de índices a particionar (los datos de entrada no se copian)
+        std::vector<int> order(n);
+        for (int i = 0; i < n; i++) {
+            order[i] = i;
         }
         
-        // Determinar qué hijo visitar primero
-        int axis = node->axis;
-        double diff = query(axis) - node->point(axis);
+        // Construir árbol sobre un arreglo de nodos ya dimensionado
+        nodes.resize(subtreeNodeCount(n, leaf_size));
+        buildTree(data, order, 0, 0, n, 0, threads);
         
-        Node* first = (diff < 0) ? node->left : node->right;
-        Node* second = (diff < 0) ? node->right : node->left;
+        // Volcar puntos en el orden de las hojas para que cada bucket sea contiguo
+        if (with_store) {
+            bool keep_exact = options.element_type == ElementType::Int8 && rerank > 0;
+            points.build(options.element_type, dimensions, n,
+                         [&](int i) -> decltype(data.point(0)) { return data.point(order[i]); },
+                         keep_exact, options.metric);
+        }
+        for (int i = 0; i < n; i++) {
+            order[i] = data.id(order[i]);
+        }
+        ids.swap(order);
+    }
+    
+    // Búsqueda exacta con pila explícita. Cada rama pendiente guarda la cota
+    // (distancia al cuadrado) de la consulta a su celda, que se actualiza de
+    // forma incremental con el desplazamiento por eje: al cruzar un corte en el
+    // eje a la cota cambia en diff^2 - offsets[a]^2, más ajustada que la del
+    // último corte solo. Los desplazamientos de cada rama se restauran con un
+    // registro de deshacer en vez de copiarlos en la pila. `collector` decide
+    // qué hacer con cada fila de las hojas y cuál es la cota de poda
+    // (threshold()); ver TopCollector y RadiusCollector.
+    template <typename Collector>
+    void exactSearch(const Point& query, KDSearchContext& context, Collector& collector) const {
+        typedef KDSearchContext::StackEntry StackEntry;
+        std::vector<double>& offsets = context.offsets;
+        std::vector<std::pair<int, double>>& undo = context.undo;
+        std::vector<StackEntry>& stack = context.stack;
         
-        // Visitar primer hijo
-        nearestNeighbor(first, query, best_dist, best_text);
+        offsets.assign(dimensions, 0.0);
+        undo.clear();
+        stack.clear();
+        StackEntry root = {0.0, 0, -1, 0.0, 0};
+        stack.push_back(root);
         
-        // Verificar si es necesario visitar el segundo hijo
-        if (diff * diff < best_dist) {
-            nearestNeighbor(second, query, best_dist, best_text);
+        while (!stack.empty()) {
+            StackEntry entry = stack.back();
+            stack.pop_back();
+            if (entry.bound >= collector.threshold()) {
+                SearchCounters::pruned();
+                continue;
+            }
+            SearchCounters::explored();
+            
+            // Volver a los desplazamientos de la celda de esta rama
+            while (undo.size() > entry.undo_depth) {
+                offsets[undo.back().first] = undo.back().second;
+                undo.pop_back();
+            }
+            if (entry.axis >= 0) {
+                undo.push_back(std::make_pair(entry.axis, offsets[entry.axis]));
+                offsets[entry.axis] = entry.offset;
+            }
+            
+            // Descender hacia la hoja de la consulta dejando pendientes las ramas
+            // lejanas que todavía pueden mejorar el resultado
+            int index = entry.node;
+            KDTREE_STATS_ONLY(int depth = entry.depth;)
+            while (nodes[index].axis >= 0) {
+                const Node& node = nodes[index];
+                double diff = query(node.axis) - node.split;
+                int near = (diff < 0) ? node.left : node.right;
+                int far = (diff < 0) ? node.right : node.left;
+                double old_offset = offsets[node.axis];
+                double far_bound = entry.bound - old_offset * old_offset + diff * diff;
+                SearchCounters::node();
+                if (far_bound < collector.threshold()) {
+                    StackEntry pending = {far_bound, far, node.axis, diff, undo.size()};
+                    KDTREE_STATS_ONLY(pending.depth = depth + 1;)
+                    stack.push_back(pending);
+                } else {
+                    SearchCounters::pruned();
+                }
+                index = near;
+                KDTREE_STATS_ONLY(depth++;)
+            }
+            
+            // Hoja: ofrecer cada punto del bucket
+            SearchCounters::node();
+            SearchCounters::leaf(KDTREE_STATS_ONLY(depth));
+            const Node& leaf = nodes[index];
+            for (int i = leaf.left; i < leaf.right; i++) {
+                collector.visit(i);
+            }
         }
     }
     
-    // Función auxiliar para k vecinos más cercanos - modificada para C++11
-    void kNearestNeighbors(Node* node, const Point& query, 
-                          std::priority_queue<std::pair<double, std::string>>& pq, int k) const {
-        if (!node) {
-            return;
-        }
+    // Los k mejores candidatos en un TopK, entre las filas cuyo id acepta `filter`.
+    // N es la longitud de fila de los kernels (0 = dinámica, ver dispatchDimension)
+    template <typename Filter, int N>
+    struct TopCollector {
+        const KDTree& tree;
+        const VectorStore::Query& q;
+        TopK& top;
+        const Filter& filter;
         
-        // Calcular distancia euclidiana al cuadrado
-        double dist = (query - node->point).squaredNorm();
+        double threshold() const {
+            return top.threshold();
+        }
         
-        // Actualizar cola de prioridad - Corregido para evitar warnings de comparación de signedness
-        if (static_cast<int>(pq.size()) < k) {
-            pq.push(std::make_pair(dist, node->text));
-        } else if (dist < pq.top().first) {
-            pq.pop();
-            pq.push(std::make_pair(dist, node->text));
+        void visit(int row) {
+            if (!filter(tree.ids[row])) {
+                return;
+            }
+            SearchCounters::distance();
+            double dist = tree.points.distance<N>(q, row);
+            if (dist < top.threshold()) {
+                top.push(dist, row);
+            }
         }
+    };
+    
+    // Todas las filas a distancia al cuadrado <= radius2. Con int8 se compara
+    // con la copia exacta si existe (la poda por celdas ya es exacta)
+    template <int N>
+    struct RadiusCollector {
+        const KDTree& tree;
+        const VectorStore::Query& q;
+        double radius2;
+        double bound; // Primer valor de cota que ya no puede tener puntos dentro
+        std::vector<std::pair<double, int>>& rows;
         
-        // Determinar qué hijo visitar primero
-        int axis = node->axis;
-        double diff = query(axis) - node->point(axis);
+        RadiusCollector(const KDTree& tree, const VectorStore::Query& q, double radius2,
+                        std::vector<std::pair<double, int>>& rows)
+            : tree(tree), q(q), radius2(radius2),
+              bound(std::nextafter(radius2, std::numeric_limits<double>::max())), rows(rows) {}
         
-        Node* first = (diff < 0) ? node->left : node->right;
-        Node* second = (diff < 0) ? node->right : node->left;
+        double threshold() const {
+            return bound;
+        }
         
-        // Visitar primer hijo
-        kNearestNeighbors(first, query, pq, k);
+        void visit(int row) {
+            SearchCounters::distance();
+            double dist = tree.points.exactDistance<N>(q, row);
+            if (dist <= radius2) {
+                rows.push_back(std::make_pair(dist, row));
+            }
+        }
+    };
+    
+    // Búsqueda best-bin-first: una cola global de ramas sin explorar ordenada por
+    // la cota inferior de distancia; se detiene al agotar max_checks hojas o
+    // cuando ninguna rama puede mejorar el peor candidato por un factor (1+eps)
+    template <int N, typename Filter>
+    void bestBinFirst(const Point& query, const SearchParams& params, KDSearchContext& context,
+                      const Filter& filter) const {
+        typedef KDSearchContext::Branch Branch;
+        const VectorStore::Query& q = context.queries[0];
+        TopK& top = context.top;
+        std::vector<Branch>& branches = context.branches;
+        std::greater<Branch> later;
+        double scale = (1.0 + params.epsilon) * (1.0 + params.epsilon);
+        int checks = 0;
         
-        // Verificar si es necesario visitar el segundo hijo - Corregido para comparación de signedness
-        double largest_dist = pq.empty() ? std::numeric_limits<double>::max() : pq.top().first;
-        if (diff * diff < largest_dist || static_cast<int>(pq.size()) < k) {
-            kNearestNeighbors(second, query, pq, k);
+        branches.clear();
+        Branch root = {0.0, 0, 0};
+        branches.push_back(root);
+        while (!branches.empty()) {
+            std::pop_heap(branches.begin(), branches.end(), later);
+            Branch branch = branches.back();
+            branches.pop_back();
+            if (branch.bound * scale >= top.threshold()) {
+                break;
+            }
+            SearchCounters::explored();
+            
+            // Descender hasta la hoja más prometedora encolando las ramas hermanas
+            int index = branch.node;
+            KDTREE_STATS_ONLY(int depth = branch.depth;)
+            while (nodes[index].axis >= 0) {
+                const Node& node = nodes[index];
+                double diff = query(node.axis) - node.split;
+                int near = (diff < 0) ? node.left : node.right;
+                int far = (diff < 0) ? node.right : node.left;
+                double far_bound = std::max(branch.bound, diff * diff);
+                SearchCounters::node();
+                if (far_bound * scale < top.threshold()) {
+                    Branch pending = {far_bound, 0, far};
+                    KDTREE_STATS_ONLY(pending.depth = depth + 1;)
+                    branches.push_back(pending);
+                    std::push_heap(branches.begin(), branches.end(), later);
+                } else {
+                    SearchCounters::pruned();
+                }
+                index = near;
+                KDTREE_STATS_ONLY(depth++;)
+            }
+            
+            SearchCounters::node();
+            SearchCounters::leaf(KDTREE_STATS_ONLY(depth));
+            const Node& leaf = nodes[index];
+            for (int i = leaf.left; i < leaf.right; i++) {
+                if (!filter(ids[i])) {
+                    continue;
+                }
+                SearchCounters::distance();
+                double dist = points.distance<N>(q, i);
+                if (dist < top.threshold()) {
+                    top.push(dist, i);
+                }
+            }
+            
+            if (params.max_checks > 0 && ++checks >= params.max_checks) {
+                break;
+            }
         }
     }
     
-public:
-    // Constructor con opción para especificar tamaño de hoja
-    KDTree(const std::vector<DataItem>& data, int leaf_size = 1) 
-        : root(nullptr), leaf_size(leaf_size), node_count(0) {
-        if (data.empty()) {
-            dimensions = 0;
+    // Candidatos (distancia al cuadrado, fila) en context.rows, ordenados de
+    // menor a mayor; si hay re-rank se piden `rerank` candidatos a la
+    // representación cuantizada y se reordenan con la copia exacta. Solo se
+    // consideran las filas cuyo id acepta `filter`
+    template <typename Filter>
+    void searchRows(const Point& query, int k, const SearchParams& params, KDSearchContext& context,
+                    const Filter& filter) const {
+        context.rows.clear();
+        if (nodes.empty() || k <= 0) {
             return;
         }
+        RowSearch<Filter> search = {*this, query, k, params, context, filter};
+        dispatchDimension(points.kernelDimension(), search);
+    }
+    
+    // Distancia reportada de un candidato de la última consulta de `context`
+    double reportedDistance(double dist, const KDSearchContext& context) const {
+        return points.reportedDistance(dist, context.queries[0].norm2);
+    }
+    
+    // Consulta con la que se desciende por los cortes: con coseno el árbol se
+    // construyó sobre filas normalizadas, así que también se normaliza
+    static const Point& descentQuery(Metric metric, const Point& query, KDSearchContext& context) {
+        if (metric != Metric::Cosine) {
+            return query;
+        }
+        context.unit_query = query * unitScale(query);
+        return context.unit_query;
+    }
+    
+    const Point& descentQuery(const Point& query, KDSearchContext& context) const {
+        return descentQuery(points.getMetric(), query, context);
+    }
+    
+    // searchRows con los kernels de longitud de fila N
+    template <int N, typename Filter>
+    void searchRowsFixed(const Point& query, int k, const SearchParams& params, KDSearchContext& context,
+                         const Filter& filter) const {
+        SearchCounters::query();
         
-        dimensions = data[0].embedding.size();
+        context.queries.resize(1);
+        points.prepare(query, context.queries[0]);
+        const Point& descent = descentQuery(query, context);
         
-        // Crear copia para ordenar
-        std::vector<DataItem> data_copy = data;
+        bool use_rerank = points.hasExact() && rerank > k;
+        context.top.reset(use_rerank ? rerank : k);
         
-        // Construir árbol
-        root = buildTree(data_copy, 0, 0, data_copy.size());
+        if (params.isExact()) {
+            TopCollector<Filter, N> collector = {*this, context.queries[0], context.top, filter};
+            exactSearch(descent, context, collector);
+        } else {
+            bestBinFirst<N>(descent, params, context, filter);
+        }
+        context.top.extractSorted(context.rows);
+        
+        if (points.hasExact()) {
+            rerankCandidates<N>(points, context.queries[0], context.rows, k);
+        }
     }
     
-    // Destructor
-    ~KDTree() {
-        delete root;
+    template <typename Filter>
+    struct RowSearch {
+        const KDTree& tree;
+        const Point& query;
+        int k;
+        const SearchParams& params;
+        KDSearchContext& context;
+        const Filter& filter;
+        
+        template <int N>
+        void run() const {
+            tree.searchRowsFixed<N>(query, k, params, context, filter);
+        }
+    };
+    
+    template <int N>
+    void radiusRows(const Point& query, double radius, KDSearchContext& context) const {
+        SearchCounters::query();
+        context.queries.resize(1);
+        points.prepare(query, context.queries[0]);
+        double radius2 = points.searchDistance(radius, context.queries[0].norm2);
+        if (radius2 < 0) {
+            return;
+        }
+        
+        RadiusCollector<N> collector(*this, context.queries[0], radius2, context.rows);
+        exactSearch(descentQuery(query, context), context, collector);
     }
     
-    // Buscar vecino más cercano
-    std::pair<double, std::string> nearest(const Point& query) const {
-        double best_dist = std::numeric_limits<double>::max();
-        std::string best_text;
+    struct RadiusSearch {
+        const KDTree& tree;
+        const Point& query;
+        double radius;
+        KDSearchContext& context;
         
-        nearestNeighbor(root, query, best_dist, best_text);
+        template <int N>
+        void run() const {
+            tree.radiusRows<N>(query, radius, context);
+        }
+    };
+    
+    // Con keep_texts = false el árbol no guarda textos (los segmentos de un
+    // DynamicKDTree los guardan ellos mismos)
+    KDTree(const std::vector<DataItem>& data, const KDTreeOptions& options, bool keep_texts)
+        : leaf_size(std::max(1, options.leaf_size)), rerank(std::max(0, options.rerank)),
+          split_rule(options.split_rule), top_variance_dims(options.top_variance_dims),
+          seed(options.seed) {
+        build(ItemRows{data}, options);
         
-        return std::make_pair(std::sqrt(best_dist), best_text);
+        if (keep_texts) {
+            texts.assign(data);
+        }
     }
     
-    // Buscar k vecinos más cercanos - Modificada para C++11
-    std::vector<std::pair<double, std::string>> kNearest(const Point& query, int k) const {
-        std::priority_queue<std::pair<double, std::string>> pq;
-        
-        kNearestNeighbors(root, query, pq, k);
+    // Solo nodos e ids (la permutación de las filas en orden de hojas), sin
+    // almacén ni textos: los árboles de un KDForest leen las filas del almacén
+    // compartido del bosque, indexado por id
+    struct NodesOnly {};
+    
+    template <typename Rows>
+    KDTree(NodesOnly, const Rows& rows, const KDTreeOptions& options)
+        : leaf_size(std::max(1, options.leaf_size)), rerank(std::max(0, options.rerank)),
+          split_rule(options.split_rule), top_variance_dims(options.top_variance_dims),
+          seed(options.seed) {
+        build(rows, options, false);
+    }
+
+    
+    // Árbol vacío que completa loadFromDatabase
+    KDTree() : leaf_size(1), dimensions(0), rerank(0), split_rule(SplitRule::RoundRobin),
+               top_variance_dims(5), seed(42) {}
+    
+    // Checksum de la estructura guardada: cabecera (sin su propio checksum), nodos e ids
+    static uint64_t treeChecksum(TreeSectionHeader header, const void* node_data, const void* id_data) {
+        header.tree_checksum = 0;
+        uint64_t h = checksum64(&header, sizeof(header));
+        h = checksum64(node_data, header.node_count * sizeof(Node), h);
+        return checksum64(id_data, header.point_count * sizeof(int), h);
+    }
+    
+public:
+    // Constructor con opción para especificar tamaño de hoja, tipo de elemento
+    // del índice y número de candidatos para el re-rank exacto (solo int8)
+    KDTree(const std::vector<DataItem>& data, int leaf_size = 1,
+           ElementType element_type = ElementType::Float64, int rerank = 0) 
+        : KDTree(data, KDTreeOptions(leaf_size, element_type, rerank)) {}
+    
+    KDTree(const std::vector<DataItem>& data, const KDTreeOptions& options)
+        : KDTree(data, options, true) {}
+    
+    // Toma posesión de los datos: los textos se mueven a la tabla del árbol y
+    // los embeddings se liberan una vez volcados al almacén
+    KDTree(std::vector<DataItem>&& data, const KDTreeOptions& options = KDTreeOptions())
+        : leaf_size(std::max(1, options.leaf_size)), rerank(std::max(0, options.rerank)),
+          split_rule(options.split_rule), top_variance_dims(options.top_variance_dims),
+          seed(options.seed) {
+        build(ItemRows{data}, options);
         
-        // Convertir cola de prioridad a vector ordenado
-        std::vector<std::pair<double, std::string>> result;
-        while (!pq.empty()) {
-            std::pair<double, std::string> item = pq.top();
-            double dist = std::sqrt(item.first);
-            std::string text = item.second;
-            pq.pop();
-            result.push_back(std::make_pair(dist, text));
+        texts.take(data);
+        std::vector<DataItem>().swap(data);
+    }
+    
+    KDTree(std::vector<DataItem>&& data, int leaf_size,
+           ElementType element_type = ElementType::Float64, int rerank = 0)
+        : KDTree(std::move(data), KDTreeOptions(leaf_size, element_type, rerank)) {}
+    
+    // Sobre una base (mapeada o almacén en memoria) sin copiar sus DataItem:
+    // solo las filas del índice, en orden de hojas; los textos son los de la
+    // base, que debe vivir más que el árbol. Con [begin, end) se indexa ese
+    // rango de ids (un subconjunto sin copia) y los ids de los resultados son
+    // los de la base.
+    KDTree(const MappedDatabase& database, const KDTreeOptions& options = KDTreeOptions())
+        : KDTree(database, 0, database.size(), options) {}
+    
+    KDTree(const MappedDatabase& database, int begin, int end, const KDTreeOptions& options = KDTreeOptions())
+        : leaf_size(std::max(1, options.leaf_size)), rerank(std::max(0, options.rerank)),
+          split_rule(options.split_rule), top_variance_dims(options.top_variance_dims),
+          seed(options.seed) {
+        build(DatabaseRows{database, begin, end}, options);
+        texts.view(database);
+    }
+    
+    // Buscar vecino más cercano (aproximado si params no es exacto)
+    Neighbor nearest(const Point& query, const SearchParams& params = SearchParams()) const {
+        KDSearchContext& context = KDSearchContext::local();
+        searchRows(query, 1, params, context, AcceptAll());
+        if (context.rows.empty()) {
+            return Neighbor(std::numeric_limits<double>::max(), -1);
         }
         
-        // Ordenar por distancia (menor a mayor)
-        std::reverse(result.begin(), result.end());
+        return Neighbor(reportedDistance(context.rows[0].first, context), ids[context.rows[0].second]);
+    }
+    
+    // k vecinos en `out` (de menor a mayor distancia) usando la memoria de
+    // `context`; con ambos reutilizados la consulta no reserva memoria
+    void kNearest(const Point& query, int k, const SearchParams& params, KDSearchContext& context,
+                  std::vector<Neighbor>& out) const {
+        kNearestFiltered(query, k, AcceptAll(), params, context, out);
+    }
+    
+    // Buscar k vecinos más cercanos
+    std::vector<Neighbor> kNearest(const Point& query, int k, const SearchParams& params = SearchParams()) const {
+        std::vector<Neighbor> result;
+        kNearest(query, k, params, KDSearchContext::local(), result);
+        return result;
+    }
+    
+    // k vecinos entre los documentos que acepta `filter` (un IdBitmap o un
+    // predicado bool(int id)), sobre el mismo árbol: las ramas se podan por su
+    // celda igual que sin filtro y los ids rechazados solo se saltan en las
+    // hojas, así un subconjunto no necesita su propio índice. Con filtros muy
+    // selectivos la búsqueda exacta recorre más hojas antes de llenar k.
+    template <typename Filter>
+    void kNearestFiltered(const Point& query, int k, const Filter& filter, const SearchParams& params,
+                          KDSearchContext& context, std::vector<Neighbor>& out) const {
+        searchRows(query, k, params, context, filter);
+        out.clear();
+        for (size_t i = 0; i < context.rows.size(); i++) {
+            out.push_back(Neighbor(reportedDistance(context.rows[i].first, context), ids[context.rows[i].second]));
+        }
+    }
+    
+    template <typename Filter>
+    std::vector<Neighbor> kNearestFiltered(const Point& query, int k, const Filter& filter,
+                                           const SearchParams& params = SearchParams()) const {
+        std::vector<Neighbor> result;
+        kNearestFiltered(query, k, filter, params, KDSearchContext::local(), result);
+        return result;
+    }
+    
+    // Todos los documentos a distancia <= radius, de menor a mayor, en `out`.
+    // La búsqueda es exacta: las ramas cuya celda queda fuera de la bola se podan
+    void radiusSearch(const Point& query, double radius, KDSearchContext& context,
+                      std::vector<Neighbor>& out) const {
+        out.clear();
+        context.rows.clear();
+        if (nodes.empty()) {
+            return;
+        }
+        RadiusSearch search = {*this, query, radius, context};
+        dispatchDimension(points.kernelDimension(), search);
+        std::sort(context.rows.begin(), context.rows.end());
         
+        for (size_t i = 0; i < context.rows.size(); i++) {
+            out.push_back(Neighbor(reportedDistance(context.rows[i].first, context), ids[context.rows[i].second]));
+        }
+    }
+    
+    std::vector<Neighbor> radiusSearch(const Point& query, double radius) const {
+        std::vector<Neighbor> result;
+        radiusSearch(query, radius, KDSearchContext::local(), result);
         return result;
     }
     
+    // Texto del documento `id` (el de los DataItem de entrada)
+    std::string text(int id) const {
+        return texts[id];
+    }
+    
+    // k vecinos para un lote de consultas repartido en `threads` hilos del pool
+    // compartido (0 = todos los núcleos)
+    std::vector<std::vector<Neighbor>> nearestBatch(const std::vector<Point>& queries, int k, int threads = 0,
+                                                    const SearchParams& params = SearchParams()) const {
+        std::vector<std::vector<Neighbor>> results(queries.size());
+        if (threads <= 0) {
+            threads = ThreadPool::hardwareThreads();
+        }
+        
+        ThreadPool::global().parallelFor(static_cast<int>(queries.size()), threads, [&](int q) {
+            results[q] = kNearest(queries[q], k, params);
+        });
+        
+        return results;
+    }
+    
     // Obtener el número de nodos (para estimación de memoria)
     int getNodeCount() const {
-        return node_count;
+        return static_cast<int>(nodes.size());
     }
-};
-
-// Clase para búsqueda lineal (para comparar con KDTree)
-class LinearSearch {
-private:
-    std::vector<DataItem> data;
     
-public:
-    LinearSearch(const std::vector<DataItem>& items) : data(items) {}
+    // Obtener el número de puntos almacenados en el árbol
+    int getPointCount() const {
+        return points.size();
+    }
+    
+    int getLeafSize() const {
+        return leaf_size;
+    }
+    
+    ElementType getElementType() const {
+        return points.getElementType();
+    }
     
-    std::pair<double, std::string> nearest(const Point& query) const {
-        double min_dist = std::numeric_limits<double>::max();
-        std::string nearest_text;
+    // Bytes ocupados por los vectores del índice
+    size_t getVectorBytes() const {
+        return points.memoryBytes();
+    }
+    
+    // Memoria por componente; la de trabajo es la del contexto del hilo que llama
+    MemoryUsage memoryUsage() const {
+        MemoryUsage usage;
+        usage.vectors = points.memoryBytes();
+        usage.structure = sizeof(*this) + vectorBytes(nodes) + vectorBytes(ids);
+        usage.payload = texts.memoryBytes();
+        usage.scratch = KDSearchContext::local().memoryBytes();
+        return usage;
+    }
+    
+    int getRerank() const {
+        return rerank;
+    }
+    
+    SplitRule getSplitRule() const {
+        return split_rule;
+    }
+    
+    int getTopVarianceDims() const {
+        return top_variance_dims;
+    }
+    
+    unsigned int getSeed() const {
+        return seed;
+    }
+    
+    Metric getMetric() const {
+        return points.getMetric();
+    }
+    
+    // true si el árbol se construyó con `options`: así uno guardado puede
+    // reemplazar al que se construiría con ellas. La semilla y los candidatos
+    // por varianza solo cuentan con RandomTopVariance (RoundRobin no los usa)
+    bool matches(const KDTreeOptions& options) const {
+        return leaf_size == std::max(1, options.leaf_size) &&
+               getElementType() == options.element_type &&
+               (options.element_type != ElementType::Int8 || rerank == std::max(0, options.rerank)) &&
+               split_rule == options.split_rule &&
+               (split_rule == SplitRule::RoundRobin ||
+                (seed == options.seed && top_variance_dims == options.top_variance_dims)) &&
+               getMetric() == options.metric;
+    }
+    
+    // Serializar el árbol (nodos, ids, vectores en orden de hojas y parámetros
+    // de construcción) como sección del formato mapeable, ligado a la base con
+    // `dataset_checksum` (ver writeDatabaseFile)
+    std::string serialize(uint64_t dataset_checksum) const {
+        std::string out(sizeof(TreeSectionHeader), '\0');
+        auto append = [&out](const void* data, size_t bytes) -> uint64_t {
+            size_t offset = (out.size() + kVectorAlignment - 1) / kVectorAlignment * kVectorAlignment;
+            out.resize(offset, '\0');
+            out.append(static_cast<const char*>(data), bytes);
+            return offset;
+        };
         
-        for (const auto& item : data) {
-            double dist = (query - item.embedding).norm();
-            if (dist < min_dist) {
-                min_dist = dist;
-                nearest_text = item.text;
-            }
+        // Nodos campo por campo, así el relleno del struct queda en cero
+        std::vector<char> node_bytes(nodes.size() * sizeof(Node), 0);
+        for (size_t i = 0; i < nodes.size(); i++) {
+            Node* dst = reinterpret_cast<Node*>(&node_bytes[i * sizeof(Node)]);
+            dst->split = nodes[i].split;
+            dst->axis = nodes[i].axis;
+            dst->left = nodes[i].left;
+            dst->right = nodes[i].right;
         }
         
-        return std::make_pair(min_dist, nearest_text);
+        TreeSectionHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kTreeSectionMagic, sizeof(header.magic));
+        header.version = kTreeSectionVersion;
+        header.element_type = static_cast<uint32_t>(points.getElementType());
+        header.dataset_checksum = dataset_checksum;
+        header.leaf_size = leaf_size;
+        header.dimensions = dimensions;
+        header.rerank = rerank;
+        header.split_rule = static_cast<int32_t>(split_rule);
+        header.top_variance_dims = top_variance_dims;
+        header.seed = seed;
+        header.node_count = nodes.size();
+        header.point_count = ids.size();
+        header.nodes_offset = append(node_bytes.data(), node_bytes.size());
+        header.ids_offset = append(ids.data(), ids.size() * sizeof(int));
+        header.rows_offset = append(points.rowData(), points.rowBytes());
+        header.rows_bytes = points.rowBytes();
+        if (points.scaleData()) {
+            header.scale_offset = append(points.scaleData(), dimensions * sizeof(float));
+        }
+        if (points.exactData()) {
+            header.exact_offset = append(points.exactData(), points.exactBytes());
+            header.exact_bytes = points.exactBytes();
+        }
+        header.metric = static_cast<int32_t>(points.getMetric());
+        header.tree_checksum = treeChecksum(header, node_bytes.data(), ids.data());
+        
+        std::memcpy(&out[0], &header, sizeof(header));
+        return out;
     }
     
-    size_t getSize() const {
-        return data.size();
+    // Cargar el árbol guardado en una base mapeada sin reconstruirlo: nodos e
+    // ids se copian, los vectores y textos se usan desde el mapeo (que debe
+    // vivir más que el árbol). Devuelve nullptr si la base no tiene árbol o si
+    // el árbol no corresponde a esta base o está dañado.
+    static std::unique_ptr<KDTree> loadFromDatabase(const MappedDatabase& database) {
+        size_t bytes = 0;
+        const char* section = database.treeSection(bytes);
+        if (!section) {
+            return std::unique_ptr<KDTree>();
+        }
+        
+        TreeSectionHeader header;
+        if (bytes < sizeof(header)) {
+            std::cerr << "Error: la sección del árbol está truncada" << std::endl;
+            return std::unique_ptr<KDTree>();
+        }
+        std::memcpy(&header, section, sizeof(header));
+        
+        if (std::memcmp(header.magic, kTreeSectionMagic, sizeof(header.magic)) != 0 ||
+            header.version != kTreeSectionVersion) {
+            std::cerr << "Error: sección de árbol con firma o versión desconocida" << std::endl;
+            return std::unique_ptr<KDTree>();
+        }
+        if (header.dataset_checksum != database.getChecksum()) {
+            std::cerr << "Error: el árbol guardado no corresponde a esta base (checksum distinto)" << std::endl;
+            return std::unique_ptr<KDTree>();
+        }
+        
+        ElementType type = static_cast<ElementType>(header.element_type);
+        bool valid = header.element_type <= static_cast<uint32_t>(ElementType::Int8) &&
+                     header.metric >= 0 && header.metric <= static_cast<int32_t>(Metric::Cosine) &&
+                     header.point_count == static_cast<uint64_t>(database.size()) &&
+                     header.dimensions == database.getDimensions() &&
+                     header.nodes_offset + header.node_count * sizeof(Node) <= bytes &&
+                     header.ids_offset + header.point_count * sizeof(int) <= bytes &&
+                     header.rows_offset + header.rows_bytes <= bytes &&
+                     header.scale_offset + (header.scale_offset ? header.dimensions * sizeof(float) : 0) <= bytes &&
+                     header.exact_offset + header.exact_bytes <= bytes;
+        if (!valid || treeChecksum(header, section + header.nodes_offset, section + header.ids_offset) !=
+                      header.tree_checksum) {
+            std::cerr << "Error: la sección del árbol está dañada" << std::endl;
+            return std::unique_ptr<KDTree>();
+        }
+        
+        std::unique_ptr<KDTree> tree(new KDTree());
+        tree->leaf_size = header.leaf_size;
+        tree->dimensions = header.dimensions;
+        tree->rerank = header.rerank;
+        tree->split_rule = static_cast<SplitRule>(header.split_rule);
+        tree->top_variance_dims = header.top_variance_dims;
+        tree->seed = header.seed;
+        
+        tree->nodes.resize(header.node_count);
+        std::memcpy(tree->nodes.data(), section + header.nodes_offset, header.node_count * sizeof(Node));
+        tree->ids.resize(header.point_count);
+        std::memcpy(tree->ids.data(), section + header.ids_offset, header.point_count * sizeof(int));
+        
+        const float* scales = header.scale_offset ?
+            reinterpret_cast<const float*>(section + header.scale_offset) : nullptr;
+        const float* exact = header.exact_bytes ?
+            reinterpret_cast<const float*>(section + header.exact_offset) : nullptr;
+        if (!tree->points.restore(type, header.dimensions, static_cast<int>(header.point_count),
+                                  section + header.rows_offset, scales, exact) ||
+            tree->points.rowBytes() != header.rows_bytes) {
+            std::cerr << "Error: los vectores del árbol guardado no son utilizables" << std::endl;
+            return std::unique_ptr<KDTree>();
+        }
+        // Las filas ya están preparadas para la métrica (normalizadas con coseno);
+        // con producto interno se recalcula R^2 sobre ellas
+        tree->points.setMetric(static_cast<Metric>(header.metric));
+        
+        tree->texts.view(database);
+        return tree;
     }
 };
 
@@ -0,0 +1,296 @@
+#ifndef LINEAR_SEARCH_H
+#define LINEAR_SEARCH_H
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <cmath>
+#include <utility>
+#include "kdtree.h"
+#include "mapped_database.h"
+#include "thread_pool.h"
+#include "topk.h"
+#include "vector_store.h"
+
+// Búsqueda exacta por fuerza bruta (línea base para comparar con KDTree).
+// Recorre una matriz contigua y alineada con los kernels SIMD de distance.h,
+// trabaja con distancias de búsqueda y solo convierte las de los ganadores
+// (raíz con L2, ver Metric).
+class LinearSearch {
+private:
+    VectorStore vectors;
+    TextTable texts;
+    std::vector<double> row_norms;   // ||x||^2 de cada fila (f64/f32), para el camino por bloques
+    const double* mapped_norms;      // Normas guardadas en la base mapeada (vista sin copia)
+    int first_id;                    // Id de la fila 0 (un rango de la base empieza en begin)
+    
+    const double* rowNorms() const {
+        return mapped_norms ? mapped_norms : row_norms.data();
+    }
+    
+    // Consultas por bloque y filas de la base por bloque en el camino tipo GEMM
+    static const int kQueryBlock = 64;
+    static const int kRowBlock = 1024;
+    
+    // Ofrecer todas las filas a `top` con los kernels de longitud de fila N
+    // (0 = dinámica, ver dispatchDimension)
+    template <int N>
+    void scanRows(const VectorStore::Query& q, TopK& top) const {
+        for (int i = 0; i < vectors.size(); i++) {
+            double dist = vectors.distance<N>(q, i);
+            if (dist < top.threshold()) {
+                top.push(dist, i);
+            }
+        }
+    }
+    
+    struct RowScan {
+        const LinearSearch& search;
+        const VectorStore::Query& q;
+        TopK& top;
+        
+        template <int N>
+        void run() const {
+            search.scanRows<N>(q, top);
+        }
+    };
+    
+    // Filas más cercanas; `query_norm2` queda con ||q||^2 de la consulta preparada
+    std::vector<std::pair<double, int>> kNearestRows(const Point& query, int k, double& query_norm2) const {
+        VectorStore::Query q;
+        vectors.prepare(query, q);
+        query_norm2 = q.norm2;
+        SearchCounters::query();
+        SearchCounters::distance(vectors.size());
+        
+        TopK top(k);
+        RowScan scan = {*this, q, top};
+        dispatchDimension(vectors.kernelDimension(), scan);
+        
+        std::vector<std::pair<double, int>> rows;
+        top.extractSorted(rows);
+        return rows;
+    }
+    
+    // Bloque de consultas [qbegin, qend) contra toda la base: cada pasada por un
+    // bloque de filas calcula todos los productos punto con una multiplicación de
+    // matrices y usa ||q - x||^2 = ||q||^2 + ||x||^2 - 2 q.x (con coseno y
+    // producto interno ||x||^2 pasa a ser el R^2 de VectorStore::dotDistance)
+    template <typename Scalar>
+    void blockedKNearest(const Scalar* rows, const std::vector<Point>& queries, int qbegin, int qend,
+                         int k, std::vector<std::vector<std::pair<double, int>>>& out,
+                         std::vector<double>& out_norms) const {
+        typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMatrix;
+        
+        int stride = vectors.getStride();
+        int dims = vectors.getDimensions();
+        int bq = qend - qbegin;
+        
+        RowMatrix q_block = RowMatrix::Zero(bq, stride);
+        std::vector<double> q_norms(bq);
+        for (int b = 0; b < bq; b++) {
+            double factor = vectors.queryScale(queries[qbegin + b]);
+            q_block.row(b).head(dims) = (queries[qbegin + b] * factor).transpose().template cast<Scalar>();
+            q_norms[b] = q_block.row(b).template cast<double>().squaredNorm();
+            out_norms[qbegin + b] = q_norms[b];
+        }
+        
+        for (int b = 0; b < bq; b++) {
+            SearchCounters::query();
+            SearchCounters::distance(vectors.size());
+        }
+        
+        std::vector<TopK> tops(bq, TopK(k));
+        RowMatrix products;
+        const double* norms = rowNorms();
+        bool use_norms = vectors.getMetric() == Metric::L2;
+        double max_norm2 = vectors.getMaxNorm2();
+        
+        for (int start = 0; start < vectors.size(); start += kRowBlock) {
+            int len = std::min(kRowBlock, vectors.size() - start);
+            Eigen::Map<const RowMatrix> x_block(rows + static_cast<size_t>(start) * stride, len, stride);
+            products.noalias() = q_block * x_block.transpose();
+            
+            for (int b = 0; b < bq; b++) {
+                TopK& top = tops[b];
+                const Scalar* dots = products.row(b).data();
+                for (int j = 0; j < len; j++) {
+                    double x_norm2 = use_norms ? norms[start + j] : max_norm2;
+                    double dist = std::max(0.0, q_norms[b] + x_norm2 - 2.0 * dots[j]);
+                    if (dist < top.threshold()) {
+                        top.push(dist, start + j);
+                    }
+                }
+            }
+        }
+        
+        for (int b = 0; b < bq; b++) {
+            tops[b].extractSorted(out[qbegin + b]);
+        }
+    }
+    
+    // Las filas son los ids (desde first_id): solo falta pasar a la distancia reportada
+    std::vector<Neighbor> toResult(std::vector<std::pair<double, int>>&& rows, double query_norm2) const {
+        for (size_t i = 0; i < rows.size(); i++) {
+            rows[i].first = vectors.reportedDistance(rows[i].first, query_norm2);
+            rows[i].second += first_id;
+        }
+        return std::move(rows);
+    }
+    
+    // Normas de las filas tal como quedaron almacenadas
+    void computeRowNorms() {
+        int stride = vectors.getStride();
+        row_norms.clear();
+        if (vectors.getElementType() == ElementType::Float64) {
+            row_norms.resize(vectors.size());
+            for (int i = 0; i < vectors.size(); i++) {
+                const double* row = vectors.rowsF64() + static_cast<size_t>(i) * stride;
+                row_norms[i] = dotProduct(row, row, stride);
+            }
+        } else if (vectors.getElementType() == ElementType::Float32) {
+            row_norms.resize(vectors.size());
+            for (int i = 0; i < vectors.size(); i++) {
+                const float* row = vectors.rowsF32() + static_cast<size_t>(i) * stride;
+                row_norms[i] = dotProduct(row, row, stride);
+            }
+        }
+    }
+    
+public:
+    LinearSearch(const std::vector<DataItem>& items, ElementType element_type = ElementType::Float64,
+                 Metric metric = Metric::L2)
+        : mapped_norms(nullptr), first_id(0) {
+        vectors.build(element_type, items.empty() ? 0 : static_cast<int>(items[0].embedding.size()),
+                      static_cast<int>(items.size()),
+                      [&](int i) -> const Point& { return items[i].embedding; }, false, metric);
+        texts.assign(items);
+        computeRowNorms();
+    }
+    
+    // Sobre una base mapeada: si el tipo de elemento coincide con el del archivo
+    // se usan sus filas, normas y textos sin copiar nada; si no, se convierten
+    // las filas a un almacén propio (también con coseno si las filas no tienen
+    // norma 1). `database` debe vivir más que la búsqueda.
+    LinearSearch(const MappedDatabase& database, ElementType element_type = ElementType::Float64,
+                 Metric metric = Metric::L2)
+        : LinearSearch(database, 0, database.size(), element_type, metric) {}
+    
+    // Solo el rango de ids [begin, end) de la base, también sin copia; los ids
+    // de los resultados son los de la base
+    LinearSearch(const MappedDatabase& database, int begin, int end,
+                 ElementType element_type = ElementType::Float64, Metric metric = Metric::L2)
+        : mapped_norms(nullptr), first_id(begin) {
+        texts.view(database);
+        size_t element_size = database.getElementType() == ElementType::Float64 ? sizeof(double) : sizeof(float);
+        const char* rows = static_cast<const char*>(database.rows()) +
+                           static_cast<size_t>(begin) * database.getStride() * element_size;
+        if (element_type == database.getElementType() &&
+            vectors.view(element_type, database.getDimensions(), end - begin, database.getStride(), rows,
+                         metric)) {
+            mapped_norms = database.rowNorms() + begin;
+            return;
+        }
+        
+        vectors.build(element_type, database.getDimensions(), end - begin,
+                      [&](int i) { return database.embedding(begin + i); }, false, metric);
+        computeRowNorms();
+    }
+    
+    Neighbor nearest(const Point& query) const {
+        double query_norm2;
+        std::vector<std::pair<double, int>> rows = kNearestRows(query, 1, query_norm2);
+        if (rows.empty()) {
+            return Neighbor(std::numeric_limits<double>::max(), -1);
+        }
+        return Neighbor(vectors.reportedDistance(rows[0].first, query_norm2), first_id + rows[0].second);
+    }
+    
+    // k vecinos más cercanos con un montículo de tamaño fijo
+    std::vector<Neighbor> kNearest(const Point& query, int k) const {
+        if (k <= 0 || vectors.size() == 0) {
+            return std::vector<Neighbor>();
+        }
+        double query_norm2;
+        std::vector<std::pair<double, int>> rows = kNearestRows(query, k, query_norm2);
+        return toResult(std::move(rows), query_norm2);
+    }
+    
+    // k vecinos para un lote de consultas repartido en `threads` hilos (0 = todos
+    // los núcleos). Con f64/f32 cada bloque de consultas comparte una pasada por
+    // la base (camino tipo GEMM); con int8 se escanea consulta por consulta.
+    std::vector<std::vector<Neighbor>> nearestBatch(const std::vector<Point>& queries, int k,
+                                                    int threads = 0) const {
+        int num_queries = static_cast<int>(queries.size());
+        std::vector<std::vector<Neighbor>> results(num_queries);
+        if (k <= 0 || vectors.size() == 0 || num_queries == 0) {
+            return results;
+        }
+        if (threads <= 0) {
+            threads = ThreadPool::hardwareThreads();
+        }
+        
+        std::vector<std::vector<std::pair<double, int>>> rows(num_queries);
+        std::vector<double> norms(num_queries);
+        ElementType type = vectors.getElementType();
+        
+        if (type == ElementType::Int8) {
+            ThreadPool::global().parallelFor(num_queries, threads, [&](int q) {
+                rows[q] = kNearestRows(queries[q], k, norms[q]);
+            });
+        } else {
+            int num_blocks = (num_queries + kQueryBlock - 1) / kQueryBlock;
+            ThreadPool::global().parallelFor(num_blocks, threads, [&](int block) {
+                int qbegin = block * kQueryBlock;
+                int qend = std::min(num_queries, qbegin + kQueryBlock);
+                if (type == ElementType::Float64) {
+                    blockedKNearest(vectors.rowsF64(), queries, qbegin, qend, k, rows, norms);
+                } else {
+                    blockedKNearest(vectors.rowsF32(), queries, qbegin, qend, k, rows, norms);
+                }
+            });
+        }
+        
+        for (int q = 0; q < num_queries; q++) {
+            results[q] = toResult(std::move(rows[q]), norms[q]);
+        }
+        return results;
+    }
+    
+    size_t getSize() const {
+        return vectors.size();
+    }
+    
+    // Texto del documento `id`
+    std::string text(int id) const {
+        return texts[id];
+    }
+    
+    ElementType getElementType() const {
+        return vectors.getElementType();
+    }
+    
+    Metric getMetric() const {
+        return vectors.getMetric();
+    }
+    
+    size_t getVectorBytes() const {
+        return vectors.memoryBytes();
+    }
+    
+    // Bytes propios de las normas (las de una base mapeada no cuentan)
+    size_t getNormBytes() const {
+        return vectorBytes(row_norms);
+    }
+    
+    // Memoria por componente (sin memoria de trabajo: cada consulta usa solo su montículo)
+    MemoryUsage memoryUsage() const {
+        MemoryUsage usage;
+        usage.vectors = vectors.memoryBytes();
+        usage.structure = sizeof(*this) + getNormBytes();
+        usage.payload = texts.memoryBytes();
+        return usage;
+    }
+};
+
+#endif // LINEAR_SEARCH_H
\ No newline at end of file
@@ -3,107 +3,341 @@
 
 #include <iostream>
 #include <string>
-#include <curl/curl.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
 #include <chrono>
 #include <nlohmann/json.hpp>
+#include "http_client.h"
 
 using json = nlohmann::json;
 
-// Función callback para recibir datos de CURL
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* s) {
-    size_t newLength = size * nmemb;
-    try {
-        s->append((char*)contents, newLength);
-        return newLength;
-    } catch(std::bad_alloc& e) {
-        // Manejar error de memoria
-        return 0;
+// Respuesta del servidor LLM a un prompt, con tiempos en milisegundos
+// (fraccionarios) medidos con reloj monótono
+struct LLMResponse {
+    std::string text;
+    std::string error;     // Vacío si la solicitud salió bien
+    double queue_ms;       // Espera en la cola del cliente antes de enviarse
+    double first_token_ms; // Desde el envío hasta el primer texto (sin streaming, hasta la respuesta)
+    double total_ms;       // Desde el envío hasta el último byte
+    int chunks;            // Fragmentos de texto recibidos (tokens con streaming)
+
+    LLMResponse() : queue_ms(0), first_token_ms(0), total_ms(0), chunks(0) {}
+
+    bool ok() const {
+        return error.empty();
+    }
+};
+
+// Parámetros del cliente
+struct LLMClientOptions {
+    std::string url;
+    int max_connections; // Conexiones persistentes (keep-alive) al servidor
+    int max_in_flight;   // Solicitudes HTTP en curso a la vez
+    int max_batch;       // Prompts por solicitud ("prompt": [...]) si el servidor lo admite (1 = sin lotes)
+    bool stream;         // Respuesta por tokens (server-sent events) para medir el primer token
+    double temperature;
+    long timeout_ms;     // Límite por solicitud (0 = sin límite)
+
+    explicit LLMClientOptions(const std::string& url = "http://localhost:8000/v1/completions")
+        : url(url), max_connections(4), max_in_flight(16), max_batch(1), stream(false), temperature(0.7),
+          timeout_ms(60000) {}
+};
+
+// Escribir `text` como string JSON (con comillas y escapes) al final de `out`
+inline void appendJsonString(std::string& out, const std::string& text) {
+    static const char* hex = "0123456789abcdef";
+    out.push_back('"');
+    for (char ch : text) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    out += "\\u00";
+                    out.push_back(hex[c >> 4]);
+                    out.push_back(hex[c & 15]);
+                } else {
+                    out.push_back(ch);
+                }
+        }
     }
+    out.push_back('"');
 }
 
+// Cliente del endpoint de completions (estilo OpenAI) sobre HttpClient: las
+// conexiones se reusan (keep-alive) y un solo hilo atiende todas las
+// solicitudes en curso. submit() no bloquea: devuelve un future o llama a un
+// callback al terminar, y con streaming entrega cada fragmento de texto a
+// medida que llega. Con max_batch > 1 los prompts que esperan (porque ya hay
+// max_in_flight solicitudes en curso) con el mismo max_tokens viajan juntos
+// en una solicitud y cada "choice" vuelve a su prompt por su índice.
 class LLMClient {
-private:
-    std::string server_url;
-    CURL* curl;
-    
 public:
-    LLMClient(const std::string& url = "http://localhost:8000/v1/completions") 
-        : server_url(url), curl(nullptr) {
-        // Inicializar CURL
-        curl_global_init(CURL_GLOBAL_DEFAULT);
-        curl = curl_easy_init();
-        
-        if (!curl) {
-            std::cerr << "Error: No se pudo inicializar CURL" << std::endl;
+    typedef std::function<void(const std::string&)> TokenCallback;
+    typedef std::function<void(LLMResponse&&)> DoneCallback;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // Un prompt pendiente o en curso
+    struct Job {
+        std::string prompt;
+        int max_tokens;
+        TokenCallback on_token;
+        DoneCallback on_done;
+        LLMResponse response;
+        Clock::time_point submitted;
+    };
+
+    // Una solicitud HTTP con uno o más prompts
+    struct Batch {
+        std::vector<std::unique_ptr<Job>> jobs;
+        std::string events; // Resto de los eventos recibidos sin procesar (streaming)
+        Clock::time_point sent;
+    };
+
+    LLMClientOptions options;
+    std::deque<std::unique_ptr<Job>> pending; // Protegidos por `mutex`
+    int in_flight;
+    std::mutex mutex;
+    std::condition_variable drained;
+    HttpClient http; // Último: se destruye primero y espera a sus callbacks
+
+    static double millis(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    static HttpClientOptions httpOptions(const LLMClientOptions& options) {
+        HttpClientOptions http_options;
+        http_options.max_connections = options.max_connections;
+        http_options.timeout_ms = options.timeout_ms;
+        http_options.headers.push_back("Content-Type: application/json");
+        if (options.stream) {
+            http_options.headers.push_back("Accept: text/event-stream");
         }
+        return http_options;
     }
-    
-    ~LLMClient() {
-        if (curl) {
-            curl_easy_cleanup(curl);
+
+    // Texto de cada "choice" de un objeto de respuesta, entregado al prompt de su
+    // índice. Corre en el hilo de libcurl: una respuesta mal formada se ignora
+    // en lugar de lanzar (los get<> de json lanzan type_error)
+    static void dispatchChoices(Batch& batch, const json& response, Clock::time_point now) {
+        if (!response.contains("choices") || !response["choices"].is_array()) {
+            return;
+        }
+        for (const auto& choice : response["choices"]) {
+            if (choice.contains("index") && !choice["index"].is_number_unsigned()) {
+                continue;
+            }
+            size_t index = choice.contains("index") ? choice["index"].get<size_t>() : 0;
+            if (index >= batch.jobs.size() || !choice.contains("text") || !choice["text"].is_string()) {
+                continue;
+            }
+            Job& job = *batch.jobs[index];
+            std::string text = choice["text"].get<std::string>();
+            if (text.empty()) {
+                continue;
+            }
+            if (job.response.chunks == 0) {
+                job.response.first_token_ms = millis(batch.sent, now);
+            }
+            job.response.chunks++;
+            job.response.text += text;
+            if (job.on_token) {
+                job.on_token(text);
+            }
         }
-        curl_global_cleanup();
     }
-    
-    // Método para enviar consultas al servidor LLM y medir tiempo
-    std::pair<std::string, double> query(const std::string& prompt, int max_tokens = 100) {
-        if (!curl) {
-            return {"Error: CURL no inicializado", 0.0};
+
+    // Procesar las líneas "data: {...}" completas recibidas hasta ahora
+    static void consumeEvents(Batch& batch, const char* data, size_t length) {
+        batch.events.append(data, length);
+        Clock::time_point now = Clock::now();
+        size_t start = 0;
+        size_t end;
+        while ((end = batch.events.find('\n', start)) != std::string::npos) {
+            std::string line = batch.events.substr(start, end - start);
+            start = end + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.compare(0, 5, "data:") != 0) {
+                continue;
+            }
+            std::string payload = line.substr(line.size() > 5 && line[5] == ' ' ? 6 : 5);
+            if (payload == "[DONE]") {
+                continue;
+            }
+            json event = json::parse(payload, nullptr, false);
+            if (!event.is_discarded()) {
+                dispatchChoices(batch, event, now);
+            }
+        }
+        batch.events.erase(0, start);
+    }
+
+    std::string requestBody(const std::vector<std::unique_ptr<Job>>& jobs) const {
+        std::string body = "{\"max_tokens\":" + std::to_string(jobs[0]->max_tokens) +
+                           ",\"temperature\":" + std::to_string(options.temperature) +
+                           (options.stream ? ",\"stream\":true" : "") + ",\"prompt\":";
+        if (jobs.size() == 1) {
+            appendJsonString(body, jobs[0]->prompt);
+        } else {
+            body.push_back('[');
+            for (size_t i = 0; i < jobs.size(); i++) {
+                if (i > 0) {
+                    body.push_back(',');
+                }
+                appendJsonString(body, jobs[i]->prompt);
+            }
+            body.push_back(']');
         }
-        
-        // Preparar datos JSON para la consulta
-        json request_data = {
-            {"prompt", prompt},
-            {"max_tokens", max_tokens},
-            {"temperature", 0.7}
-        };
-        
-        std::string request_str = request_data.dump();
-        
-        // Configurar la solicitud HTTP
-        curl_easy_setopt(curl, CURLOPT_URL, server_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request_str.c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, request_str.length());
-        
-        // Configurar headers
-        struct curl_slist* headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        
-        // Configurar callback para recibir respuesta
-        std::string response_string;
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
-        
-        // Medir tiempo de ejecución
-        auto start_time = std::chrono::high_resolution_clock::now();
-        
-        // Realizar la solicitud
-        CURLcode res = curl_easy_perform(curl);
-        
-        // Terminar medición de tiempo
-        auto end_time = std::chrono::high_resolution_clock::now();
-        double elapsed_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
-        
-        // Liberar recursos
-        curl_slist_free_all(headers);
-        
-        // Procesar respuesta
-        if (res != CURLE_OK) {
-            return {std::string("Error en CURL: ") + curl_easy_strerror(res), elapsed_time};
+        body.push_back('}');
+        return body;
+    }
+
+    // Enviar lotes mientras haya prompts esperando y lugar para otra solicitud.
+    // Cada lote son los prompts seguidos de la cola con el mismo max_tokens
+    void pump() {
+        while (true) {
+            std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (pending.empty() || in_flight >= std::max(1, options.max_in_flight)) {
+                    return;
+                }
+                int max_tokens = pending.front()->max_tokens;
+                while (!pending.empty() && static_cast<int>(batch->jobs.size()) < std::max(1, options.max_batch) &&
+                       pending.front()->max_tokens == max_tokens) {
+                    batch->jobs.push_back(std::move(pending.front()));
+                    pending.pop_front();
+                }
+                in_flight++;
+            }
+            send(batch);
         }
-        
-        try {
-            json response = json::parse(response_string);
-            if (response.contains("choices") && !response["choices"].empty() && 
-                response["choices"][0].contains("text")) {
-                return {response["choices"][0]["text"], elapsed_time};
+    }
+
+    void send(const std::shared_ptr<Batch>& batch) {
+        std::string body = requestBody(batch->jobs);
+        batch->sent = Clock::now();
+        for (auto& job : batch->jobs) {
+            job->response.queue_ms = millis(job->submitted, batch->sent);
+        }
+        HttpClient::DataCallback on_data;
+        if (options.stream) {
+            on_data = [batch](const char* data, size_t length) {
+                consumeEvents(*batch, data, length);
+            };
+        }
+        http.post(options.url, body, [this, batch](HttpResponse&& response) {
+            finish(*batch, response);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                in_flight--;
+            }
+            drained.notify_all();
+            pump();
+        }, on_data);
+    }
+
+    void finish(Batch& batch, const HttpResponse& http_response) {
+        Clock::time_point now = Clock::now();
+        std::string error = http_response.error;
+        if (!error.empty() && !http_response.body.empty()) {
+            error += ": " + http_response.body.substr(0, 200);
+        } else if (error.empty() && !options.stream) {
+            json response = json::parse(http_response.body, nullptr, false);
+            if (response.is_discarded()) {
+                error = "Error al procesar JSON de la respuesta";
             } else {
-                return {"Formato de respuesta inesperado", elapsed_time};
+                dispatchChoices(batch, response, now);
             }
-        } catch (const std::exception& e) {
-            return {std::string("Error al procesar JSON: ") + e.what(), elapsed_time};
         }
+
+        for (auto& job : batch.jobs) {
+            job->response.total_ms = millis(batch.sent, now);
+            if (!error.empty()) {
+                job->response.error = error;
+            } else if (job->response.chunks == 0) {
+                job->response.error = "Formato de respuesta inesperado";
+                job->response.first_token_ms = job->response.total_ms;
+            }
+            if (job->on_done) {
+                job->on_done(std::move(job->response));
+            }
+        }
+    }
+
+public:
+    explicit LLMClient(const LLMClientOptions& options)
+        : options(options), in_flight(0), http(httpOptions(options)) {}
+
+    explicit LLMClient(const std::string& url = "http://localhost:8000/v1/completions")
+        : LLMClient(LLMClientOptions(url)) {}
+
+    // Termina los prompts pendientes y en curso antes de cerrar las conexiones
+    ~LLMClient() {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [this] { return pending.empty() && in_flight == 0; });
+    }
+
+    LLMClient(const LLMClient&) = delete;
+    LLMClient& operator=(const LLMClient&) = delete;
+
+    // Encolar un prompt; `on_done` se llama desde el hilo del cliente al
+    // terminar y `on_token` con cada fragmento de texto (streaming)
+    void submit(const std::string& prompt, int max_tokens, const TokenCallback& on_token, const DoneCallback& on_done) {
+        std::unique_ptr<Job> job(new Job());
+        job->prompt = prompt;
+        job->max_tokens = max_tokens;
+        job->on_token = on_token;
+        job->on_done = on_done;
+        job->submitted = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(std::move(job));
+        }
+        pump();
+    }
+
+    std::future<LLMResponse> submit(const std::string& prompt, int max_tokens = 100,
+                                    const TokenCallback& on_token = TokenCallback()) {
+        std::shared_ptr<std::promise<LLMResponse>> promise = std::make_shared<std::promise<LLMResponse>>();
+        std::future<LLMResponse> future = promise->get_future();
+        submit(prompt, max_tokens, on_token, [promise](LLMResponse&& response) {
+            promise->set_value(std::move(response));
+        });
+        return future;
+    }
+
+    // Varios prompts a la vez: viajan en lotes de max_batch y en paralelo
+    std::vector<std::future<LLMResponse>> submitAll(const std::vector<std::string>& prompts, int max_tokens = 100) {
+        std::vector<std::future<LLMResponse>> futures;
+        for (const auto& prompt : prompts) {
+            futures.push_back(submit(prompt, max_tokens));
+        }
+        return futures;
+    }
+
+    // Consulta bloqueante: texto (o el error) y tiempo total en milisegundos
+    std::pair<std::string, double> query(const std::string& prompt, int max_tokens = 100) {
+        LLMResponse response = submit(prompt, max_tokens).get();
+        return {response.ok() ? response.text : response.error, response.total_ms};
+    }
+
+    const LLMClientOptions& getOptions() const {
+        return options;
     }
 };
 
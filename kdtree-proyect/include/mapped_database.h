@@ -0,0 +1,696 @@
+#ifndef MAPPED_DATABASE_H
+#define MAPPED_DATABASE_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+#include <Eigen/Dense>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "data_item.h"
+#include "vector_store.h"
+#include "memory_usage.h"
+
+// Formato binario versionado de la base procesada, pensado para usarse con
+// mmap sin copiar nada al cargar:
+//
+//   [cabecera 128 B][embeddings][normas][offsets de texto][textos][árbol]
+//
+// Cada sección empieza alineada a kVectorAlignment. Los embeddings son
+// `count` filas de `stride` elementos (dims rellenado con ceros, como en
+// VectorStore), así los índices pueden usar el bloque mapeado directamente.
+// Las normas son ||x||^2 de cada fila en double; los offsets de texto son
+// count + 1 enteros de 64 bits dentro del blob de textos. La sección del árbol
+// es opcional (tree_bytes = 0 si no hay). Todos los enteros son little-endian.
+//
+// Versiones: 1 = primera versión; 2 = agrega el checksum de los datos, que
+// liga cada árbol guardado con la base de la que se construyó.
+const char kDatabaseMagic[8] = {'K', 'D', 'V', 'E', 'C', 'D', 'B', '\0'};
+const uint32_t kDatabaseFormatVersion = 2;
+
+// Hash FNV-1a por palabras de 64 bits (y bytes sueltos al final). Encadenable:
+// pasar el resultado como `seed` del bloque siguiente equivale a procesar
+// ambos bloques juntos mientras el primero mida un múltiplo de 8 bytes.
+inline uint64_t checksum64(const void* data, size_t bytes, uint64_t seed = 14695981039346656037ull) {
+    const uint64_t prime = 1099511628211ull;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t h = seed;
+    size_t words = bytes / sizeof(uint64_t);
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word;
+        std::memcpy(&word, p + i * sizeof(uint64_t), sizeof(word));
+        h = (h ^ word) * prime;
+    }
+    for (size_t i = words * sizeof(uint64_t); i < bytes; i++) {
+        h = (h ^ p[i]) * prime;
+    }
+    return h;
+}
+
+struct DatabaseFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t element_type;   // ElementType de las filas (solo f64 o f32)
+    uint64_t count;
+    uint32_t dims;
+    uint32_t stride;         // Elementos por fila
+    int64_t processed_lines; // Líneas del JSONL de origen
+    uint64_t embeddings_offset;
+    uint64_t embeddings_bytes;
+    uint64_t norms_offset;
+    uint64_t text_offsets_offset;
+    uint64_t text_blob_offset;
+    uint64_t text_blob_bytes;
+    uint64_t tree_offset;
+    uint64_t tree_bytes;
+    uint64_t file_bytes;
+    uint64_t checksum;       // Tipo, dimensiones, filas y offsets de texto (ver writeDatabaseFile)
+    uint8_t reserved[8];
+};
+
+static_assert(sizeof(DatabaseFileHeader) == 128, "la cabecera debe medir 128 bytes");
+
+// Sección del árbol a guardar junto a la base: recibe el checksum de los datos
+// y devuelve los bytes de la sección
+typedef std::function<std::string(uint64_t)> TreeSectionWriter;
+
+// Offset redondeado al siguiente múltiplo de kVectorAlignment
+inline uint64_t alignSection(uint64_t offset) {
+    return (offset + kVectorAlignment - 1) / kVectorAlignment * kVectorAlignment;
+}
+
+// Cabecera de una base vacía con filas `element_type` de `dims` elementos
+inline void initDatabaseHeader(DatabaseFileHeader& header, ElementType element_type, int dims) {
+    size_t element_size = element_type == ElementType::Float64 ? sizeof(double) : sizeof(float);
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kDatabaseMagic, sizeof(header.magic));
+    header.version = kDatabaseFormatVersion;
+    header.element_type = static_cast<uint32_t>(element_type);
+    header.dims = static_cast<uint32_t>(std::max(0, dims));
+    header.stride = static_cast<uint32_t>(VectorStore::paddedLength(header.dims, element_size));
+    header.embeddings_offset = alignSection(sizeof(DatabaseFileHeader));
+}
+
+// Secciones de una base de `count` filas y `text_bytes` de textos, sin árbol
+inline void layoutDatabaseSections(DatabaseFileHeader& header, uint64_t count, uint64_t text_bytes) {
+    size_t element_size = header.element_type == static_cast<uint32_t>(ElementType::Float64) ?
+        sizeof(double) : sizeof(float);
+    header.count = count;
+    header.embeddings_bytes = count * header.stride * element_size;
+    header.norms_offset = alignSection(header.embeddings_offset + header.embeddings_bytes);
+    header.text_offsets_offset = alignSection(header.norms_offset + count * sizeof(double));
+    header.text_blob_offset = alignSection(header.text_offsets_offset + (count + 1) * sizeof(uint64_t));
+    header.text_blob_bytes = text_bytes;
+    header.file_bytes = header.text_blob_offset + header.text_blob_bytes;
+}
+
+// Semilla del checksum: la forma de la base con `count` filas
+inline uint64_t databaseShapeChecksum(const DatabaseFileHeader& header, uint64_t count) {
+    uint64_t shape[4] = {header.element_type, count, header.dims, header.stride};
+    return checksum64(shape, sizeof(shape));
+}
+
+// Escritura incremental del formato mapeable, para bases que no caben (o no
+// conviene tener) en memoria. Cada fila se escribe al llegar y su texto va a
+// un archivo temporal que se copia tras los offsets en finish(); solo se
+// acumulan la norma y el offset de texto de cada fila (16 bytes por fila).
+// Si al abrir se conoce el número de filas el checksum se calcula al vuelo;
+// si no, finish() relee las filas escritas.
+class DatabaseFileWriter {
+private:
+    std::string filename;
+    std::string spool_filename;
+    std::ofstream outfile;
+    std::ofstream spool;
+    DatabaseFileHeader header;
+    size_t element_size;
+    int64_t expected_count;
+    uint64_t checksum;
+    uint64_t written;
+    std::vector<double> norms;
+    std::vector<uint64_t> text_offsets;
+    std::vector<double> row_f64;
+    std::vector<float> row_f32;
+
+    void write(const void* data, uint64_t bytes) {
+        outfile.write(static_cast<const char*>(data), bytes);
+        written += bytes;
+    }
+
+    void padTo(uint64_t offset) {
+        static const char zeros[kVectorAlignment] = {0};
+        write(zeros, offset - written);
+    }
+
+    // Checksum de las filas ya escritas, releídas del archivo por bloques
+    bool rereadChecksum() {
+        outfile.flush();
+        std::ifstream infile(filename, std::ios::binary);
+        infile.seekg(header.embeddings_offset);
+        uint64_t row_bytes = header.stride * element_size;
+        uint64_t rows_per_block = std::max<uint64_t>(1, (1 << 20) / row_bytes);
+        std::vector<char> block(rows_per_block * row_bytes);
+        checksum = databaseShapeChecksum(header, header.count);
+        for (uint64_t done = 0; done < header.count; ) {
+            uint64_t rows = std::min(rows_per_block, header.count - done);
+            infile.read(block.data(), rows * row_bytes);
+            if (!infile) {
+                return false;
+            }
+            checksum = checksum64(block.data(), rows * row_bytes, checksum);
+            done += rows;
+        }
+        return true;
+    }
+
+    bool fail(const std::string& reason) {
+        std::cerr << "Error al escribir " << filename << ": " << reason << std::endl;
+        outfile.close();
+        discardSpool();
+        return false;
+    }
+
+    void discardSpool() {
+        if (spool.is_open()) {
+            spool.close();
+        }
+        if (!spool_filename.empty()) {
+            std::remove(spool_filename.c_str());
+            spool_filename.clear();
+        }
+    }
+
+public:
+    DatabaseFileWriter() : element_size(sizeof(double)), expected_count(-1), checksum(0), written(0) {
+        std::memset(&header, 0, sizeof(header));
+    }
+
+    ~DatabaseFileWriter() {
+        discardSpool();
+    }
+
+    DatabaseFileWriter(const DatabaseFileWriter&) = delete;
+    DatabaseFileWriter& operator=(const DatabaseFileWriter&) = delete;
+
+    // Filas float64 o float32 de `dims` elementos; `expected_count` < 0 si no
+    // se sabe cuántas habrá
+    bool open(const std::string& filename, ElementType element_type, int dims, int64_t expected_count = -1) {
+        this->filename = filename;
+        if (element_type == ElementType::Int8) {
+            std::cerr << "Error: el formato mapeable solo guarda filas f64 o f32" << std::endl;
+            return false;
+        }
+
+        outfile.open(filename, std::ios::binary);
+        if (!outfile.is_open()) {
+            std::cerr << "Error: No se pudo abrir " << filename << " para escribir" << std::endl;
+            return false;
+        }
+        spool_filename = filename + ".textos.tmp";
+        spool.open(spool_filename, std::ios::binary);
+        if (!spool.is_open()) {
+            return fail("no se pudo crear " + spool_filename);
+        }
+
+        element_size = element_type == ElementType::Float64 ? sizeof(double) : sizeof(float);
+        initDatabaseHeader(header, element_type, dims);
+
+        this->expected_count = expected_count;
+        checksum = expected_count >= 0 ? databaseShapeChecksum(header, expected_count) : 0;
+        written = 0;
+        norms.clear();
+        text_offsets.assign(1, 0);
+        row_f64.assign(header.element_type == static_cast<uint32_t>(ElementType::Float64) ? header.stride : 0, 0.0);
+        row_f32.assign(header.element_type == static_cast<uint32_t>(ElementType::Float32) ? header.stride : 0, 0.0f);
+        if (expected_count > 0) {
+            norms.reserve(expected_count);
+            text_offsets.reserve(expected_count + 1);
+        }
+
+        // La cabecera definitiva se escribe en finish()
+        write(&header, sizeof(header));
+        padTo(header.embeddings_offset);
+        return static_cast<bool>(outfile);
+    }
+
+    // Agregar la fila siguiente
+    bool append(const std::string& text, const Point& embedding) {
+        if (embedding.size() != static_cast<Eigen::Index>(header.dims)) {
+            return fail("la fila " + std::to_string(norms.size()) + " tiene dimensión " +
+                        std::to_string(embedding.size()) + " (se esperaba " + std::to_string(header.dims) + ")");
+        }
+        int dims = static_cast<int>(header.dims);
+        if (!row_f64.empty()) {
+            Eigen::Map<Eigen::VectorXd>(row_f64.data(), dims) = embedding;
+            norms.push_back(dotProduct(row_f64.data(), row_f64.data(), header.stride));
+            write(row_f64.data(), header.stride * sizeof(double));
+            if (expected_count >= 0) {
+                checksum = checksum64(row_f64.data(), header.stride * sizeof(double), checksum);
+            }
+        } else {
+            Eigen::Map<Eigen::VectorXf>(row_f32.data(), dims) = embedding.cast<float>();
+            norms.push_back(dotProduct(row_f32.data(), row_f32.data(), header.stride));
+            write(row_f32.data(), header.stride * sizeof(float));
+            if (expected_count >= 0) {
+                checksum = checksum64(row_f32.data(), header.stride * sizeof(float), checksum);
+            }
+        }
+        spool.write(text.data(), text.size());
+        text_offsets.push_back(text_offsets.back() + text.size());
+        return static_cast<bool>(outfile) && static_cast<bool>(spool);
+    }
+
+    // Filas agregadas hasta ahora
+    uint64_t size() const {
+        return norms.size();
+    }
+
+    // Escribir normas, offsets, textos y (opcional) el árbol, y cerrar el archivo
+    bool finish(int64_t processed_lines, const TreeSectionWriter& tree_section = TreeSectionWriter()) {
+        uint64_t count = norms.size();
+        layoutDatabaseSections(header, count, text_offsets.back());
+        header.processed_lines = processed_lines;
+
+        // El checksum cubre la forma de la base, las filas tal como se guardan y
+        // la longitud de cada texto (los embeddings ya derivan del contenido)
+        if (expected_count != static_cast<int64_t>(count) && !rereadChecksum()) {
+            return fail("no se pudieron releer las filas");
+        }
+
+        padTo(header.norms_offset);
+        write(norms.data(), count * sizeof(double));
+
+        padTo(header.text_offsets_offset);
+        write(text_offsets.data(), text_offsets.size() * sizeof(uint64_t));
+        header.checksum = checksum64(text_offsets.data(), text_offsets.size() * sizeof(uint64_t), checksum);
+
+        padTo(header.text_blob_offset);
+        spool.close();
+        if (header.text_blob_bytes > 0) {
+            std::ifstream texts(spool_filename, std::ios::binary);
+            outfile << texts.rdbuf();
+            written += header.text_blob_bytes;
+        }
+        discardSpool();
+
+        if (tree_section) {
+            std::string tree = tree_section(header.checksum);
+            header.tree_offset = alignSection(written);
+            header.tree_bytes = tree.size();
+            padTo(header.tree_offset);
+            write(tree.data(), tree.size());
+            header.file_bytes = written;
+        }
+
+        // Cabecera definitiva con el checksum y la sección del árbol
+        outfile.seekp(0);
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        outfile.close();
+        if (!outfile) {
+            std::cerr << "Error al escribir " << filename << std::endl;
+            return false;
+        }
+        std::cout << "Base de datos guardada en " << filename << " (" << count << " elementos, formato v"
+                  << kDatabaseFormatVersion << ", " << elementTypeName(static_cast<ElementType>(header.element_type))
+                  << (header.tree_bytes > 0 ? ", con árbol" : "") << ")" << std::endl;
+        return true;
+    }
+};
+
+// Escribe la base en el formato mapeable con filas float64 o float32 y,
+// opcionalmente, la sección de un árbol construido sobre ella
+inline bool writeDatabaseFile(const std::vector<DataItem>& database, const std::string& filename,
+                              int processed_lines, ElementType element_type = ElementType::Float64,
+                              const TreeSectionWriter& tree_section = TreeSectionWriter()) {
+    DatabaseFileWriter writer;
+    int dims = database.empty() ? 0 : static_cast<int>(database[0].embedding.size());
+    if (!writer.open(filename, element_type, dims, static_cast<int64_t>(database.size()))) {
+        return false;
+    }
+    for (const auto& item : database) {
+        if (!writer.append(item.text, item.embedding)) {
+            return false;
+        }
+    }
+    return writer.finish(processed_lines, tree_section);
+}
+
+// Agregar (o reemplazar) la sección del árbol de una base ya escrita, p. ej.
+// cuando la base se generó en streaming y el árbol se construye después. El
+// archivo no debe estar mapeado mientras tanto.
+inline bool appendTreeSection(const std::string& filename, const TreeSectionWriter& tree_section) {
+    std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+    DatabaseFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, kDatabaseMagic, sizeof(kDatabaseMagic)) != 0 ||
+        header.version != kDatabaseFormatVersion) {
+        std::cerr << "Error: " << filename << " no es una base válida" << std::endl;
+        return false;
+    }
+
+    std::string tree = tree_section(header.checksum);
+    uint64_t texts_end = header.text_blob_offset + header.text_blob_bytes;
+    header.tree_offset = alignSection(texts_end);
+    header.tree_bytes = tree.size();
+    header.file_bytes = header.tree_offset + header.tree_bytes;
+
+    static const char zeros[kVectorAlignment] = {0};
+    file.seekp(texts_end);
+    file.write(zeros, header.tree_offset - texts_end);
+    file.write(tree.data(), tree.size());
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    // Descartar un árbol anterior más largo
+    if (!file || truncate(filename.c_str(), header.file_bytes) != 0) {
+        std::cerr << "Error al escribir " << filename << std::endl;
+        return false;
+    }
+    std::cout << "Árbol guardado en " << filename << " (" << tree.size() / 1024 << " KB)" << std::endl;
+    return true;
+}
+
+// Base procesada mapeada con mmap en solo lectura. Abrir es O(1) en el tamaño
+// de la base: solo se valida la cabecera y las páginas se cargan al tocarlas,
+// compartidas en la caché de páginas entre todos los procesos que mapean el
+// mismo archivo. Los índices construidos como vista deben vivir menos que el mapeo.
+//
+// Es también el almacén de documentos en memoria (assign): la misma imagen,
+// una matriz de embeddings y un blob de textos, en memoria anónima. Así cada
+// base existe una sola vez y todos los motores la usan como vista (los textos
+// siempre; las filas si el tipo de elemento coincide) o por rangos de ids.
+class MappedDatabase {
+private:
+    const char* base;
+    size_t length;
+    const DatabaseFileHeader* header;
+
+    const uint64_t* textOffsets() const {
+        return reinterpret_cast<const uint64_t*>(base + header->text_offsets_offset);
+    }
+
+    bool fail(const std::string& filename, const std::string& reason) {
+        std::cerr << "Error: " << filename << " no es una base válida (" << reason << ")" << std::endl;
+        close();
+        return false;
+    }
+
+public:
+    MappedDatabase() : base(nullptr), length(0), header(nullptr) {}
+
+    ~MappedDatabase() {
+        close();
+    }
+
+    MappedDatabase(const MappedDatabase&) = delete;
+    MappedDatabase& operator=(const MappedDatabase&) = delete;
+
+    // true si el archivo empieza con la firma del formato mapeable
+    static bool isDatabaseFile(const std::string& filename) {
+        std::ifstream infile(filename, std::ios::binary);
+        char magic[sizeof(kDatabaseMagic)] = {0};
+        infile.read(magic, sizeof(magic));
+        return infile && std::memcmp(magic, kDatabaseMagic, sizeof(magic)) == 0;
+    }
+
+    bool open(const std::string& filename) {
+        close();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error: No se pudo abrir " << filename << std::endl;
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(DatabaseFileHeader)) {
+            ::close(fd);
+            return fail(filename, "archivo demasiado corto");
+        }
+
+        length = static_cast<size_t>(info.st_size);
+        void* addr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // El mapeo se mantiene sin el descriptor
+        if (addr == MAP_FAILED) {
+            length = 0;
+            std::cerr << "Error: mmap falló para " << filename << std::endl;
+            return false;
+        }
+        base = static_cast<const char*>(addr);
+        header = reinterpret_cast<const DatabaseFileHeader*>(base);
+
+        if (std::memcmp(header->magic, kDatabaseMagic, sizeof(kDatabaseMagic)) != 0) {
+            return fail(filename, "firma incorrecta");
+        }
+        if (header->version != kDatabaseFormatVersion) {
+            return fail(filename, "versión " + std::to_string(header->version) + " no soportada");
+        }
+        ElementType type = static_cast<ElementType>(header->element_type);
+        size_t element_size = type == ElementType::Float64 ? sizeof(double) : sizeof(float);
+        if (type == ElementType::Int8 || header->element_type > static_cast<uint32_t>(ElementType::Int8)) {
+            return fail(filename, "tipo de elemento inválido");
+        }
+        if (header->stride != static_cast<uint32_t>(VectorStore::paddedLength(header->dims, element_size)) ||
+            header->embeddings_bytes != header->count * header->stride * element_size) {
+            return fail(filename, "dimensiones inconsistentes");
+        }
+        if (header->file_bytes != length ||
+            header->embeddings_offset % kVectorAlignment != 0 ||
+            header->embeddings_offset + header->embeddings_bytes > length ||
+            header->norms_offset + header->count * sizeof(double) > length ||
+            header->text_offsets_offset + (header->count + 1) * sizeof(uint64_t) > length ||
+            header->text_blob_offset + header->text_blob_bytes > length ||
+            header->tree_offset + header->tree_bytes > length) {
+            return fail(filename, "secciones fuera del archivo");
+        }
+        if (textOffsets()[header->count] != header->text_blob_bytes) {
+            return fail(filename, "tabla de textos inconsistente");
+        }
+        return true;
+    }
+
+    void close() {
+        if (base) {
+            munmap(const_cast<char*>(base), length);
+        }
+        base = nullptr;
+        length = 0;
+        header = nullptr;
+    }
+
+    // Almacén en memoria con el formato del archivo, a partir de `items`: cada
+    // texto y embedding se libera en cuanto se copia, así el pico es una sola
+    // copia de la base. `items` queda vacío.
+    bool assign(std::vector<DataItem>& items, ElementType element_type = ElementType::Float64,
+                int64_t processed_lines = 0) {
+        close();
+        if (element_type == ElementType::Int8) {
+            std::cerr << "Error: el almacén de documentos solo guarda filas f64 o f32" << std::endl;
+            return false;
+        }
+
+        int dims = items.empty() ? 0 : static_cast<int>(items[0].embedding.size());
+        uint64_t text_bytes = 0;
+        for (const auto& item : items) {
+            if (item.embedding.size() != dims) {
+                std::cerr << "Error: los embeddings de la base tienen dimensiones distintas" << std::endl;
+                return false;
+            }
+            text_bytes += item.text.size();
+        }
+        DatabaseFileHeader image_header;
+        initDatabaseHeader(image_header, element_type, dims);
+        layoutDatabaseSections(image_header, items.size(), text_bytes);
+        image_header.processed_lines = processed_lines;
+
+        // Memoria anónima: llega en ceros, así el relleno entre secciones ya está
+        void* addr = mmap(nullptr, image_header.file_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            std::cerr << "Error: no se pudo reservar el almacén de documentos" << std::endl;
+            return false;
+        }
+        char* image = static_cast<char*>(addr);
+        uint64_t checksum = databaseShapeChecksum(image_header, image_header.count);
+        double* norms = reinterpret_cast<double*>(image + image_header.norms_offset);
+        uint64_t* offsets = reinterpret_cast<uint64_t*>(image + image_header.text_offsets_offset);
+        char* blob = image + image_header.text_blob_offset;
+        offsets[0] = 0;
+        for (size_t i = 0; i < items.size(); i++) {
+            if (element_type == ElementType::Float64) {
+                double* row = reinterpret_cast<double*>(image + image_header.embeddings_offset) + i * image_header.stride;
+                Eigen::Map<Eigen::VectorXd>(row, dims) = items[i].embedding;
+                norms[i] = dotProduct(row, row, image_header.stride);
+                checksum = checksum64(row, image_header.stride * sizeof(double), checksum);
+            } else {
+                float* row = reinterpret_cast<float*>(image + image_header.embeddings_offset) + i * image_header.stride;
+                Eigen::Map<Eigen::VectorXf>(row, dims) = items[i].embedding.cast<float>();
+                norms[i] = dotProduct(row, row, image_header.stride);
+                checksum = checksum64(row, image_header.stride * sizeof(float), checksum);
+            }
+            std::memcpy(blob + offsets[i], items[i].text.data(), items[i].text.size());
+            offsets[i + 1] = offsets[i] + items[i].text.size();
+            std::string().swap(items[i].text);
+            Point().swap(items[i].embedding);
+        }
+        image_header.checksum = checksum64(offsets, (items.size() + 1) * sizeof(uint64_t), checksum);
+        std::memcpy(image, &image_header, sizeof(image_header));
+        mprotect(addr, image_header.file_bytes, PROT_READ);
+        std::vector<DataItem>().swap(items);
+
+        base = image;
+        length = image_header.file_bytes;
+        header = reinterpret_cast<const DatabaseFileHeader*>(base);
+        return true;
+    }
+
+    bool isOpen() const {
+        return base != nullptr;
+    }
+
+    int size() const {
+        return header ? static_cast<int>(header->count) : 0;
+    }
+
+    int getDimensions() const {
+        return header ? static_cast<int>(header->dims) : 0;
+    }
+
+    int getStride() const {
+        return header ? static_cast<int>(header->stride) : 0;
+    }
+
+    ElementType getElementType() const {
+        return header ? static_cast<ElementType>(header->element_type) : ElementType::Float64;
+    }
+
+    uint64_t getChecksum() const {
+        return header ? header->checksum : 0;
+    }
+
+    int getProcessedLines() const {
+        return header ? static_cast<int>(header->processed_lines) : 0;
+    }
+
+    // Bloque de filas (count x stride) en el tipo de elemento del archivo
+    const void* rows() const {
+        return base + header->embeddings_offset;
+    }
+
+    // ||x||^2 de cada fila tal como está guardada
+    const double* rowNorms() const {
+        return reinterpret_cast<const double*>(base + header->norms_offset);
+    }
+
+    // Embedding de la fila `i` convertido a double
+    Point embedding(int i) const {
+        int dims = getDimensions();
+        size_t offset = static_cast<size_t>(i) * header->stride;
+        if (getElementType() == ElementType::Float64) {
+            return Eigen::Map<const Eigen::VectorXd>(static_cast<const double*>(rows()) + offset, dims);
+        }
+        return Eigen::Map<const Eigen::VectorXf>(static_cast<const float*>(rows()) + offset, dims).cast<double>();
+    }
+
+    // Coordenada `axis` de la fila `i`
+    double coordinate(int i, int axis) const {
+        size_t offset = static_cast<size_t>(i) * header->stride + axis;
+        if (getElementType() == ElementType::Float64) {
+            return static_cast<const double*>(rows())[offset];
+        }
+        return static_cast<const float*>(rows())[offset];
+    }
+
+    const char* textData(int i) const {
+        return base + header->text_blob_offset + textOffsets()[i];
+    }
+
+    size_t textLength(int i) const {
+        return textOffsets()[i + 1] - textOffsets()[i];
+    }
+
+    std::string text(int i) const {
+        return std::string(textData(i), textLength(i));
+    }
+
+    // Sección opcional del árbol serializado (nullptr si no hay)
+    const char* treeSection(size_t& bytes) const {
+        bytes = header ? header->tree_bytes : 0;
+        return bytes > 0 ? base + header->tree_offset : nullptr;
+    }
+
+    // Copia de la base como DataItem, para los caminos que necesitan vectores propios
+    std::vector<DataItem> toDataItems() const {
+        std::vector<DataItem> database(size());
+        for (int i = 0; i < size(); i++) {
+            database[i].text = text(i);
+            database[i].embedding = embedding(i);
+        }
+        return database;
+    }
+
+    // Bytes del archivo mapeado (compartidos en la caché de páginas) o del almacén en memoria
+    size_t mappedBytes() const {
+        return length;
+    }
+};
+
+// Textos indexados por id: copia propia o prestados de una base mapeada
+class TextTable {
+private:
+    std::vector<std::string> owned;
+    const MappedDatabase* mapped;
+
+public:
+    TextTable() : mapped(nullptr) {}
+
+    void assign(const std::vector<DataItem>& data) {
+        mapped = nullptr;
+        owned.clear();
+        owned.reserve(data.size());
+        for (const auto& item : data) {
+            owned.push_back(item.text);
+        }
+    }
+
+    // Mover los textos de `data` (quedan vacíos)
+    void take(std::vector<DataItem>& data) {
+        mapped = nullptr;
+        owned.clear();
+        owned.reserve(data.size());
+        for (auto& item : data) {
+            owned.push_back(std::move(item.text));
+        }
+    }
+
+    void view(const MappedDatabase& database) {
+        owned.clear();
+        mapped = &database;
+    }
+
+    std::string operator[](int id) const {
+        return mapped ? mapped->text(id) : owned[id];
+    }
+
+    size_t size() const {
+        return mapped ? mapped->size() : owned.size();
+    }
+
+    // Bytes propios de los textos (prestados = 0)
+    size_t memoryBytes() const {
+        size_t bytes = vectorBytes(owned);
+        for (const auto& text : owned) {
+            bytes += stringBytes(text);
+        }
+        return bytes;
+    }
+};
+
+#endif // MAPPED_DATABASE_H
\ No newline at end of file
@@ -0,0 +1,148 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstddef>
+#include <cstdint>
+#include <malloc.h>
+#include <Eigen/Dense>
+#include "data_item.h"
+
+// Memoria real de los índices: cada estructura cuenta los bloques que pidió al
+// heap (lo utilizable más la cabecera de malloc), no su tamaño lógico, y el
+// proceso se mide con VmRSS/VmHWM de /proc/self/status.
+
+// Cabecera de un bloque de malloc (glibc guarda el tamaño antes de los datos)
+const size_t kMallocHeaderBytes = sizeof(size_t);
+
+// Bytes de un bloque reservado con malloc/new/posix_memalign (nullptr = 0)
+inline size_t heapBlockBytes(const void* ptr) {
+    return ptr ? malloc_usable_size(const_cast<void*>(ptr)) + kMallocHeaderBytes : 0;
+}
+
+// Bytes de un bloque de `request` bytes cuando no se tiene el puntero de malloc
+// (p. ej. Eigen, que puede desplazarlo para alinearlo): trozos de 16 bytes con
+// la cabecera incluida y un mínimo de 32
+inline size_t mallocChunkBytes(size_t request) {
+    if (request == 0) {
+        return 0;
+    }
+    size_t chunk = (request + kMallocHeaderBytes + 15) & ~static_cast<size_t>(15);
+    return chunk < 32 ? 32 : chunk;
+}
+
+template <typename T, typename Allocator>
+inline size_t vectorBytes(const std::vector<T, Allocator>& values) {
+    return values.capacity() > 0 ? heapBlockBytes(values.data()) : 0;
+}
+
+// Heap de un string; los cortos viven dentro del objeto (SSO) y no cuentan
+inline size_t stringBytes(const std::string& text) {
+    static const size_t inline_capacity = std::string().capacity();
+    return text.capacity() > inline_capacity ? heapBlockBytes(text.data()) : 0;
+}
+
+// Heap de un vector de Eigen (con el relleno que agrega su malloc alineado)
+inline size_t eigenBytes(const Point& point) {
+    if (point.size() == 0) {
+        return 0;
+    }
+    size_t request = static_cast<size_t>(point.size()) * sizeof(double);
+#if !EIGEN_MALLOC_ALREADY_ALIGNED
+    request += EIGEN_DEFAULT_ALIGN_BYTES;
+#endif
+    return mallocChunkBytes(request);
+}
+
+// Memoria de un índice por componente, en bytes
+struct MemoryUsage {
+    size_t vectors;   // Filas del índice: cuantizadas, escalas, copia exacta y registros para reconstruir
+    size_t structure; // Nodos, ids, grafo, normas, lápidas y los propios objetos
+    size_t tables;    // Tablas precalculadas para acelerar la búsqueda (términos por lista de IVF-PQ)
+    size_t payload;   // Textos propios (los prestados de una base mapeada no cuentan)
+    size_t scratch;   // Memoria de trabajo de búsqueda del hilo que pregunta
+
+    MemoryUsage() : vectors(0), structure(0), tables(0), payload(0), scratch(0) {}
+
+    size_t total() const {
+        return vectors + structure + tables + payload + scratch;
+    }
+
+    MemoryUsage& operator+=(const MemoryUsage& other) {
+        vectors += other.vectors;
+        structure += other.structure;
+        tables += other.tables;
+        payload += other.payload;
+        scratch += other.scratch;
+        return *this;
+    }
+};
+
+// Registros propios (texto y embedding de cada uno) repartidos en vectores y payload
+inline void addDataItems(const std::vector<DataItem>& items, MemoryUsage& usage) {
+    usage.structure += vectorBytes(items);
+    for (const auto& item : items) {
+        usage.payload += stringBytes(item.text);
+        usage.vectors += eigenBytes(item.embedding);
+    }
+}
+
+// Memoria residente del proceso (VmRSS) y su pico (VmHWM), en bytes
+struct ProcessMemory {
+    size_t rss;
+    size_t peak_rss;
+
+    static ProcessMemory sample() {
+        ProcessMemory memory = {0, 0};
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.compare(0, 6, "VmRSS:") == 0) {
+                memory.rss = std::stoull(line.substr(6)) * 1024;
+            } else if (line.compare(0, 6, "VmHWM:") == 0) {
+                memory.peak_rss = std::stoull(line.substr(6)) * 1024;
+            }
+        }
+        return memory;
+    }
+
+    // Reiniciar el pico a la memoria residente actual, para medir el de una
+    // fase. Devuelve false si el sistema no lo permite (el pico sigue siendo
+    // el de toda la vida del proceso)
+    static bool resetPeak() {
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        clear_refs << "5";
+        clear_refs.close();
+        return !clear_refs.fail();
+    }
+};
+
+// Crecimiento de la memoria residente durante una fase (construir, consultar):
+// begin() reinicia el pico y end() toma el neto y el pico sobre el inicio
+class PhaseMemory {
+private:
+    ProcessMemory start;
+
+public:
+    long long rss_delta;  // Residente al terminar menos residente al empezar
+    long long peak_delta; // Pico de la fase por encima de la residente al empezar
+
+    PhaseMemory() : rss_delta(0), peak_delta(0) {
+        begin();
+    }
+
+    void begin() {
+        ProcessMemory::resetPeak();
+        start = ProcessMemory::sample();
+    }
+
+    void end() {
+        ProcessMemory now = ProcessMemory::sample();
+        rss_delta = static_cast<long long>(now.rss) - static_cast<long long>(start.rss);
+        peak_delta = static_cast<long long>(now.peak_rss) - static_cast<long long>(start.rss);
+    }
+};
+
+#endif // MEMORY_USAGE_H
\ No newline at end of file
@@ -0,0 +1,195 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+#include "topk.h"
+#include "embeddings.h"
+#include "memory_usage.h"
+
+// Caché acotada de resultados de consultas: clave = texto normalizado de la
+// consulta, valor = los k vecinos (distancia e id) que devolvió el índice.
+// Reemplazo CLOCK: cada acierto marca la entrada y el reloj desaloja la primera
+// sin marcar, así las consultas repetidas se quedan sin costo de LRU por acierto.
+//
+// Cada entrada lleva la versión del índice que la respondió: solo se usa con
+// esa misma versión, e invalidate() descarta las anteriores a la vigente
+// (también las que se guarden después desde consultas que empezaron antes).
+// Seguro entre hilos con un candado propio.
+class QueryCache {
+private:
+    struct Entry {
+        std::string key;
+        long long generation;
+        int k;                           // k pedido al índice
+        std::vector<Neighbor> neighbors; // Menos de k si la base no tenía más
+        bool referenced;
+    };
+
+    size_t capacity;
+    std::vector<Entry> slots;
+    std::unordered_map<std::string, size_t> positions;
+    size_t hand;
+    long long min_generation;
+    long long hits;
+    long long misses;
+    mutable std::mutex mutex;
+
+    void erase(size_t slot) {
+        positions.erase(slots[slot].key);
+        if (slot + 1 != slots.size()) {
+            slots[slot] = std::move(slots.back());
+            positions[slots[slot].key] = slot;
+        }
+        slots.pop_back();
+        if (hand >= slots.size()) {
+            hand = 0;
+        }
+    }
+
+    // Hueco para una entrada nueva: uno libre o el que desaloja el reloj
+    size_t victim() {
+        if (slots.size() < capacity) {
+            slots.push_back(Entry());
+            return slots.size() - 1;
+        }
+        while (slots[hand].referenced) {
+            slots[hand].referenced = false;
+            hand = (hand + 1) % slots.size();
+        }
+        size_t slot = hand;
+        positions.erase(slots[slot].key);
+        hand = (hand + 1) % slots.size();
+        return slot;
+    }
+
+public:
+    explicit QueryCache(size_t capacity = 1024)
+        : capacity(capacity), hand(0), min_generation(0), hits(0), misses(0) {}
+
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+
+    // Clave de `text`: sus tokens como los ve el embedder (minúsculas, solo
+    // alfanuméricos, separados por un espacio), así dos consultas con la misma
+    // clave tienen el mismo embedding. El texto sin tokens se usa tal cual
+    static std::string normalize(const std::string& text) {
+        std::string key;
+        DeterministicEmbedder::forEachToken(text.data(), text.size(), [&key](const TokenView& token) {
+            if (!key.empty()) {
+                key.push_back(' ');
+            }
+            for (size_t i = 0; i < token.length; i++) {
+                unsigned char c = static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(token.data[i])));
+                if (std::isalnum(c)) {
+                    key.push_back(static_cast<char>(c));
+                }
+            }
+        });
+        if (key.empty()) {
+            key = '\0' + text;
+        }
+        return key;
+    }
+
+    // Los k primeros vecinos guardados para `key` con la versión `generation`;
+    // sirve una entrada guardada con un k mayor o igual
+    bool lookup(const std::string& key, int k, long long generation, std::vector<Neighbor>& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = positions.find(key);
+        if (it != positions.end()) {
+            Entry& entry = slots[it->second];
+            bool complete = static_cast<int>(entry.neighbors.size()) < entry.k;
+            if (entry.generation == generation && (entry.k >= k || complete)) {
+                entry.referenced = true;
+                size_t count = std::min(entry.neighbors.size(), static_cast<size_t>(std::max(0, k)));
+                out.assign(entry.neighbors.begin(), entry.neighbors.begin() + count);
+                hits++;
+                return true;
+            }
+        }
+        misses++;
+        return false;
+    }
+
+    // Guardar el resultado de `key` calculado con la versión `generation` del
+    // índice; se descarta si esa versión ya fue invalidada
+    void store(const std::string& key, int k, long long generation, const std::vector<Neighbor>& neighbors) {
+        if (capacity == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (generation < min_generation) {
+            return;
+        }
+        auto it = positions.find(key);
+        size_t slot;
+        if (it != positions.end()) {
+            slot = it->second;
+        } else {
+            slot = victim();
+            positions[key] = slot;
+        }
+        Entry& entry = slots[slot];
+        entry.key = key;
+        entry.generation = generation;
+        entry.k = k;
+        entry.neighbors = neighbors;
+        entry.referenced = false;
+    }
+
+    // El índice pasó a la versión `generation`: descartar las entradas anteriores
+    void invalidate(long long generation) {
+        std::lock_guard<std::mutex> lock(mutex);
+        min_generation = std::max(min_generation, generation);
+        for (size_t slot = slots.size(); slot-- > 0;) {
+            if (slots[slot].generation < min_generation) {
+                erase(slot);
+            }
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        slots.clear();
+        positions.clear();
+        hand = 0;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return slots.size();
+    }
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+    long long getHits() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hits;
+    }
+
+    long long getMisses() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return misses;
+    }
+
+    // Entradas (claves y vecinos) y la tabla de posiciones
+    MemoryUsage memoryUsage() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        MemoryUsage usage;
+        usage.structure += sizeof(*this) + vectorBytes(slots) + positions.bucket_count() * sizeof(void*) +
+                           positions.size() * (sizeof(std::pair<const std::string, size_t>) + 2 * sizeof(void*));
+        for (const auto& entry : slots) {
+            usage.structure += vectorBytes(entry.neighbors) + 2 * stringBytes(entry.key);
+        }
+        return usage;
+    }
+};
+
+#endif // QUERY_CACHE_H
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef RAG_H
+#define RAG_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <future>
+#include <chrono>
+#include "search_service.h"
+#include "llm_client.h"
+
+// Parámetros de la respuesta aumentada con recuperación
+struct RagOptions {
+    int k;                    // Documentos recuperados por pregunta
+    int max_tokens;           // Tokens a generar
+    size_t max_context_chars; // Caracteres de cada documento que van al prompt
+
+    RagOptions() : k(3), max_tokens(100), max_context_chars(600) {}
+};
+
+// Respuesta a una pregunta, con los tiempos de cada etapa en milisegundos
+struct RagAnswer {
+    std::string question;
+    std::vector<std::string> contexts;
+    LLMResponse llm;
+    double retrieval_ms; // Desde ask() hasta tener los documentos
+    double total_ms;     // Desde ask() hasta el último token
+
+    RagAnswer() : retrieval_ms(0), total_ms(0) {}
+};
+
+// Recuperación y generación encadenadas sin bloquear: ask() encola la
+// pregunta en el SearchService y, cuando un trabajador tiene los documentos,
+// el prompt pasa al LLMClient desde ese mismo callback. Así los trabajadores
+// siguen recuperando las preguntas siguientes mientras el servidor genera, y
+// ningún hilo queda esperando una respuesta HTTP.
+class RagPipeline {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    SearchService& search;
+    LLMClient& llm;
+    RagOptions options;
+
+    static double millis(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+public:
+    RagPipeline(SearchService& search, LLMClient& llm, const RagOptions& options = RagOptions())
+        : search(search), llm(llm), options(options) {}
+
+    static std::string buildPrompt(const std::string& question, const std::vector<std::string>& contexts,
+                                   size_t max_context_chars) {
+        std::string prompt = "Responde la pregunta usando los documentos.\n\n";
+        for (size_t i = 0; i < contexts.size(); i++) {
+            prompt += "Documento " + std::to_string(i + 1) + ": " + contexts[i].substr(0, max_context_chars) + "\n";
+        }
+        prompt += "\nPregunta: " + question + "\nRespuesta:";
+        return prompt;
+    }
+
+    std::future<RagAnswer> ask(const std::string& question) {
+        struct State {
+            std::promise<RagAnswer> promise;
+            RagAnswer answer;
+            Clock::time_point start;
+        };
+        std::shared_ptr<State> state = std::make_shared<State>();
+        state->answer.question = question;
+        state->start = Clock::now();
+        std::future<RagAnswer> future = state->promise.get_future();
+
+        LLMClient& llm = this->llm;
+        RagOptions options = this->options;
+        search.submit(question, options.k, [state, &llm, options](SearchResponse&& response) {
+            state->answer.retrieval_ms = millis(state->start, Clock::now());
+            state->answer.contexts = std::move(response.texts);
+            if (response.generation < 0) {
+                state->answer.llm.error = "El servicio de búsqueda está detenido";
+                state->promise.set_value(std::move(state->answer));
+                return;
+            }
+            std::string prompt = buildPrompt(state->answer.question, state->answer.contexts,
+                                             options.max_context_chars);
+            llm.submit(prompt, options.max_tokens, LLMClient::TokenCallback(), [state](LLMResponse&& generated) {
+                state->answer.llm = std::move(generated);
+                state->answer.total_ms = millis(state->start, Clock::now());
+                state->promise.set_value(std::move(state->answer));
+            });
+        });
+        return future;
+    }
+
+    const RagOptions& getOptions() const {
+        return options;
+    }
+};
+
+#endif // RAG_H
\ No newline at end of file
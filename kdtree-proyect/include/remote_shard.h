@@ -0,0 +1,118 @@
+#ifndef REMOTE_SHARD_H
+#define REMOTE_SHARD_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include "http_client.h"
+#include "shard.h"
+
+// Shard servido por otro proceso o máquina (ShardServer) en `url`, p. ej.
+// "http://10.0.0.2:7001". Los shards de un coordinador comparten un
+// HttpClient: un solo hilo para todas las solicitudes y conexiones
+// persistentes con cada servidor.
+class RemoteShard : public Shard {
+private:
+    std::shared_ptr<HttpClient> http;
+    std::string url;
+    int count;
+    int dims;
+
+    RemoteShard(const std::shared_ptr<HttpClient>& http, const std::string& url, int count, int dims)
+        : http(http), url(url), count(count), dims(dims) {}
+
+public:
+    // Conectar y leer el tamaño del shard; nullptr si no responde
+    static std::unique_ptr<RemoteShard> connect(const std::shared_ptr<HttpClient>& http, const std::string& url) {
+        HttpResponse response = http->getAndWait(url + "/info");
+        size_t offset = 0;
+        int32_t info[2] = {0, 0};
+        if (!response.ok() || !readBinary(response.body, offset, info[0]) || !readBinary(response.body, offset, info[1])) {
+            std::cerr << "Error: el shard " << url << " no responde"
+                      << (response.error.empty() ? "" : " (" + response.error + ")") << std::endl;
+            return std::unique_ptr<RemoteShard>();
+        }
+        return std::unique_ptr<RemoteShard>(new RemoteShard(http, url, info[0], info[1]));
+    }
+
+    std::string name() const override {
+        return url;
+    }
+
+    bool isRemote() const override {
+        return true;
+    }
+
+    std::future<ShardReply> submit(const Point& query, int k, const SearchParams& params,
+                                   int timeout_ms) const override {
+        std::shared_ptr<std::promise<ShardReply>> promise = std::make_shared<std::promise<ShardReply>>();
+        std::future<ShardReply> future = promise->get_future();
+        http->post(url + "/knn", encodeShardQuery(query, k, params), [promise](HttpResponse&& response) {
+            ShardReply reply;
+            reply.ok = response.ok() && decodeShardNeighbors(response.body, reply.neighbors);
+            promise->set_value(std::move(reply));
+        }, HttpClient::DataCallback(), timeout_ms > 0 ? timeout_ms : -1);
+        return future;
+    }
+
+    ShardReply kNearest(const Point& query, int k, const SearchParams& params) const override {
+        return submit(query, k, params, 0).get();
+    }
+
+    // Texto de un id local (vacío si el shard no responde o vence `timeout_ms`)
+    std::string text(int local_id, int timeout_ms) const override {
+        std::string body;
+        appendBinary(body, static_cast<int32_t>(local_id));
+        HttpResponse response = http->postAndWait(url + "/text", body, timeout_ms > 0 ? timeout_ms : -1);
+        return response.ok() ? response.body : std::string();
+    }
+
+    int size() const override {
+        return count;
+    }
+
+    int getDimensions() const {
+        return dims;
+    }
+};
+
+// Coordinador sobre shards remotos: el reparto de `map_file` (ver
+// writeShardFiles) y la URL de cada shard, en el orden del reparto. nullptr
+// si el reparto no se puede leer o algún shard no responde o no coincide
+inline std::unique_ptr<ShardedIndex> connectShards(const std::string& map_file, const std::vector<std::string>& urls,
+                                                   const ShardOptions& options) {
+    ShardMap map;
+    if (!map.load(map_file)) {
+        std::cerr << "Error: no se pudo leer el reparto " << map_file << std::endl;
+        return std::unique_ptr<ShardedIndex>();
+    }
+    if (static_cast<int>(urls.size()) != map.shardCount()) {
+        std::cerr << "Error: el reparto tiene " << map.shardCount() << " shards y se dieron " << urls.size()
+                  << " URLs" << std::endl;
+        return std::unique_ptr<ShardedIndex>();
+    }
+
+    HttpClientOptions http_options;
+    http_options.headers.push_back("Content-Type: application/octet-stream");
+    std::shared_ptr<HttpClient> http = std::make_shared<HttpClient>(http_options);
+    std::vector<std::unique_ptr<Shard>> shards;
+    for (int s = 0; s < map.shardCount(); s++) {
+        std::unique_ptr<RemoteShard> shard = RemoteShard::connect(http, urls[s]);
+        if (!shard) {
+            return std::unique_ptr<ShardedIndex>();
+        }
+        if (shard->size() != static_cast<int>(map.shardMembers(s).size()) || shard->getDimensions() != map.getDimensions()) {
+            std::cerr << "Error: " << urls[s] << " no sirve el shard " << s << " del reparto (" << shard->size()
+                      << " documentos, se esperaban " << map.shardMembers(s).size() << ")" << std::endl;
+            return std::unique_ptr<ShardedIndex>();
+        }
+        shards.push_back(std::move(shard));
+    }
+    ShardOptions remote_options = options;
+    remote_options.routing = map.getRouting();
+    return std::unique_ptr<ShardedIndex>(new ShardedIndex(remote_options, map, std::move(shards)));
+}
+
+#endif // REMOTE_SHARD_H
\ No newline at end of file
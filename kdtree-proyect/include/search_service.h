@@ -0,0 +1,221 @@
+#ifndef SEARCH_SERVICE_H
+#define SEARCH_SERVICE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <utility>
+#include <functional>
+#include "index.h"
+#include "embeddings.h"
+#include "thread_pool.h"
+#include "query_cache.h"
+
+// Índice publicado por el servicio junto con su número de versión
+struct IndexSnapshot {
+    std::shared_ptr<const Index> index;
+    long long generation;
+};
+
+// Respuesta a una consulta: los vecinos, sus textos (resueltos con el mismo
+// índice que respondió) y la versión del índice
+struct SearchResponse {
+    std::vector<Neighbor> neighbors;
+    std::vector<std::string> texts;
+    long long generation; // -1 si el servicio ya estaba detenido
+    double embed_us;
+    double search_us;
+    bool cached; // Respondida desde la caché de consultas (sin embedding ni búsqueda)
+
+    SearchResponse() : generation(-1), embed_us(0), search_us(0), cached(false) {}
+};
+
+// Servicio de consultas concurrente: `threads` trabajadores toman las
+// consultas de una cola acotada, las embeben y las responden contra el índice
+// publicado. Publicar un índice nuevo (reconstruido o actualizado) es un
+// intercambio atómico del puntero, al estilo RCU: cada consulta toma una
+// referencia al índice vigente al empezar y la suelta al terminar, así las que
+// están en curso siguen con el anterior, las nuevas ven el nuevo y el índice
+// viejo se libera cuando termina la última consulta que lo usa. Leer no toma
+// candados: solo la cola de entrada los usa.
+//
+// Con `cache_entries` > 0 las respuestas se guardan en una QueryCache por
+// texto normalizado y versión del índice; publicar invalida las anteriores.
+//
+// Los índices deben admitir consultas concurrentes (todos los motores lo hacen)
+// y, si son vistas de una MappedDatabase, la base debe vivir más que el servicio.
+class SearchService {
+private:
+    // Consulta encolada; el trabajador cumple la promesa o, si hay, llama a `done`
+    struct Request {
+        std::string query;
+        int k;
+        std::promise<SearchResponse> response;
+        std::function<void(SearchResponse&&)> done;
+
+        void answer(SearchResponse&& result) {
+            if (done) {
+                done(std::move(result));
+            } else {
+                response.set_value(std::move(result));
+            }
+        }
+    };
+
+    DeterministicEmbedder& embedder;
+    SearchParams params;
+    std::shared_ptr<const IndexSnapshot> current; // Se lee y se reemplaza con atomic_load/atomic_store
+    std::atomic<long long> generations;
+    std::atomic<long long> answered;
+    BoundedQueue<std::shared_ptr<Request>> requests;
+    std::vector<std::thread> workers;
+    std::unique_ptr<QueryCache> cache;
+
+    void workerLoop() {
+        Point embedding;
+        std::shared_ptr<Request> request;
+        while (requests.pop(request)) {
+            request->answer(search(request->query, request->k, embedding));
+            request.reset();
+        }
+    }
+
+    SearchResponse search(const std::string& query, int k, Point& embedding) {
+        SearchResponse response;
+        std::shared_ptr<const IndexSnapshot> snapshot = this->snapshot();
+        if (!snapshot || !snapshot->index) {
+            return response;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::string key;
+        if (cache) {
+            key = QueryCache::normalize(query);
+            response.cached = cache->lookup(key, k, snapshot->generation, response.neighbors);
+        }
+        auto embedded = start;
+        if (!response.cached) {
+            embedder.getEmbedding(query, embedding);
+            embedded = std::chrono::high_resolution_clock::now();
+            response.neighbors = snapshot->index->kNearest(embedding, k, params);
+            if (cache) {
+                cache->store(key, k, snapshot->generation, response.neighbors);
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        for (const auto& neighbor : response.neighbors) {
+            response.texts.push_back(snapshot->index->text(neighbor.second));
+        }
+        response.generation = snapshot->generation;
+        response.embed_us = std::chrono::duration<double, std::micro>(embedded - start).count();
+        response.search_us = std::chrono::duration<double, std::micro>(end - embedded).count();
+        answered++;
+        return response;
+    }
+
+public:
+    // `queue_size` consultas esperando como máximo (0 = cuatro por trabajador);
+    // con la cola llena submit() bloquea. `cache_entries` respuestas en caché (0 = sin caché)
+    SearchService(DeterministicEmbedder& embedder, std::shared_ptr<const Index> index, int threads = 0,
+                  const SearchParams& params = SearchParams(), size_t queue_size = 0, size_t cache_entries = 0)
+        : embedder(embedder), params(params), generations(0), answered(0),
+          requests(queue_size > 0 ? queue_size
+                                  : 4 * static_cast<size_t>(threads > 0 ? threads : ThreadPool::hardwareThreads())) {
+        if (cache_entries > 0) {
+            cache.reset(new QueryCache(cache_entries));
+        }
+        publish(std::move(index));
+        if (threads <= 0) {
+            threads = ThreadPool::hardwareThreads();
+        }
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(std::thread(&SearchService::workerLoop, this));
+        }
+    }
+
+    ~SearchService() {
+        stop();
+    }
+
+    SearchService(const SearchService&) = delete;
+    SearchService& operator=(const SearchService&) = delete;
+
+    // Publicar un índice nuevo; devuelve su versión
+    long long publish(std::shared_ptr<const Index> index) {
+        std::shared_ptr<IndexSnapshot> next = std::make_shared<IndexSnapshot>();
+        next->index = std::move(index);
+        next->generation = ++generations;
+        std::atomic_store(&current, std::shared_ptr<const IndexSnapshot>(next));
+        if (cache) {
+            cache->invalidate(next->generation);
+        }
+        return next->generation;
+    }
+
+    // Índice vigente (una referencia lo mantiene vivo aunque se publique otro)
+    std::shared_ptr<const IndexSnapshot> snapshot() const {
+        return std::atomic_load(&current);
+    }
+
+    // Encolar una consulta para los trabajadores
+    std::future<SearchResponse> submit(const std::string& query, int k) {
+        std::shared_ptr<Request> request = std::make_shared<Request>();
+        request->query = query;
+        request->k = k;
+        std::future<SearchResponse> future = request->response.get_future();
+        if (!requests.push(request)) {
+            request->response.set_value(SearchResponse());
+        }
+        return future;
+    }
+
+    // Encolar una consulta y recibir la respuesta en `done`, llamado desde el
+    // trabajador que la resolvió (o aquí mismo si el servicio ya se detuvo).
+    // Sirve para encadenar otra etapa sin bloquear un hilo esperando el future
+    void submit(const std::string& query, int k, const std::function<void(SearchResponse&&)>& done) {
+        std::shared_ptr<Request> request = std::make_shared<Request>();
+        request->query = query;
+        request->k = k;
+        request->done = done;
+        if (!requests.push(request)) {
+            request->answer(SearchResponse());
+        }
+    }
+
+    // Responder en el hilo que llama, sin pasar por la cola
+    SearchResponse search(const std::string& query, int k) {
+        Point embedding;
+        return search(query, k, embedding);
+    }
+
+    // Dejar de aceptar consultas, responder las encoladas y esperar a los trabajadores
+    void stop() {
+        requests.close();
+        for (auto& worker : workers) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+        workers.clear();
+    }
+
+    int getThreadCount() const {
+        return static_cast<int>(workers.size());
+    }
+
+    long long getAnswered() const {
+        return answered;
+    }
+
+    // Caché de consultas (nullptr si se creó sin caché)
+    const QueryCache* getCache() const {
+        return cache.get();
+    }
+};
+
+#endif // SEARCH_SERVICE_H
\ No newline at end of file
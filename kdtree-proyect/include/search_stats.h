@@ -0,0 +1,114 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+#include <cstdint>
+#include <algorithm>
+
+// Contadores del camino caliente de las búsquedas, para saber en qué se va el
+// tiempo (y si un cambio mejora de verdad o es ruido). Solo cuentan si se
+// compila con -DKDTREE_STATS (make STATS=1); sin la macro los métodos de
+// SearchCounters están vacíos, el compilador los elimina y las búsquedas son
+// exactamente las de siempre. Los contadores son por hilo: las búsquedas (y las
+// construcciones que buscan, como la de HNSW) acumulan en los del hilo que las
+// ejecuta, así que se reinician antes del tramo a medir.
+struct SearchStats {
+    uint64_t queries;           // Búsquedas (un bosque cuenta una; cada segmento del índice dinámico, una)
+    uint64_t nodes_visited;     // Nodos descendidos, hojas incluidas; en HNSW, nodos expandidos
+    uint64_t distance_evals;    // Distancias calculadas, incluido el re-rank exacto
+    uint64_t branches_explored; // Ramas pendientes retomadas; en HNSW, vecinos que entran a la lista
+    uint64_t branches_pruned;   // Ramas descartadas por su cota; en HNSW, vecinos que no mejoran
+    uint64_t leaf_scans;        // Buckets de hoja recorridos
+    uint64_t leaf_depth_sum;    // Suma de las profundidades de esas hojas
+    uint64_t max_depth;         // Hoja más profunda alcanzada
+
+    SearchStats() {
+        reset();
+    }
+
+    void reset() {
+        queries = nodes_visited = distance_evals = branches_explored = branches_pruned = 0;
+        leaf_scans = leaf_depth_sum = max_depth = 0;
+    }
+
+    SearchStats& operator+=(const SearchStats& other) {
+        queries += other.queries;
+        nodes_visited += other.nodes_visited;
+        distance_evals += other.distance_evals;
+        branches_explored += other.branches_explored;
+        branches_pruned += other.branches_pruned;
+        leaf_scans += other.leaf_scans;
+        leaf_depth_sum += other.leaf_depth_sum;
+        max_depth = std::max(max_depth, other.max_depth);
+        return *this;
+    }
+
+    // Promedio por búsqueda de un contador
+    double perQuery(uint64_t value) const {
+        return queries > 0 ? static_cast<double>(value) / queries : 0.0;
+    }
+
+    double meanLeafDepth() const {
+        return leaf_scans > 0 ? static_cast<double>(leaf_depth_sum) / leaf_scans : 0.0;
+    }
+};
+
+// Contadores acumulados del hilo que llama
+inline SearchStats& threadSearchStats() {
+    static thread_local SearchStats stats;
+    return stats;
+}
+
+#ifdef KDTREE_STATS
+
+const bool kSearchStatsEnabled = true;
+
+// Código que solo existe con los contadores (p. ej. la profundidad de una rama)
+#define KDTREE_STATS_ONLY(...) __VA_ARGS__
+
+struct SearchCounters {
+    static void query() {
+        threadSearchStats().queries++;
+    }
+
+    static void node() {
+        threadSearchStats().nodes_visited++;
+    }
+
+    static void distance(uint64_t count = 1) {
+        threadSearchStats().distance_evals += count;
+    }
+
+    static void explored() {
+        threadSearchStats().branches_explored++;
+    }
+
+    static void pruned() {
+        threadSearchStats().branches_pruned++;
+    }
+
+    static void leaf(int depth) {
+        SearchStats& stats = threadSearchStats();
+        stats.leaf_scans++;
+        stats.leaf_depth_sum += depth;
+        stats.max_depth = std::max(stats.max_depth, static_cast<uint64_t>(depth));
+    }
+};
+
+#else
+
+const bool kSearchStatsEnabled = false;
+
+#define KDTREE_STATS_ONLY(...)
+
+struct SearchCounters {
+    static void query() {}
+    static void node() {}
+    static void distance(uint64_t = 1) {}
+    static void explored() {}
+    static void pruned() {}
+    static void leaf(int = 0) {}
+};
+
+#endif // KDTREE_STATS
+
+#endif // SEARCH_STATS_H
\ No newline at end of file
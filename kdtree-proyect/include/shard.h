@@ -0,0 +1,641 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include "index.h"
+#include "ivfpq.h"
+#include "mapped_database.h"
+#include "thread_pool.h"
+#include "topk.h"
+
+// Cómo se reparten los documentos entre los shards: por hash del id (shards
+// parejos, cada consulta los recorre todos) o por el centroide k-means más
+// cercano (documentos parecidos juntos: una consulta puede revisar solo los
+// shards de los centroides más cercanos)
+enum class ShardRouting {
+    Hash,
+    KMeans
+};
+
+inline std::string shardRoutingName(ShardRouting routing) {
+    return routing == ShardRouting::KMeans ? "kmeans" : "hash";
+}
+
+// Convierte "hash" / "kmeans"; devuelve false si el nombre no es válido
+inline bool parseShardRouting(const std::string& name, ShardRouting& routing) {
+    if (name == "hash") {
+        routing = ShardRouting::Hash;
+    } else if (name == "kmeans") {
+        routing = ShardRouting::KMeans;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Parámetros del reparto y de la búsqueda distribuida
+struct ShardOptions {
+    int shards;            // Particiones
+    ShardRouting routing;
+    int probe;             // Shards a consultar con k-means, los de centroide más cercano (0 = todos)
+    int timeout_ms;        // Espera por shard remoto (0 = sin límite); los que no llegan se omiten del resultado
+    std::string engine;    // Motor de cada shard local
+    int iterations;        // Iteraciones del k-means del reparto
+    int train_size;        // Vectores de la muestra del k-means (0 = 256 por shard)
+    unsigned seed;
+
+    ShardOptions() : shards(4), routing(ShardRouting::Hash), probe(0), timeout_ms(0), engine("kdtree"),
+                     iterations(10), train_size(0), seed(42) {}
+};
+
+// Identificador del archivo del reparto
+const char kShardMapMagic[8] = {'K', 'D', 'S', 'H', 'A', 'R', 'D', 'S'};
+
+// Reparto de una base entre shards: el shard y el id local de cada documento
+// (id global = fila de la base original), los ids globales de cada shard en
+// su orden local y, con k-means, los centroides que enrutan las consultas.
+// Se guarda junto a los archivos de los shards para que el coordinador
+// traduzca los ids que devuelven.
+class ShardMap {
+private:
+    ShardRouting routing;
+    int dims;
+    std::vector<int> owner;                // Shard de cada id global
+    std::vector<int> local;                // Id dentro de su shard
+    std::vector<std::vector<int>> members; // Ids globales de cada shard
+    std::vector<float> centroids;          // Por componente (ver centroidDistances); vacío con hash
+
+    static uint64_t mixId(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    void finish(int shards) {
+        members.assign(shards, std::vector<int>());
+        local.assign(owner.size(), 0);
+        for (size_t id = 0; id < owner.size(); id++) {
+            local[id] = static_cast<int>(members[owner[id]].size());
+            members[owner[id]].push_back(static_cast<int>(id));
+        }
+    }
+
+public:
+    ShardMap() : routing(ShardRouting::Hash), dims(0) {}
+
+    // Repartir las filas de `rows` (ItemRows o DatabaseRows, ver kdtree.h)
+    template <typename Rows>
+    static ShardMap assign(const Rows& rows, const ShardOptions& options, int threads = 0) {
+        ShardMap map;
+        int count = rows.size();
+        int shards = std::max(1, std::min(options.shards, std::max(1, count)));
+        map.routing = options.routing;
+        map.dims = rows.dimensions();
+        map.owner.assign(count, 0);
+        if (threads <= 0) {
+            threads = ThreadPool::hardwareThreads();
+        }
+
+        if (options.routing == ShardRouting::Hash || shards == 1) {
+            for (int i = 0; i < count; i++) {
+                map.owner[i] = static_cast<int>(mixId(static_cast<uint64_t>(rows.id(i)) ^ options.seed) % shards);
+            }
+        } else {
+            // k-means sobre una muestra sin reemplazo y el centroide más cercano para cada fila
+            std::mt19937 rng(options.seed);
+            int train = options.train_size > 0 ? options.train_size : 256 * shards;
+            train = std::max(shards, std::min(train, count));
+            std::vector<int> sample(count);
+            std::iota(sample.begin(), sample.end(), 0);
+            for (int s = 0; s < train; s++) {
+                std::uniform_int_distribution<int> pick(s, count - 1);
+                std::swap(sample[s], sample[pick(rng)]);
+            }
+            std::vector<float> train_rows(static_cast<size_t>(train) * map.dims);
+            for (int s = 0; s < train; s++) {
+                Point point = rows.point(sample[s]);
+                for (int d = 0; d < map.dims; d++) {
+                    train_rows[static_cast<size_t>(s) * map.dims + d] = static_cast<float>(point(d));
+                }
+            }
+            map.centroids = trainKMeans(train_rows.data(), train, map.dims, shards, std::max(1, options.iterations),
+                                        rng, threads);
+            map.members.resize(shards);
+            ThreadPool::global().parallelFor(count, threads, [&](int i) {
+                map.owner[i] = map.nearestShards(rows.point(i), 1)[0];
+            });
+        }
+        map.finish(shards);
+        return map;
+    }
+
+    // Shards a consultar para `query`, del más al menos prometedor: con k-means
+    // los `probe` de centroide más cercano (0 = todos), con hash todos
+    std::vector<int> nearestShards(const Point& query, int probe) const {
+        int shards = shardCount();
+        if (probe <= 0 || probe > shards) {
+            probe = shards;
+        }
+        std::vector<int> order(shards);
+        std::iota(order.begin(), order.end(), 0);
+        if (centroids.empty() || probe == shards) {
+            return order;
+        }
+        std::vector<float> x(dims);
+        for (int d = 0; d < dims; d++) {
+            x[d] = static_cast<float>(query(d));
+        }
+        std::vector<float> dist(shards);
+        centroidDistances(x.data(), centroids.data(), dims, shards, dist.data());
+        std::partial_sort(order.begin(), order.begin() + probe, order.end(),
+                          [&dist](int a, int b) { return dist[a] < dist[b]; });
+        order.resize(probe);
+        return order;
+    }
+
+    int shardCount() const {
+        return static_cast<int>(members.size());
+    }
+
+    int size() const {
+        return static_cast<int>(owner.size());
+    }
+
+    int getDimensions() const {
+        return dims;
+    }
+
+    ShardRouting getRouting() const {
+        return routing;
+    }
+
+    int ownerOf(int id) const {
+        return owner[id];
+    }
+
+    int localId(int id) const {
+        return local[id];
+    }
+
+    int globalId(int shard, int local_id) const {
+        return members[shard][local_id];
+    }
+
+    const std::vector<int>& shardMembers(int shard) const {
+        return members[shard];
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = sizeof(*this) + vectorBytes(owner) + vectorBytes(local) + vectorBytes(members) +
+                       vectorBytes(centroids);
+        for (const auto& ids : members) {
+            bytes += vectorBytes(ids);
+        }
+        return bytes;
+    }
+
+    bool save(const std::string& filename) const {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        int32_t header[4] = {static_cast<int32_t>(routing), dims, static_cast<int32_t>(members.size()),
+                             static_cast<int32_t>(owner.size())};
+        file.write(kShardMapMagic, sizeof(kShardMapMagic));
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(owner.data()), owner.size() * sizeof(int32_t));
+        file.write(reinterpret_cast<const char*>(centroids.data()), centroids.size() * sizeof(float));
+        return static_cast<bool>(file);
+    }
+
+    bool load(const std::string& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        char magic[sizeof(kShardMapMagic)];
+        int32_t header[4] = {0, 0, 0, 0};
+        if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, kShardMapMagic, sizeof(magic)) != 0 ||
+            !file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[1] < 0 || header[2] <= 0 ||
+            header[3] < 0) {
+            return false;
+        }
+        std::vector<int> stored(header[3]);
+        std::vector<float> stored_centroids;
+        if (header[0] == static_cast<int32_t>(ShardRouting::KMeans) && header[2] > 1) {
+            stored_centroids.resize(static_cast<size_t>(header[1]) * header[2]);
+        }
+        if (!file.read(reinterpret_cast<char*>(stored.data()), stored.size() * sizeof(int32_t)) ||
+            !file.read(reinterpret_cast<char*>(stored_centroids.data()), stored_centroids.size() * sizeof(float))) {
+            return false;
+        }
+        for (int shard : stored) {
+            if (shard < 0 || shard >= header[2]) {
+                return false;
+            }
+        }
+        routing = static_cast<ShardRouting>(header[0]);
+        dims = header[1];
+        owner.swap(stored);
+        centroids.swap(stored_centroids);
+        finish(header[2]);
+        return true;
+    }
+};
+
+// Archivo del shard `shard` del reparto `prefix` y el del propio reparto
+inline std::string shardFileName(const std::string& prefix, int shard) {
+    return prefix + ".shard" + std::to_string(shard) + ".kdv";
+}
+
+inline std::string shardMapFileName(const std::string& prefix) {
+    return prefix + ".shards";
+}
+
+// Escribir cada shard de `database` en el formato mapeable (mismo tipo de
+// fila que la base, ver shardFileName) y el reparto en shardMapFileName; cada
+// archivo se sirve después en su propio proceso o máquina (ShardServer)
+inline bool writeShardFiles(const MappedDatabase& database, const ShardMap& map, const std::string& prefix) {
+    std::vector<std::unique_ptr<DatabaseFileWriter>> writers;
+    for (int s = 0; s < map.shardCount(); s++) {
+        writers.push_back(std::unique_ptr<DatabaseFileWriter>(new DatabaseFileWriter()));
+        if (!writers.back()->open(shardFileName(prefix, s), database.getElementType(), database.getDimensions(),
+                                  static_cast<int64_t>(map.shardMembers(s).size()))) {
+            return false;
+        }
+    }
+    for (int id = 0; id < database.size(); id++) {
+        if (!writers[map.ownerOf(id)]->append(database.text(id), database.embedding(id))) {
+            return false;
+        }
+    }
+    for (auto& writer : writers) {
+        if (!writer->finish(0)) {
+            return false;
+        }
+    }
+    return map.save(shardMapFileName(prefix));
+}
+
+// Respuesta de un shard, con ids locales
+struct ShardReply {
+    std::vector<Neighbor> neighbors;
+    bool ok; // false si el shard falló o no contestó a tiempo
+
+    ShardReply() : ok(false) {}
+};
+
+// Un shard del índice distribuido: local (en este proceso) o remoto
+class Shard {
+public:
+    virtual ~Shard() {}
+
+    virtual std::string name() const = 0;
+
+    // Búsqueda bloqueante en el hilo que llama
+    virtual ShardReply kNearest(const Point& query, int k, const SearchParams& params) const = 0;
+
+    // Los remotos se consultan con submit() sin bloquear; los locales, con
+    // kNearest() repartidos en el pool
+    virtual bool isRemote() const {
+        return false;
+    }
+
+    // Lanzar la búsqueda; `timeout_ms` > 0 corta la solicitud si tarda más
+    virtual std::future<ShardReply> submit(const Point& query, int k, const SearchParams& params,
+                                           int timeout_ms) const {
+        (void)timeout_ms;
+        std::promise<ShardReply> promise;
+        promise.set_value(kNearest(query, k, params));
+        return promise.get_future();
+    }
+
+    // Texto de un id local; `timeout_ms` > 0 limita la espera de un remoto
+    // (vacío si vence, así un shard lento no frena la respuesta)
+    virtual std::string text(int local_id, int timeout_ms) const = 0;
+
+    virtual int size() const = 0;
+
+    virtual MemoryUsage memoryUsage() const {
+        return MemoryUsage();
+    }
+};
+
+// Shard en este proceso: sus documentos en un almacén propio con el formato
+// de la base y un motor construido sobre él
+class LocalShard : public Shard {
+private:
+    int id;
+    MappedDatabase store;
+    std::unique_ptr<Index> index;
+
+public:
+    // `items` queda vacío (ver MappedDatabase::assign)
+    LocalShard(int id, std::vector<DataItem>& items, ElementType store_type, std::unique_ptr<Index> engine)
+        : id(id), index(std::move(engine)) {
+        store.assign(items, store_type);
+        index->build(store);
+    }
+
+    std::string name() const override {
+        return "local" + std::to_string(id);
+    }
+
+    ShardReply kNearest(const Point& query, int k, const SearchParams& params) const override {
+        ShardReply reply;
+        reply.neighbors = index->kNearest(query, k, params);
+        reply.ok = true;
+        return reply;
+    }
+
+    std::string text(int local_id, int timeout_ms) const override {
+        (void)timeout_ms;
+        return index->text(local_id);
+    }
+
+    int size() const override {
+        return index->size();
+    }
+
+    // El motor y el almacén (filas, normas y textos del shard)
+    MemoryUsage memoryUsage() const override {
+        MemoryUsage usage = index->memoryUsage();
+        usage.vectors += store.mappedBytes();
+        return usage;
+    }
+
+    const Index& getIndex() const {
+        return *index;
+    }
+};
+
+// Índice repartido en shards con búsqueda scatter-gather: cada kNearest va a
+// los shards que elige el reparto (todos, o los de centroide más cercano con
+// k-means), cada uno devuelve su top-k y se mezclan en un solo top-k con ids
+// globales. Los shards remotos se consultan a la vez sin bloquear; con
+// timeout_ms > 0 los que no responden a tiempo (o fallan) se omiten, así un
+// shard lento baja el recall en lugar de la latencia. build() reparte la base
+// en shards locales con el motor de `factory`; el otro constructor recibe
+// shards ya armados (p. ej. RemoteShard) con el reparto que los describe.
+class ShardedIndex : public Index {
+public:
+    typedef std::function<std::unique_ptr<Index>()> EngineFactory;
+
+private:
+    ShardOptions options;
+    EngineFactory factory;
+    ShardMap map;
+    std::vector<std::unique_ptr<Shard>> shards;
+    mutable std::atomic<long long> searches;
+    mutable std::atomic<long long> timeouts;
+    mutable std::atomic<long long> failures;
+
+    // Un shard local por partición; las filas se copian a su almacén y se
+    // liberan de la lista intermedia al construir cada uno
+    template <typename Rows, typename Texts>
+    void buildLocal(const Rows& rows, const Texts& texts, ElementType store_type) {
+        if (!factory) {
+            std::cerr << "Error: el índice repartido sobre shards remotos no se reconstruye" << std::endl;
+            return;
+        }
+        shards.clear();
+        map = ShardMap::assign(rows, options);
+        for (int s = 0; s < map.shardCount(); s++) {
+            const std::vector<int>& ids = map.shardMembers(s);
+            std::vector<DataItem> items(ids.size());
+            for (size_t i = 0; i < ids.size(); i++) {
+                items[i].text = texts(ids[i]);
+                items[i].embedding = rows.point(ids[i]);
+            }
+            shards.push_back(std::unique_ptr<Shard>(new LocalShard(s, items, store_type, factory())));
+        }
+    }
+
+public:
+    ShardedIndex(const ShardOptions& options, const EngineFactory& factory)
+        : options(options), factory(factory), searches(0), timeouts(0), failures(0) {}
+
+    ShardedIndex(const ShardOptions& options, const ShardMap& map, std::vector<std::unique_ptr<Shard>> shards)
+        : options(options), map(map), shards(std::move(shards)), searches(0), timeouts(0), failures(0) {}
+
+    std::string name() const override {
+        return "Sharded";
+    }
+
+    void build(const std::vector<DataItem>& data) override {
+        buildLocal(ItemRows{data}, [&data](int id) { return data[id].text; }, ElementType::Float64);
+    }
+
+    void build(const MappedDatabase& database) override {
+        ElementType store_type =
+            database.getElementType() == ElementType::Float32 ? ElementType::Float32 : ElementType::Float64;
+        buildLocal(DatabaseRows{database, 0, database.size()}, [&database](int id) { return database.text(id); },
+                   store_type);
+    }
+
+    std::vector<Neighbor> kNearest(const Point& query, int k,
+                                   const SearchParams& params = SearchParams()) const override {
+        searches++;
+        std::vector<int> probed = map.nearestShards(query, options.routing == ShardRouting::KMeans ? options.probe : 0);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeout_ms);
+
+        // Los remotos salen primero para que trabajen mientras se buscan los locales
+        std::vector<ShardReply> replies(probed.size());
+        std::vector<std::future<ShardReply>> pending(probed.size());
+        std::vector<int> locals;
+        for (size_t i = 0; i < probed.size(); i++) {
+            const Shard& shard = *shards[probed[i]];
+            if (shard.isRemote()) {
+                pending[i] = shard.submit(query, k, params, options.timeout_ms);
+            } else {
+                locals.push_back(static_cast<int>(i));
+            }
+        }
+        int parallelism = static_cast<int>(locals.size());
+        ThreadPool::global().parallelFor(parallelism, parallelism, [&](int j) {
+            replies[locals[j]] = shards[probed[locals[j]]]->kNearest(query, k, params);
+        });
+        for (size_t i = 0; i < probed.size(); i++) {
+            if (!pending[i].valid()) {
+                continue;
+            }
+            if (options.timeout_ms > 0 && pending[i].wait_until(deadline) != std::future_status::ready) {
+                timeouts++;
+                continue;
+            }
+            replies[i] = pending[i].get();
+            if (!replies[i].ok) {
+                failures++;
+            }
+        }
+
+        // Mezclar los top-k parciales con ids globales. Una respuesta con ids
+        // fuera de su shard (un servidor con otro archivo detrás de la URL, o de
+        // otra versión) se descarta entera y cuenta como falla
+        TopK heap(k);
+        for (size_t i = 0; i < probed.size(); i++) {
+            int members = static_cast<int>(map.shardMembers(probed[i]).size());
+            bool valid = true;
+            for (const auto& neighbor : replies[i].neighbors) {
+                valid = valid && neighbor.second >= 0 && neighbor.second < members;
+            }
+            if (!valid) {
+                failures++;
+                continue;
+            }
+            for (const auto& neighbor : replies[i].neighbors) {
+                heap.push(neighbor.first, map.globalId(probed[i], neighbor.second));
+            }
+        }
+        std::vector<Neighbor> result;
+        heap.extractSorted(result);
+        return result;
+    }
+
+    std::string text(int id) const override {
+        return shards[map.ownerOf(id)]->text(map.localId(id), options.timeout_ms);
+    }
+
+    int size() const override {
+        return map.size();
+    }
+
+    // Los shards locales y el reparto (los remotos no ocupan memoria aquí)
+    MemoryUsage memoryUsage() const override {
+        MemoryUsage usage;
+        usage.structure += map.memoryBytes();
+        for (const auto& shard : shards) {
+            usage += shard->memoryUsage();
+        }
+        return usage;
+    }
+
+    const ShardMap& getMap() const {
+        return map;
+    }
+
+    int getShardCount() const {
+        return static_cast<int>(shards.size());
+    }
+
+    const Shard& getShard(int shard) const {
+        return *shards[shard];
+    }
+
+    const ShardOptions& getOptions() const {
+        return options;
+    }
+
+    // Shards visitados con k-means y límite de los remotos; cambiarlos solo
+    // entre consultas (no con búsquedas en curso)
+    void setProbe(int probe) {
+        options.probe = probe;
+    }
+
+    void setTimeout(int timeout_ms) {
+        options.timeout_ms = timeout_ms;
+    }
+
+    // Búsquedas, shards que no respondieron a tiempo y shards que fallaron
+    long long getSearches() const {
+        return searches;
+    }
+
+    long long getTimeouts() const {
+        return timeouts;
+    }
+
+    long long getFailures() const {
+        return failures;
+    }
+};
+
+// Protocolo de los shards remotos (ShardServer y RemoteShard) sobre HTTP,
+// con cuerpos binarios en el orden de bytes de la máquina:
+//   GET  /info -> int32 documentos, int32 dimensiones
+//   POST /knn  int32 k, int32 max_checks, double epsilon, int32 ef, int32 dims, dims doubles
+//              -> int32 n, n x (double distancia, int32 id local)
+//   POST /text int32 id local -> el texto
+template <typename T>
+inline void appendBinary(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+inline bool readBinary(const std::string& in, size_t& offset, T& value) {
+    if (offset + sizeof(T) > in.size()) {
+        return false;
+    }
+    std::memcpy(&value, in.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+inline std::string encodeShardQuery(const Point& query, int k, const SearchParams& params) {
+    std::string body;
+    appendBinary(body, static_cast<int32_t>(k));
+    appendBinary(body, static_cast<int32_t>(params.max_checks));
+    appendBinary(body, params.epsilon);
+    appendBinary(body, static_cast<int32_t>(params.ef));
+    appendBinary(body, static_cast<int32_t>(query.size()));
+    body.append(reinterpret_cast<const char*>(query.data()), query.size() * sizeof(double));
+    return body;
+}
+
+inline bool decodeShardQuery(const std::string& body, Point& query, int& k, SearchParams& params) {
+    size_t offset = 0;
+    int32_t values[4] = {0, 0, 0, 0};
+    if (!readBinary(body, offset, values[0]) || !readBinary(body, offset, values[1]) ||
+        !readBinary(body, offset, params.epsilon) || !readBinary(body, offset, values[2]) ||
+        !readBinary(body, offset, values[3]) || values[3] < 0 ||
+        body.size() - offset != static_cast<size_t>(values[3]) * sizeof(double)) {
+        return false;
+    }
+    k = values[0];
+    params.max_checks = values[1];
+    params.ef = values[2];
+    query.resize(values[3]);
+    std::memcpy(query.data(), body.data() + offset, body.size() - offset);
+    return true;
+}
+
+inline std::string encodeShardNeighbors(const std::vector<Neighbor>& neighbors) {
+    std::string body;
+    appendBinary(body, static_cast<int32_t>(neighbors.size()));
+    for (const auto& neighbor : neighbors) {
+        appendBinary(body, neighbor.first);
+        appendBinary(body, static_cast<int32_t>(neighbor.second));
+    }
+    return body;
+}
+
+inline bool decodeShardNeighbors(const std::string& body, std::vector<Neighbor>& neighbors) {
+    size_t offset = 0;
+    int32_t count = 0;
+    const size_t entry_bytes = sizeof(double) + sizeof(int32_t);
+    if (!readBinary(body, offset, count) || count < 0 ||
+        static_cast<size_t>(count) > (body.size() - offset) / entry_bytes) {
+        return false;
+    }
+    neighbors.resize(count);
+    for (auto& neighbor : neighbors) {
+        int32_t id = 0;
+        if (!readBinary(body, offset, neighbor.first) || !readBinary(body, offset, id)) {
+            return false;
+        }
+        neighbor.second = id;
+    }
+    return true;
+}
+
+#endif // SHARD_H
\ No newline at end of file
@@ -0,0 +1,246 @@
+#ifndef SHARD_SERVER_H
+#define SHARD_SERVER_H
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "index.h"
+#include "shard.h"
+
+// Servidor HTTP/1.1 mínimo de un shard: atiende el protocolo de shard.h
+// (/info, /knn, /text) contra `index`, con un hilo por conexión y conexiones
+// persistentes, que es como las usa el coordinador (RemoteShard). El índice
+// debe admitir consultas concurrentes (todos los motores lo hacen).
+class ShardServer {
+private:
+    const Index& index;
+    int dims;
+    int listen_fd;
+    std::atomic<bool> stopping;
+    std::atomic<long long> answered;
+    std::set<int> connections; // Abiertas, protegidas por `mutex`
+    std::mutex mutex;
+    std::condition_variable closed;
+
+    static bool writeAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    static bool reply(int fd, int status, const std::string& body) {
+        const char* reason = status == 200 ? "OK" : status == 404 ? "Not Found" : "Bad Request";
+        std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason +
+                               "\r\nContent-Type: application/octet-stream\r\nContent-Length: " +
+                               std::to_string(body.size()) + "\r\n\r\n";
+        response += body;
+        return writeAll(fd, response);
+    }
+
+    // Valor de la cabecera `name` (sin distinguir mayúsculas) en `head`
+    static std::string headerValue(const std::string& head, const std::string& name) {
+        size_t line = head.find("\r\n");
+        while (line != std::string::npos && line + 2 < head.size()) {
+            size_t start = line + 2;
+            size_t end = head.find("\r\n", start);
+            std::string header = head.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            size_t colon = header.find(':');
+            if (colon == name.size()) {
+                bool same = true;
+                for (size_t i = 0; i < colon && same; i++) {
+                    same = std::tolower(static_cast<unsigned char>(header[i])) ==
+                           std::tolower(static_cast<unsigned char>(name[i]));
+                }
+                if (same) {
+                    size_t value = header.find_first_not_of(' ', colon + 1);
+                    return value == std::string::npos ? "" : header.substr(value);
+                }
+            }
+            line = end;
+        }
+        return "";
+    }
+
+    bool route(int fd, const std::string& method, const std::string& path, const std::string& body) {
+        if (method == "GET" && path == "/info") {
+            std::string info;
+            appendBinary(info, static_cast<int32_t>(index.size()));
+            appendBinary(info, static_cast<int32_t>(dims));
+            return reply(fd, 200, info);
+        }
+        if (method == "POST" && path == "/knn") {
+            Point query;
+            int k = 0;
+            SearchParams params;
+            if (!decodeShardQuery(body, query, k, params) || query.size() != dims || k < 0) {
+                return reply(fd, 400, "");
+            }
+            std::string result = encodeShardNeighbors(index.kNearest(query, k, params));
+            answered++;
+            return reply(fd, 200, result);
+        }
+        if (method == "POST" && path == "/text") {
+            size_t offset = 0;
+            int32_t id = -1;
+            if (!readBinary(body, offset, id) || id < 0 || id >= index.size()) {
+                return reply(fd, 404, "");
+            }
+            return reply(fd, 200, index.text(id));
+        }
+        return reply(fd, 404, "");
+    }
+
+    void closeConnection(int fd) {
+        std::lock_guard<std::mutex> lock(mutex);
+        connections.erase(fd);
+        ::close(fd);
+        closed.notify_all();
+    }
+
+    // Atender las solicitudes de una conexión hasta que el cliente la cierre
+    void serveConnection(int fd) {
+        std::string buffer;
+        char chunk[16384];
+        while (!stopping) {
+            size_t head_end;
+            while ((head_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    closeConnection(fd);
+                    return;
+                }
+                buffer.append(chunk, static_cast<size_t>(n));
+            }
+            std::string head = buffer.substr(0, head_end);
+            std::string content_length = headerValue(head, "Content-Length");
+            size_t length = static_cast<size_t>(std::strtoull(content_length.c_str(), nullptr, 10));
+            size_t total = head_end + 4 + length;
+            while (buffer.size() < total) {
+                ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    closeConnection(fd);
+                    return;
+                }
+                buffer.append(chunk, static_cast<size_t>(n));
+            }
+            std::string body = buffer.substr(head_end + 4, length);
+            buffer.erase(0, total);
+
+            size_t method_end = head.find(' ');
+            size_t path_end = method_end == std::string::npos ? std::string::npos : head.find(' ', method_end + 1);
+            if (path_end == std::string::npos) {
+                break;
+            }
+            if (!route(fd, head.substr(0, method_end), head.substr(method_end + 1, path_end - method_end - 1), body) ||
+                headerValue(head, "Connection") == "close") {
+                break;
+            }
+        }
+        closeConnection(fd);
+    }
+
+public:
+    ShardServer(const Index& index, int dims)
+        : index(index), dims(dims), listen_fd(-1), stopping(false), answered(0) {}
+
+    ~ShardServer() {
+        stop();
+    }
+
+    ShardServer(const ShardServer&) = delete;
+    ShardServer& operator=(const ShardServer&) = delete;
+
+    // Escuchar en `port` (todas las interfaces); false si no se pudo
+    bool listen(int port) {
+        listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd < 0) {
+            std::cerr << "Error: no se pudo crear el socket del shard" << std::endl;
+            return false;
+        }
+        int yes = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listen_fd, 128) != 0) {
+            std::cerr << "Error: no se pudo escuchar en el puerto " << port << ": " << std::strerror(errno)
+                      << std::endl;
+            ::close(listen_fd);
+            listen_fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    // Aceptar conexiones hasta stop()
+    void run() {
+        while (!stopping && listen_fd >= 0) {
+            int fd = ::accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            // Respuestas chicas: sin Nagle, cada una sale en cuanto se escribe
+            int yes = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                connections.insert(fd);
+            }
+            std::thread(&ShardServer::serveConnection, this, fd).detach();
+        }
+    }
+
+    // Dejar de aceptar, cortar las conexiones abiertas y esperar a sus hilos
+    void stop() {
+        stopping = true;
+        if (listen_fd >= 0) {
+            ::shutdown(listen_fd, SHUT_RDWR);
+            ::close(listen_fd);
+            listen_fd = -1;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        for (int fd : connections) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+        closed.wait(lock, [this] { return connections.empty(); });
+    }
+
+    long long getAnswered() const {
+        return answered;
+    }
+};
+
+#endif // SHARD_SERVER_H
\ No newline at end of file
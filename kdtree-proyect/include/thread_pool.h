@@ -0,0 +1,203 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+// Pool de hilos de tamaño fijo con una cola de tareas compartida
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping;
+
+    void workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    // Estado compartido de un parallelFor; vive mientras quede alguna tarea encolada
+    struct ForState {
+        std::atomic<int> next;
+        std::atomic<int> done;
+        int n;
+        std::function<void(int)> fn;
+        std::mutex mutex;
+        std::condition_variable cv;
+
+        ForState(int count, const std::function<void(int)>& f) : next(0), done(0), n(count), fn(f) {}
+
+        // Tomar índices hasta agotarlos; avisar cuando se completa el último
+        void run() {
+            int i;
+            while ((i = next.fetch_add(1)) < n) {
+                fn(i);
+                if (done.fetch_add(1) + 1 == n) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    cv.notify_all();
+                }
+            }
+        }
+    };
+
+public:
+    explicit ThreadPool(int num_threads = 0) : stopping(false) {
+        if (num_threads <= 0) {
+            num_threads = hardwareThreads();
+        }
+        workers.reserve(num_threads);
+        for (int i = 0; i < num_threads; i++) {
+            workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static int hardwareThreads() {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Pool compartido del proceso, con un hilo por núcleo
+    static ThreadPool& global() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    int size() const {
+        return static_cast<int>(workers.size());
+    }
+
+    // Encolar una tarea; el future permite esperar su resultado
+    template <typename F>
+    std::future<typename std::result_of<F()>::type> submit(F f) {
+        typedef typename std::result_of<F()>::type Result;
+        std::shared_ptr<std::packaged_task<Result()>> task =
+            std::make_shared<std::packaged_task<Result()>>(std::move(f));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push([task]() { (*task)(); });
+        }
+        cv.notify_one();
+        return result;
+    }
+
+    // Ejecutar fn(i) para i en [0, n) con hasta `parallelism` hilos (el hilo
+    // que llama también trabaja). Bloquea hasta que terminan todos los índices;
+    // como quien espera también consume índices, puede anidarse sin bloquearse.
+    void parallelFor(int n, int parallelism, const std::function<void(int)>& fn) {
+        if (n <= 0) {
+            return;
+        }
+        int helpers = std::min(std::min(parallelism, n), size() + 1) - 1;
+        if (helpers <= 0) {
+            for (int i = 0; i < n; i++) {
+                fn(i);
+            }
+            return;
+        }
+
+        std::shared_ptr<ForState> state = std::make_shared<ForState>(n, fn);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int h = 0; h < helpers; h++) {
+                tasks.push([state]() { state->run(); });
+            }
+        }
+        cv.notify_all();
+
+        state->run();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cv.wait(lock, [&state] { return state->done.load() == state->n; });
+    }
+};
+
+// Cola FIFO con capacidad fija entre etapas de un pipeline: push bloquea si
+// está llena y pop si está vacía. Tras close() push falla y pop entrega lo que
+// quede antes de devolver false.
+template <typename T>
+class BoundedQueue {
+private:
+    std::queue<T> items;
+    size_t capacity;
+    bool closed;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)), closed(false) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push(std::move(item));
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop();
+        lock.unlock();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+};
+
+#endif // THREAD_POOL_H
\ No newline at end of file
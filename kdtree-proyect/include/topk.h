@@ -0,0 +1,75 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include "memory_usage.h"
+
+// Vecino de un resultado de búsqueda: distancia e id del documento (su
+// posición en la base). Los motores trabajan solo con ids; el texto se pide
+// aparte al almacén de documentos, y solo para los resultados que se muestran.
+typedef std::pair<double, int> Neighbor;
+
+// Montículo de máximos de capacidad fija con los k mejores pares (distancia, id).
+// La memoria se reserva una sola vez; reset() permite reutilizarlo entre consultas.
+class TopK {
+private:
+    std::vector<std::pair<double, int>> heap;
+    int k;
+
+public:
+    explicit TopK(int k = 1) : k(0) {
+        reset(k);
+    }
+
+    void reset(int capacity) {
+        k = std::max(0, capacity);
+        heap.clear();
+        heap.reserve(k);
+    }
+
+    // Distancia que un candidato debe superar para entrar (infinito si no está lleno)
+    double threshold() const {
+        return static_cast<int>(heap.size()) < k || k == 0 ?
+            std::numeric_limits<double>::max() : heap.front().first;
+    }
+
+    bool full() const {
+        return static_cast<int>(heap.size()) >= k;
+    }
+
+    // Ofrecer un candidato; devuelve true si entró al montículo
+    bool push(double dist, int id) {
+        if (static_cast<int>(heap.size()) < k) {
+            heap.push_back(std::make_pair(dist, id));
+            std::push_heap(heap.begin(), heap.end());
+            return true;
+        }
+        if (k == 0 || !(dist < heap.front().first)) {
+            return false;
+        }
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = std::make_pair(dist, id);
+        std::push_heap(heap.begin(), heap.end());
+        return true;
+    }
+
+    size_t size() const {
+        return heap.size();
+    }
+
+    size_t memoryBytes() const {
+        return vectorBytes(heap);
+    }
+
+    // Vaciar el montículo en `out` ordenado de menor a mayor distancia
+    void extractSorted(std::vector<std::pair<double, int>>& out) {
+        std::sort_heap(heap.begin(), heap.end());
+        out.assign(heap.begin(), heap.end());
+        heap.clear();
+    }
+};
+
+#endif // TOPK_H
\ No newline at end of file
@@ -0,0 +1,661 @@
+#ifndef VECTOR_STORE_H
+#define VECTOR_STORE_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <Eigen/Dense>
+#include "distance.h"
+#include "search_stats.h"
+#include "memory_usage.h"
+
+// Alineación de las filas del almacén (una línea de caché, suficiente para AVX-512)
+const size_t kVectorAlignment = 64;
+
+// Asignador con alineación a kVectorAlignment para los bloques de vectores
+template <typename T>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    AlignedAllocator() {}
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, kVectorAlignment, n * sizeof(T)) != 0) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t) {
+        std::free(ptr);
+    }
+
+    template <typename U>
+    struct rebind {
+        typedef AlignedAllocator<U> other;
+    };
+};
+
+template <typename T, typename U>
+bool operator==(const AlignedAllocator<T>&, const AlignedAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const AlignedAllocator<T>&, const AlignedAllocator<U>&) { return false; }
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Tipo de elemento con el que el índice guarda los embeddings
+enum class ElementType {
+    Float64,
+    Float32,
+    Int8    // Cuantización escalar con escala por dimensión
+};
+
+inline std::string elementTypeName(ElementType type) {
+    switch (type) {
+        case ElementType::Float32: return "f32";
+        case ElementType::Int8: return "int8";
+        default: return "f64";
+    }
+}
+
+// Convierte "f64" / "f32" / "int8"; devuelve false si el nombre no es válido
+inline bool parseElementType(const std::string& name, ElementType& type) {
+    if (name == "f64" || name == "double") {
+        type = ElementType::Float64;
+    } else if (name == "f32" || name == "float") {
+        type = ElementType::Float32;
+    } else if (name == "int8" || name == "i8") {
+        type = ElementType::Int8;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Métrica de las búsquedas. Los motores buscan siempre con una distancia de
+// búsqueda que es la euclidiana al cuadrado de un espacio equivalente (así las
+// cotas por celda de los KD-trees siguen siendo cotas inferiores):
+//   - L2: ||q - x||^2 con el kernel de diferencias (exacto cerca de cero).
+//   - Cosine: filas y consulta normalizadas, ||q - x||^2 = 2 - 2 q.x.
+//   - InnerProduct: ||q||^2 + R^2 - 2 q.x con R^2 = max ||x||^2, la distancia
+//     de la reducción de máximo producto interno a vecino más cercano (cada
+//     fila extendida con sqrt(R^2 - ||x||^2), la consulta con 0), que no hace
+//     falta guardar: basta el producto punto.
+// Los resultados se reportan como distancia euclidiana, 1 - coseno o -q.x,
+// siempre de menor a mayor (ver VectorStore::reportedDistance).
+enum class Metric {
+    L2,
+    InnerProduct,
+    Cosine
+};
+
+inline std::string metricName(Metric metric) {
+    switch (metric) {
+        case Metric::InnerProduct: return "ip";
+        case Metric::Cosine: return "cosine";
+        default: return "l2";
+    }
+}
+
+// Convierte "l2" / "ip" / "cosine"; devuelve false si el nombre no es válido
+inline bool parseMetric(const std::string& name, Metric& metric) {
+    if (name == "l2" || name == "euclidean") {
+        metric = Metric::L2;
+    } else if (name == "ip" || name == "dot") {
+        metric = Metric::InnerProduct;
+    } else if (name == "cosine" || name == "cos") {
+        metric = Metric::Cosine;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Factor que lleva `v` a norma 1 (1 para el vector cero)
+inline double unitScale(const Eigen::VectorXd& v) {
+    double norm = v.norm();
+    return norm > 0 ? 1.0 / norm : 1.0;
+}
+
+// Distancia reportada entre dos vectores sueltos (p. ej. las inserciones aún
+// sin indexar de un índice dinámico), en las unidades de reportedDistance
+inline double metricDistance(Metric metric, const Eigen::VectorXd& q, const Eigen::VectorXd& x) {
+    int n = static_cast<int>(x.size());
+    switch (metric) {
+        case Metric::InnerProduct:
+            return -dotProduct(q.data(), x.data(), n);
+        case Metric::Cosine:
+            return 1.0 - dotProduct(q.data(), x.data(), n) * unitScale(q) * unitScale(x);
+        default:
+            return std::sqrt(squaredL2Distance(q.data(), x.data(), n));
+    }
+}
+
+// Matriz contigua de vectores (una fila por vector) en el tipo de elemento elegido.
+// Cada fila empieza alineada a kVectorAlignment y se rellena con ceros hasta
+// `stride` elementos, así los kernels SIMD recorren filas completas sin resto.
+// Opcionalmente conserva una copia float32 para re-rankear exactamente los
+// candidatos obtenidos con la representación cuantizada.
+// También puede ser una vista sin copia sobre filas ajenas (p. ej. un archivo
+// mapeado con mmap) que deben seguir vivas mientras se use el almacén.
+// Con la métrica coseno las filas se guardan ya normalizadas.
+class VectorStore {
+private:
+    ElementType type;
+    Metric metric;
+    double max_norm2; // R^2: mayor ||x||^2 de las filas (métricas de producto punto)
+    int dims;
+    int count;
+    int stride;       // Elementos por fila (dims redondeado a la alineación)
+    int exact_stride; // Elementos por fila de la copia float32
+
+    AlignedVector<double> data_f64;
+    AlignedVector<float> data_f32;
+    AlignedVector<int8_t> data_i8;
+    std::vector<float> scale;    // Escala por dimensión (int8)
+    AlignedVector<float> weight; // scale^2, usada por el kernel int8 (cero en el relleno)
+    AlignedVector<float> exact;  // Copia float32 para re-rank (opcional)
+
+    // Filas que usan los kernels: apuntan a los bloques propios o a la vista
+    const double* rows_f64;
+    const float* rows_f32;
+    const int8_t* rows_i8;
+    const float* rows_exact;
+
+    // Tras copiar o construir, apuntar a los bloques propios (una vista conserva sus punteros)
+    void bindOwnedRows() {
+        if (!data_f64.empty()) rows_f64 = data_f64.data();
+        if (!data_f32.empty()) rows_f32 = data_f32.data();
+        if (!data_i8.empty()) rows_i8 = data_i8.data();
+        if (!exact.empty()) rows_exact = exact.data();
+    }
+
+    static size_t elementSize(ElementType element_type) {
+        switch (element_type) {
+            case ElementType::Float32: return sizeof(float);
+            case ElementType::Int8: return sizeof(int8_t);
+            default: return sizeof(double);
+        }
+    }
+
+    static bool isAligned(const void* ptr) {
+        return reinterpret_cast<uintptr_t>(ptr) % kVectorAlignment == 0;
+    }
+
+public:
+    // Elementos por fila: `dimensions` redondeado a kVectorAlignment
+    static int paddedLength(int dimensions, size_t element_size) {
+        int per_line = static_cast<int>(kVectorAlignment / element_size);
+        return (dimensions + per_line - 1) / per_line * per_line;
+    }
+
+    // Consulta preparada una vez para el tipo de elemento del almacén,
+    // rellenada con ceros hasta el stride de las filas
+    struct Query {
+        AlignedVector<double> f64;
+        AlignedVector<float> f32;    // Float32: consulta convertida; Int8: consulta / escala (x escala con producto punto)
+        AlignedVector<float> exact;  // Consulta float32 para el re-rank
+        double norm2;                // ||q||^2 tal como se preparó (1 con coseno)
+
+        Query() : norm2(0.0) {}
+    };
+
+    VectorStore() : type(ElementType::Float64), metric(Metric::L2), max_norm2(0.0), dims(0), count(0), stride(0),
+                    exact_stride(0), rows_f64(nullptr), rows_f32(nullptr), rows_i8(nullptr), rows_exact(nullptr) {}
+
+    VectorStore(const VectorStore& other)
+        : type(other.type), metric(other.metric), max_norm2(other.max_norm2), dims(other.dims),
+          count(other.count), stride(other.stride),
+          exact_stride(other.exact_stride), data_f64(other.data_f64), data_f32(other.data_f32),
+          data_i8(other.data_i8), scale(other.scale), weight(other.weight), exact(other.exact),
+          rows_f64(other.rows_f64), rows_f32(other.rows_f32), rows_i8(other.rows_i8),
+          rows_exact(other.rows_exact) {
+        bindOwnedRows();
+    }
+
+    VectorStore& operator=(const VectorStore& other) {
+        if (this != &other) {
+            VectorStore copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    // Mover conserva los bloques, así que los punteros siguen siendo válidos
+    VectorStore(VectorStore&&) = default;
+    VectorStore& operator=(VectorStore&&) = default;
+
+    // Construir a partir de `n` filas: row(i) devuelve el vector de la fila i
+    template <typename RowFn>
+    void build(ElementType element_type, int dimensions, int n, RowFn row, bool keep_exact = false,
+               Metric row_metric = Metric::L2) {
+        if (row_metric == Metric::Cosine) {
+            buildRows(element_type, dimensions, n, [&](int i) -> Eigen::VectorXd {
+                Eigen::VectorXd v = row(i);
+                return v * unitScale(v);
+            }, keep_exact);
+        } else {
+            buildRows(element_type, dimensions, n, row, keep_exact);
+        }
+        setMetric(row_metric);
+    }
+
+    template <typename RowFn>
+    void buildRows(ElementType element_type, int dimensions, int n, RowFn row, bool keep_exact) {
+        type = element_type;
+        dims = dimensions;
+        count = n;
+        exact_stride = 0;
+        data_f64.clear();
+        data_f32.clear();
+        data_i8.clear();
+        scale.clear();
+        weight.clear();
+        exact.clear();
+        rows_f64 = nullptr;
+        rows_f32 = nullptr;
+        rows_i8 = nullptr;
+        rows_exact = nullptr;
+
+        if (type == ElementType::Float64) {
+            stride = paddedLength(dims, sizeof(double));
+            data_f64.assign(static_cast<size_t>(n) * stride, 0.0);
+            for (int i = 0; i < n; i++) {
+                Eigen::Map<Eigen::VectorXd>(&data_f64[static_cast<size_t>(i) * stride], dims) = row(i);
+            }
+            bindOwnedRows();
+            return;
+        }
+
+        if (type == ElementType::Float32) {
+            stride = paddedLength(dims, sizeof(float));
+            data_f32.assign(static_cast<size_t>(n) * stride, 0.0f);
+            for (int i = 0; i < n; i++) {
+                Eigen::Map<Eigen::VectorXf>(&data_f32[static_cast<size_t>(i) * stride], dims) = row(i).template cast<float>();
+            }
+            bindOwnedRows();
+            return;
+        }
+
+        // El stride int8 es múltiplo de 64 y por tanto también de 16 floats,
+        // así consulta escalada y pesos usan el mismo stride que los códigos
+        stride = paddedLength(dims, sizeof(int8_t));
+
+        // Int8: primera pasada para la escala por dimensión (max |x_d| / 127)
+        std::vector<double> max_abs(dims, 0.0);
+        for (int i = 0; i < n; i++) {
+            const Eigen::VectorXd& v = row(i);
+            for (int d = 0; d < dims; d++) {
+                max_abs[d] = std::max(max_abs[d], std::abs(v(d)));
+            }
+        }
+
+        scale.resize(dims);
+        weight.assign(stride, 0.0f);
+        for (int d = 0; d < dims; d++) {
+            scale[d] = static_cast<float>(max_abs[d] / 127.0);
+            // Dimensión constante en cero: el código es 0 y la consulta se usa sin escalar
+            weight[d] = scale[d] > 0 ? scale[d] * scale[d] : 1.0f;
+        }
+
+        data_i8.assign(static_cast<size_t>(n) * stride, 0);
+        if (keep_exact) {
+            exact_stride = paddedLength(dims, sizeof(float));
+            exact.assign(static_cast<size_t>(n) * exact_stride, 0.0f);
+        }
+
+        for (int i = 0; i < n; i++) {
+            const Eigen::VectorXd& v = row(i);
+            int8_t* codes = &data_i8[static_cast<size_t>(i) * stride];
+            for (int d = 0; d < dims; d++) {
+                double q = scale[d] > 0 ? std::round(v(d) / scale[d]) : 0.0;
+                codes[d] = static_cast<int8_t>(std::max(-127.0, std::min(127.0, q)));
+            }
+            if (keep_exact) {
+                Eigen::Map<Eigen::VectorXf>(&exact[static_cast<size_t>(i) * exact_stride], dims) = v.cast<float>();
+            }
+        }
+        bindOwnedRows();
+    }
+
+    // Vista sin copia sobre `n` filas float64 o float32 contiguas, alineadas a
+    // kVectorAlignment y rellenadas con ceros hasta paddedLength(dims); devuelve
+    // false si el tipo, el stride o la alineación no sirven para los kernels, o
+    // si la métrica es coseno y las filas no tienen norma 1 (hay que copiarlas)
+    bool view(ElementType element_type, int dimensions, int n, int row_stride, const void* rows,
+              Metric row_metric = Metric::L2) {
+        if (element_type == ElementType::Int8 ||
+            row_stride != paddedLength(dimensions, elementSize(element_type)) ||
+            !restore(element_type, dimensions, n, rows, nullptr, nullptr)) {
+            return false;
+        }
+        if (row_metric == Metric::Cosine) {
+            for (int i = 0; i < count; i++) {
+                if (std::abs(rowNorm2(i) - 1.0) > 1e-5) {
+                    *this = VectorStore();
+                    return false;
+                }
+            }
+        }
+        setMetric(row_metric);
+        return true;
+    }
+
+    // ||x||^2 de la fila `i` tal como quedó guardada (decodificada si es int8)
+    double rowNorm2(int i) const {
+        size_t offset = static_cast<size_t>(i) * stride;
+        switch (type) {
+            case ElementType::Float32:
+                return dotProduct(rows_f32 + offset, rows_f32 + offset, stride);
+            case ElementType::Int8: {
+                double sum = 0.0;
+                for (int d = 0; d < dims; d++) {
+                    double x = rows_i8[offset + d] * static_cast<double>(scale[d]);
+                    sum += x * x;
+                }
+                return sum;
+            }
+            default:
+                return dotProduct(rows_f64 + offset, rows_f64 + offset, stride);
+        }
+    }
+
+    // Fijar la métrica y, si usa producto punto, R^2 sobre las filas y la copia
+    // exacta. Con coseno R^2 = 1 aunque las filas cuantizadas se alejen un poco
+    // de norma 1: así la distancia reportada es exactamente 1 - q.x
+    void setMetric(Metric row_metric) {
+        metric = row_metric;
+        max_norm2 = metric == Metric::Cosine ? 1.0 : 0.0;
+        if (metric != Metric::InnerProduct) {
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            max_norm2 = std::max(max_norm2, rowNorm2(i));
+            if (rows_exact) {
+                const float* row = rows_exact + static_cast<size_t>(i) * exact_stride;
+                max_norm2 = std::max(max_norm2, static_cast<double>(dotProduct(row, row, exact_stride)));
+            }
+        }
+    }
+
+    // Vista sin copia de un almacén guardado con rowData() / scaleData() /
+    // exactData(): las filas y la copia exacta (opcional) se usan en su lugar y
+    // solo se copian las escalas int8 (una por dimensión)
+    bool restore(ElementType element_type, int dimensions, int n, const void* rows,
+                 const float* scales, const float* exact_rows) {
+        if (!isAligned(rows) || (exact_rows && !isAligned(exact_rows)) ||
+            (element_type == ElementType::Int8 && !scales)) {
+            return false;
+        }
+
+        *this = VectorStore();
+        type = element_type;
+        dims = dimensions;
+        count = n;
+        stride = paddedLength(dims, elementSize(type));
+        if (type == ElementType::Float64) {
+            rows_f64 = static_cast<const double*>(rows);
+        } else if (type == ElementType::Float32) {
+            rows_f32 = static_cast<const float*>(rows);
+        } else {
+            rows_i8 = static_cast<const int8_t*>(rows);
+            scale.assign(scales, scales + dims);
+            weight.assign(stride, 0.0f);
+            for (int d = 0; d < dims; d++) {
+                weight[d] = scale[d] > 0 ? scale[d] * scale[d] : 1.0f;
+            }
+        }
+        if (exact_rows) {
+            exact_stride = paddedLength(dims, sizeof(float));
+            rows_exact = exact_rows;
+        }
+        return true;
+    }
+
+    // true si las filas son prestadas (no cuentan en memoryBytes)
+    bool isView() const {
+        return count > 0 && data_f64.empty() && data_f32.empty() && data_i8.empty();
+    }
+
+    // Filas (count x stride) en el tipo del almacén, para serializar
+    const void* rowData() const {
+        switch (type) {
+            case ElementType::Float32: return rows_f32;
+            case ElementType::Int8: return rows_i8;
+            default: return rows_f64;
+        }
+    }
+
+    size_t rowBytes() const {
+        return static_cast<size_t>(count) * stride * elementSize(type);
+    }
+
+    // Escala por dimensión (solo int8; nullptr en otro caso)
+    const float* scaleData() const {
+        return scale.empty() ? nullptr : scale.data();
+    }
+
+    // Copia float32 para el re-rank (nullptr si no hay)
+    const float* exactData() const {
+        return rows_exact;
+    }
+
+    size_t exactBytes() const {
+        return rows_exact ? static_cast<size_t>(count) * exact_stride * sizeof(float) : 0;
+    }
+
+    // Factor por el que se multiplica la consulta (normalizarla con coseno)
+    double queryScale(const Eigen::VectorXd& query) const {
+        return metric == Metric::Cosine ? unitScale(query) : 1.0;
+    }
+
+    // Preparar la consulta para el kernel del tipo de elemento
+    void prepare(const Eigen::VectorXd& query, Query& q) const {
+        double factor = queryScale(query);
+        q.norm2 = query.squaredNorm() * factor * factor;
+        if (type == ElementType::Float64) {
+            q.f64.assign(stride, 0.0);
+            for (int d = 0; d < dims; d++) {
+                q.f64[d] = query(d) * factor;
+            }
+        } else if (type == ElementType::Float32) {
+            q.f32.assign(stride, 0.0f);
+            for (int d = 0; d < dims; d++) {
+                q.f32[d] = static_cast<float>(query(d) * factor);
+            }
+        } else {
+            q.f32.assign(stride, 0.0f);
+            for (int d = 0; d < dims; d++) {
+                double v = query(d) * factor;
+                if (metric != Metric::L2) {
+                    q.f32[d] = static_cast<float>(v * scale[d]);
+                } else {
+                    q.f32[d] = static_cast<float>(scale[d] > 0 ? v / scale[d] : v);
+                }
+            }
+            if (rows_exact) {
+                q.exact.assign(exact_stride, 0.0f);
+                for (int d = 0; d < dims; d++) {
+                    q.exact[d] = static_cast<float>(query(d) * factor);
+                }
+            }
+        }
+    }
+
+    // Consulta preparada a partir de la fila `i` tal como quedó guardada, sin
+    // volver a los vectores de entrada (distancias entre filas, p. ej. al
+    // construir un grafo). Con int8 la consulta son los valores cuantizados y
+    // no se prepara la copia exacta: sirve para distance, no para el re-rank
+    void prepareRow(int i, Query& q) const {
+        size_t offset = static_cast<size_t>(i) * stride;
+        if (type == ElementType::Float64) {
+            q.f64.assign(rows_f64 + offset, rows_f64 + offset + stride);
+        } else if (type == ElementType::Float32) {
+            q.f32.assign(rows_f32 + offset, rows_f32 + offset + stride);
+        } else {
+            // Como en prepare: el código con L2, código x escala^2 (el peso) con
+            // producto punto, y ||x||^2 = suma de código^2 x peso
+            q.f32.resize(stride);
+            const int8_t* codes = rows_i8 + offset;
+            if (metric == Metric::L2) {
+                for (int d = 0; d < stride; d++) {
+                    q.f32[d] = codes[d];
+                }
+                q.norm2 = rowNorm2(i);
+                return;
+            }
+            for (int d = 0; d < stride; d++) {
+                q.f32[d] = codes[d] * weight[d];
+            }
+            q.norm2 = metric == Metric::Cosine ? 1.0 : dotProduct(q.f32.data(), codes, stride);
+            return;
+        }
+        q.norm2 = metric == Metric::Cosine ? 1.0 : rowNorm2(i);
+    }
+
+    // Distancia de búsqueda a partir del producto punto (coseno y producto interno)
+    double dotDistance(const Query& q, double dot) const {
+        return std::max(0.0, q.norm2 + max_norm2 - 2.0 * dot);
+    }
+
+    // Distancia euclidiana al cuadrado entre la consulta y la fila `i`. Con
+    // N > 0 (solo si kernelDimension() == N) la longitud de fila es constante
+    template <int N = 0>
+    double distance(const Query& q, int i) const {
+        const size_t row = N > 0 ? N : stride;
+        size_t offset = static_cast<size_t>(i) * row;
+        if (metric != Metric::L2) {
+            switch (type) {
+                case ElementType::Float32:
+                    return dotDistance(q, dotProduct<N>(q.f32.data(), rows_f32 + offset, stride));
+                case ElementType::Int8:
+                    return dotDistance(q, dotProduct<N>(q.f32.data(), rows_i8 + offset, stride));
+                default:
+                    return dotDistance(q, dotProduct<N>(q.f64.data(), rows_f64 + offset, stride));
+            }
+        }
+        switch (type) {
+            case ElementType::Float32:
+                return squaredL2Distance<N>(q.f32.data(), rows_f32 + offset, stride);
+            case ElementType::Int8:
+                return squaredL2Distance<N>(q.f32.data(), rows_i8 + offset, weight.data(), stride);
+            default:
+                return squaredL2Distance<N>(q.f64.data(), rows_f64 + offset, stride);
+        }
+    }
+
+    // Distancia con la copia exacta si existe (si no, igual a distance)
+    template <int N = 0>
+    double exactDistance(const Query& q, int i) const {
+        if (!rows_exact) {
+            return distance<N>(q, i);
+        }
+        const size_t row = N > 0 ? N : exact_stride;
+        const float* x = rows_exact + static_cast<size_t>(i) * row;
+        if (metric != Metric::L2) {
+            return dotDistance(q, dotProduct<N>(q.exact.data(), x, exact_stride));
+        }
+        return squaredL2Distance<N>(q.exact.data(), x, exact_stride);
+    }
+
+    // Distancia que se reporta a partir de la de búsqueda, para una consulta
+    // preparada con ||q||^2 = query_norm2: euclidiana, 1 - coseno o -q.x
+    double reportedDistance(double dist, double query_norm2) const {
+        switch (metric) {
+            case Metric::Cosine: return dist / 2.0;
+            case Metric::InnerProduct: return (dist - query_norm2 - max_norm2) / 2.0;
+            default: return std::sqrt(dist);
+        }
+    }
+
+    // Inversa de reportedDistance (p. ej. para un radio); negativa si ninguna
+    // fila puede quedar a esa distancia
+    double searchDistance(double reported, double query_norm2) const {
+        switch (metric) {
+            case Metric::Cosine: return 2.0 * reported;
+            case Metric::InnerProduct: return 2.0 * reported + query_norm2 + max_norm2;
+            default: return reported < 0 ? -1.0 : reported * reported;
+        }
+    }
+
+    Metric getMetric() const {
+        return metric;
+    }
+
+    double getMaxNorm2() const {
+        return max_norm2;
+    }
+
+    // Longitud de fila para instanciar los kernels de longitud fija (ver
+    // dispatchDimension): el stride, que con las dimensiones comunes coincide
+    // con el de la copia exacta; 0 si no coinciden y solo sirve la dinámica
+    int kernelDimension() const {
+        return !rows_exact || exact_stride == stride ? stride : 0;
+    }
+
+    bool hasExact() const {
+        return rows_exact != nullptr;
+    }
+
+    ElementType getElementType() const {
+        return type;
+    }
+
+    int getDimensions() const {
+        return dims;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    int getStride() const {
+        return stride;
+    }
+
+    // Acceso directo a las filas (n x stride, fila mayor) para los caminos por bloques
+    const double* rowsF64() const {
+        return rows_f64;
+    }
+
+    const float* rowsF32() const {
+        return rows_f32;
+    }
+
+    // Bytes propios de los vectores (incluye escalas y copia exacta; una vista
+    // no cuenta, sus filas viven en la caché de páginas del archivo)
+    size_t memoryBytes() const {
+        return vectorBytes(data_f64) + vectorBytes(data_f32) + vectorBytes(data_i8) + vectorBytes(scale) +
+               vectorBytes(weight) + vectorBytes(exact);
+    }
+
+    // Bytes de una consulta preparada
+    static size_t queryBytes(const Query& q) {
+        return vectorBytes(q.f64) + vectorBytes(q.f32) + vectorBytes(q.exact);
+    }
+};
+
+// Re-rank exacto: recalcula con la copia float32 la distancia de los candidatos
+// (pares distancia, fila) y deja los `k` mejores ordenados de menor a mayor
+template <int N = 0>
+inline void rerankCandidates(const VectorStore& store, const VectorStore::Query& q,
+                             std::vector<std::pair<double, int>>& candidates, int k) {
+    SearchCounters::distance(candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++) {
+        candidates[i].first = store.exactDistance<N>(q, candidates[i].second);
+    }
+    size_t keep = std::min(candidates.size(), static_cast<size_t>(std::max(0, k)));
+    std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end());
+    candidates.resize(keep);
+}
+
+#endif // VECTOR_STORE_H
\ No newline at end of file
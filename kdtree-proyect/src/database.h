@@ -8,60 +8,107 @@
 #include <json/json.h>
 #include <Eigen/Dense>
 #include "../include/kdtree.h"
+#include "../include/mapped_database.h"
+#include "../include/jsonl_ingest.h"
 #include "embeddings.h"
 
 // Definir la instancia global del embedder
 DeterministicEmbedder embedder(384);
 
-// Función para cargar base de datos desde JSONL
-std::vector<DataItem> loadDatabaseFromJsonl(const std::string& filename, int max_lines = -1) {
+// Función para cargar base de datos desde JSONL a memoria (ver jsonl_ingest.h;
+// para archivos grandes conviene ingestJsonlToFile, que no guarda los registros)
+std::vector<DataItem> loadDatabaseFromJsonl(const std::string& filename, int max_lines = -1, int threads = 0) {
     std::vector<DataItem> database;
-    std::ifstream file(filename);
+    std::cout << "Leyendo archivo JSONL..." << std::endl;
     
-    if (!file.is_open()) {
-        std::cerr << "Error: No se pudo abrir el archivo " << filename << std::endl;
-        return database;
+    IngestSink sink = [&database](std::vector<DataItem>& items) {
+        for (auto& item : items) {
+            database.push_back(std::move(item));
+        }
+        return true;
+    };
+    ingestJsonl(filename, embedder, sink, IngestOptions(threads, 256 * 1024, 0, max_lines));
+    
+    std::cout << "Base de datos cargada con " << database.size() << " elementos" << std::endl;
+    return database;
+}
+
+// Ingerir un JSONL directamente al formato mapeable: cada bloque de registros
+// se escribe en orden y se descarta, así la memoria no crece con el archivo
+bool ingestJsonlToFile(const std::string& filename, const std::string& out_filename, int max_lines = -1,
+                       int threads = 0, ElementType element_type = ElementType::Float64) {
+    DatabaseFileWriter writer;
+    if (!writer.open(out_filename, element_type, embedder.getDimension())) {
+        return false;
     }
     
-    std::cout << "Leyendo archivo JSONL..." << std::endl;
+    IngestSink sink = [&writer](std::vector<DataItem>& items) {
+        for (const auto& item : items) {
+            if (!writer.append(item.text, item.embedding)) {
+                return false;
+            }
+        }
+        items.clear();
+        return true;
+    };
+    IngestStats stats;
+    if (!ingestJsonl(filename, embedder, sink, IngestOptions(threads, 256 * 1024, 0, max_lines), &stats)) {
+        return false;
+    }
+    return writer.finish(stats.lines);
+}
+
+// Títulos de un JSONL como consultas de texto. La base solo indexa el
+// contenido, así que los títulos son consultas que no están en ella; se toman
+// desde la línea `first_line` (p. ej. las que la base no ingirió) y, si no
+// alcanzan, desde el principio del archivo
+std::vector<std::string> loadTitlesFromJsonl(const std::string& filename, int num_titles, int first_line = 0) {
+    std::vector<std::string> titles;
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "No se pudo abrir el archivo de consultas: " << filename << std::endl;
+        return titles;
+    }
     
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::vector<std::string> skipped; // Títulos anteriores a `first_line`, por si no alcanzan
     std::string line;
-    int count = 0;
-    
-    // Crear base de datos con embeddings directamente
-    while (std::getline(file, line) && (max_lines == -1 || count < max_lines)) {
-        Json::Value jsonData;
-        Json::Reader jsonReader;
-        
-        if (jsonReader.parse(line, jsonData)) {
-            // Formato esperado: ["título", "contenido"]
-            if (jsonData.isArray() && jsonData.size() >= 2) {
-                DataItem item;
-                item.text = jsonData[1].asString();
-                
-                // Generar embedding puramente determinista
-                item.embedding = embedder.getEmbedding(item.text);
-                
-                database.push_back(item);
-                
-                if (count % 100 == 0) {
-                    std::cout << "Procesados " << count << " elementos..." << std::endl;
-                }
+    Json::Value value;
+    std::string errors;
+    for (int line_number = 0; static_cast<int>(titles.size()) < num_titles && std::getline(file, line); line_number++) {
+        if (!reader->parse(line.data(), line.data() + line.size(), &value, &errors) || !value.isArray() ||
+            value.size() < 1 || !value[0].isString() || value[0].asString().empty()) {
+            continue;
+        }
+        if (line_number < first_line) {
+            if (static_cast<int>(skipped.size()) < num_titles) {
+                skipped.push_back(value[0].asString());
             }
+        } else {
+            titles.push_back(value[0].asString());
         }
-        
-        count++;
     }
-    
-    file.close();
-    std::cout << "Base de datos cargada con " << database.size() << " elementos" << std::endl;
-    
-    return database;
+    for (size_t i = 0; static_cast<int>(titles.size()) < num_titles && i < skipped.size(); i++) {
+        titles.push_back(skipped[i]);
+    }
+    return titles;
 }
 
-// Función para cargar base de datos desde archivo binario
+// Función para cargar base de datos desde archivo binario. Acepta el formato
+// mapeable de mapped_database.h y el formato secuencial anterior; para no
+// copiar nada conviene abrir el primero directamente con MappedDatabase
 std::vector<DataItem> loadDatabase(const std::string& filename) {
     std::vector<DataItem> database;
+    if (MappedDatabase::isDatabaseFile(filename)) {
+        MappedDatabase mapped;
+        if (mapped.open(filename)) {
+            database = mapped.toDataItems();
+            std::cout << "Base de datos cargada con " << database.size() << " elementos" << std::endl;
+        }
+        return database;
+    }
+    
     std::ifstream infile(filename, std::ios::binary);
     
     if (!infile.is_open()) {
@@ -95,20 +142,15 @@ std::vector<DataItem> loadDatabase(const std::string& filename) {
             item.text.resize(text_length);
             infile.read(&item.text[0], text_length);
             
-            // Leer embedding
+            // Leer embedding (una lectura por fila)
             item.embedding.resize(embedding_dim);
-            for (int j = 0; j < embedding_dim; j++) {
-                double value;
-                infile.read(reinterpret_cast<char*>(&value), sizeof(value));
-                item.embedding(j) = value;
+            infile.read(reinterpret_cast<char*>(item.embedding.data()), sizeof(double) * embedding_dim);
+            if (!infile) {
+                std::cerr << "Error: " << filename << " está truncado en el elemento " << i << std::endl;
+                break;
             }
             
-            database.push_back(item);
-            
-            // Mostrar progreso
-            if (i % 1000 == 0) {
-                std::cout << "Cargados " << i << "/" << db_size << " elementos..." << std::endl;
-            }
+            database.push_back(std::move(item));
         }
         
         infile.close();
@@ -146,11 +188,11 @@ std::vector<DataItem> generateMockDatabase(int size, int dimensions) {
     return database;
 }
 
-// Generar consultas aleatorias desde la base de datos
-std::vector<Point> generateQueries(const std::vector<DataItem>& database, int num_queries) {
+// Generar consultas aleatorias desde la base de datos; la semilla es fija para
+// que todas las corridas (y todos los motores) usen el mismo conjunto
+std::vector<Point> generateQueries(const std::vector<DataItem>& database, int num_queries, unsigned int seed = 42) {
     std::vector<Point> queries;
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937 gen(seed);
     std::uniform_int_distribution<> dist(0, database.size() - 1);
     
     for (int i = 0; i < num_queries; i++) {
@@ -161,56 +203,28 @@ std::vector<Point> generateQueries(const std::vector<DataItem>& database, int nu
     return queries;
 }
 
-// Guardar base de datos en archivo binario
-bool saveDatabase(const std::vector<DataItem>& database, const std::string& filename, int processed_lines) {
-    std::ofstream outfile(filename, std::ios::binary);
+// Consultas aleatorias tomadas de las filas de una base (mapeada o en memoria)
+std::vector<Point> generateQueries(const MappedDatabase& database, int num_queries, unsigned int seed = 42) {
+    std::vector<Point> queries;
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> dist(0, database.size() - 1);
     
-    if (!outfile.is_open()) {
-        std::cerr << "Error: No se pudo abrir " << filename << " para escribir" << std::endl;
-        return false;
+    for (int i = 0; i < num_queries; i++) {
+        queries.push_back(database.embedding(dist(gen)));
     }
     
-    try {
-        // Escribir número de líneas procesadas
-        outfile.write(reinterpret_cast<const char*>(&processed_lines), sizeof(processed_lines));
-        
-        // Escribir tamaño de la base de datos
-        int db_size = database.size();
-        outfile.write(reinterpret_cast<const char*>(&db_size), sizeof(db_size));
-        
-        // Escribir dimensión de los embeddings (asumiendo que todos tienen la misma)
-        int embedding_dim = database.empty() ? 0 : database[0].embedding.size();
-        outfile.write(reinterpret_cast<const char*>(&embedding_dim), sizeof(embedding_dim));
-        
-        // Escribir cada item
-        for (int i = 0; i < db_size; i++) {
-            const auto& item = database[i];
-            
-            // Escribir texto
-            int text_length = item.text.length();
-            outfile.write(reinterpret_cast<const char*>(&text_length), sizeof(text_length));
-            outfile.write(item.text.c_str(), text_length);
-            
-            // Escribir embedding
-            for (int j = 0; j < embedding_dim; j++) {
-                double value = item.embedding(j);
-                outfile.write(reinterpret_cast<const char*>(&value), sizeof(value));
-            }
-            
-            // Mostrar progreso
-            if (i % 1000 == 0) {
-                std::cout << "Guardados " << i << "/" << db_size << " elementos..." << std::endl;
-            }
-        }
-        
-        outfile.close();
-        std::cout << "Base de datos guardada en " << filename << std::endl;
-        return true;
-    }
-    catch (const std::exception& e) {
-        std::cerr << "Error al guardar la base de datos: " << e.what() << std::endl;
-        return false;
+    return queries;
+}
+
+// Guardar base de datos en el formato mapeable (ver mapped_database.h), con
+// el árbol ya construido sobre ella si se indica
+bool saveDatabase(const std::vector<DataItem>& database, const std::string& filename, int processed_lines,
+                  const KDTree* tree = nullptr) {
+    TreeSectionWriter tree_section;
+    if (tree) {
+        tree_section = [tree](uint64_t checksum) { return tree->serialize(checksum); };
     }
+    return writeDatabaseFile(database, filename, processed_lines, ElementType::Float64, tree_section);
 }
 
 #endif // DATABASE_H
\ No newline at end of file
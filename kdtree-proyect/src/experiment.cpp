@@ -8,7 +8,30 @@
 #include <numeric>
 #include <sstream>
 #include <cmath>
+#include <thread>
+#include <atomic>
+#include <future>
 #include "../include/kdtree.h"
+#include "../include/kdforest.h"
+#include "../include/linear_search.h"
+#include "../include/hnsw.h"
+#include "../include/ivfpq.h"
+#include "../include/index.h"
+#include "../include/dynamic_kdtree.h"
+#include "../include/search_service.h"
+#include "../include/query_cache.h"
+#include "../include/shard.h"
+#include "../include/shard_server.h"
+#ifdef KDTREE_WITH_HTTP
+#include "../include/remote_shard.h"
+#endif
+#include "../include/thread_pool.h"
+#include "../include/benchmark.h"
+#include "../include/ground_truth.h"
+#include "../include/memory_usage.h"
+#ifdef KDTREE_WITH_LLM
+#include "../include/rag.h"
+#endif
 #include "database.h"
 #include "embeddings.h"
 
@@ -23,27 +46,105 @@ struct PerformanceStats {
     size_t memory_usage_kb;
 };
 
-// Función para medir el uso de memoria
-size_t estimateMemoryUsage(const KDTree& tree) {
-    // Aproximación: cada nodo contiene un punto (384 doubles) y algunos punteros/valores
-    size_t point_size = 384 * sizeof(double);
-    size_t node_overhead = sizeof(int) * 3; // axis, left, right
-    size_t total_nodes = tree.getNodeCount();
-    
-    return (point_size + node_overhead) * total_nodes / 1024; // KB
+// Configuración de los índices elegida por línea de comandos
+struct IndexConfig {
+    ElementType element_type;
+    int rerank; // Candidatos para re-rank exacto con int8 o IVF-PQ (0 = sin re-rank)
+    int threads; // Hilos para las consultas por lotes y la ingesta del JSONL (0 = todos los núcleos)
+    SearchParams search; // Búsqueda aproximada del modo interactivo (por defecto exacta)
+    std::string engine;  // Motor del modo interactivo: kdtree, forest, hnsw, ivfpq, linear o dynamic
+    int forest_trees;    // Árboles del KD-forest
+    HNSWOptions hnsw;    // M, efConstruction y efSearch del grafo HNSW
+    IVFPQOptions ivfpq;  // Listas, subespacios y nprobe del IVF-PQ
+    int leaf_size;       // Tamaño de hoja del modo interactivo y del árbol guardado
+    Metric metric;       // Métrica de todos los motores y de sus líneas base exactas
+    size_t cache_entries; // Respuestas en caché del modo interactivo y del servicio (0 = sin caché)
+    ShardOptions shard;  // Reparto del motor "sharded", de --partition y del coordinador
+    std::string shard_map;               // Coordinador de shards remotos (--coordinator):
+    std::vector<std::string> shard_urls; // el reparto y la URL de cada shard
+    
+    IndexConfig() : element_type(ElementType::Float64), rerank(0), threads(0), engine("kdtree"),
+                    forest_trees(4), leaf_size(10), metric(Metric::L2), cache_entries(1024) {}
+};
+
+// Opciones de KD-tree de la configuración con tamaño de hoja `leaf_size`
+KDTreeOptions treeOptions(const IndexConfig& config, int leaf_size) {
+    KDTreeOptions options(leaf_size, config.element_type, config.rerank);
+    options.metric = config.metric;
+    return options;
 }
 
-size_t estimateMemoryUsage(const LinearSearch& search) {
-    // Cada elemento tiene un embedding (384 doubles) y texto
-    size_t point_size = 384 * sizeof(double);
-    size_t avg_text_size = 100; // estimación promedio de longitud de texto
-    size_t total_items = search.getSize();
-    
-    return (point_size + avg_text_size) * total_items / 1024; // KB
+// Construir el motor `engine` con la configuración de línea de comandos.
+// "sharded" reparte la base en config.shard.shards shards locales con el motor
+// config.shard.engine en cada uno
+std::unique_ptr<Index> createIndex(const std::string& engine, const IndexConfig& config, int leaf_size) {
+    if (engine == "sharded") {
+        std::string shard_engine = config.shard.engine == "sharded" ? "kdtree" : config.shard.engine;
+        return std::unique_ptr<Index>(new ShardedIndex(config.shard, [shard_engine, config, leaf_size]() {
+            return createIndex(shard_engine, config, leaf_size);
+        }));
+    }
+    KDTreeOptions tree_options = treeOptions(config, leaf_size);
+    HNSWOptions hnsw_options = config.hnsw;
+    hnsw_options.element_type = config.element_type;
+    hnsw_options.rerank = config.rerank;
+    hnsw_options.metric = config.metric;
+    IVFPQOptions ivfpq_options = config.ivfpq;
+    ivfpq_options.rerank = config.rerank;
+    ivfpq_options.metric = config.metric;
+    return createIndex(engine, tree_options, config.forest_trees, hnsw_options, ivfpq_options);
+}
+
+// Recall@k de un resultado aproximado contra el exacto. Un resultado cuenta como
+// acierto si su distancia no supera la k-ésima distancia exacta (tolera empates).
+double computeRecall(const std::vector<Neighbor>& approx,
+                     const std::vector<Neighbor>& exact) {
+    if (exact.empty()) {
+        return 1.0;
+    }
+    double kth_dist = exact.back().first + 1e-9;
+    int hits = 0;
+    for (size_t i = 0; i < approx.size() && i < exact.size(); i++) {
+        if (approx[i].first <= kth_dist) {
+            hits++;
+        }
+    }
+    return static_cast<double>(hits) / exact.size();
+}
+
+// Columnas de los contadores por consulta (ver search_stats.h); quedan vacías
+// si se compiló sin KDTREE_STATS
+const char kSearchStatsColumns[] =
+    "Nodes_Visited,Distance_Evals,Branches_Explored,Branches_Pruned,Leaf_Scans,Mean_Leaf_Depth,Max_Depth";
+
+std::string searchStatsFields(const SearchStats& stats) {
+    if (!kSearchStatsEnabled) {
+        return ",,,,,,";
+    }
+    std::ostringstream fields;
+    fields << stats.perQuery(stats.nodes_visited) << "," << stats.perQuery(stats.distance_evals) << ","
+           << stats.perQuery(stats.branches_explored) << "," << stats.perQuery(stats.branches_pruned) << ","
+           << stats.perQuery(stats.leaf_scans) << "," << stats.meanLeafDepth() << "," << stats.max_depth;
+    return fields.str();
+}
+
+// Columnas de memoria de un índice (ver memory_usage.h): sus componentes y lo
+// que creció la memoria residente del proceso al construirlo y al consultarlo
+const char kMemoryColumns[] =
+    "Vectors_KB,Structure_KB,Tables_KB,Payload_KB,Scratch_KB,Build_RSS_KB,Build_Peak_KB,Query_Peak_KB";
+
+std::string memoryFields(const MemoryUsage& usage, const PhaseMemory& build, const PhaseMemory& query) {
+    std::ostringstream fields;
+    fields << usage.vectors / 1024 << "," << usage.structure / 1024 << "," << usage.tables / 1024 << ","
+           << usage.payload / 1024 << "," << usage.scratch / 1024 << "," << build.rss_delta / 1024 << "," << build.peak_delta / 1024 << ","
+           << query.peak_delta / 1024;
+    return fields.str();
 }
 
-// Experimento con diferentes tamaños de base de datos
-void experimentDatabaseSize(const std::vector<DataItem>& full_database) {
+// Experimento con diferentes tamaños de base de datos. Cada tamaño es el rango
+// de ids [0, size) de la base: los índices se construyen sobre ella sin copiar
+// subconjuntos
+void experimentDatabaseSize(const MappedDatabase& full_database, const IndexConfig& config) {
     std::cout << "\n==== Experimento: Tamaño de Base de Datos ====\n";
     
     // Definir tamaños a evaluar
@@ -54,17 +155,24 @@ void experimentDatabaseSize(const std::vector<DataItem>& full_database) {
     
     // Limitar tamaños según la base disponible
     sizes.erase(std::remove_if(sizes.begin(), sizes.end(), 
-                          [&](int s) { return s > static_cast<int>(full_database.size()); }),
+                          [&](int s) { return s > full_database.size(); }),
            sizes.end());
     
-    // Archivo para resultados
+    // Archivo para resultados (tiempos en µs por consulta)
     std::ofstream results_file("results/database_size_results.csv");
     results_file << "Size,KDTree_Mean_Time,KDTree_StdDev,KDTree_Min,KDTree_Max,KDTree_Median,KDTree_P90,KDTree_Memory_KB,";
-    results_file << "Linear_Mean_Time,Linear_StdDev,Linear_Min,Linear_Max,Linear_Median,Linear_P90,Linear_Memory_KB,Speedup\n";
+    results_file << "Linear_Mean_Time,Linear_StdDev,Linear_Min,Linear_Max,Linear_Median,Linear_P90,Linear_Memory_KB,Speedup,";
+    results_file << "KDTree_CI95,Linear_CI95,KDTree_Cold_Mean,Linear_Cold_Mean,P_Value,";
+    results_file << "KDTree_Build_RSS_KB,KDTree_Build_Peak_KB\n";
     
-    // Generar consultas para el experimento (usamos las mismas para todos los tamaños)
+    // Consultas con semilla fija (las mismas para todos los tamaños y motores).
+    // En caliente: 30 lotes de al menos 200 µs tras 3 de calentamiento; en frío:
+    // una consulta por muestra con la caché vaciada antes
     const int num_queries = 100;
-    const int num_runs = 10; // número de ejecuciones para medir variabilidad
+    const BenchOptions warm(30, 3, 200.0);
+    const BenchOptions cold(num_queries, 0, 0.0, true);
+    CacheFlusher flusher;
+    std::vector<BenchStats> bench;
     
     std::vector<Point> queries = generateQueries(full_database, num_queries);
     
@@ -72,131 +180,84 @@ void experimentDatabaseSize(const std::vector<DataItem>& full_database) {
     for (int size : sizes) {
         std::cout << "Evaluando base de datos de tamaño " << size << "..." << std::endl;
         
-        // Crear subconjunto de la base
-        std::vector<DataItem> subset(full_database.begin(), full_database.begin() + size);
-        
-        // Construir árbol KD
+        // Construir árbol KD sobre los primeros `size` documentos
+        PhaseMemory build_memory;
         auto build_start = std::chrono::high_resolution_clock::now();
-        KDTree tree(subset);
+        KDTree tree(full_database, 0, size, treeOptions(config, 1));
         auto build_end = std::chrono::high_resolution_clock::now();
+        build_memory.end();
         auto build_time = std::chrono::duration_cast<std::chrono::milliseconds>(build_end - build_start).count();
         
-        // Construir búsqueda lineal
-        LinearSearch linear(subset);
+        // Construir búsqueda lineal (vista del mismo rango)
+        LinearSearch linear(full_database, 0, size, config.element_type, config.metric);
         
         // Medir memoria
-        size_t kdtree_memory = estimateMemoryUsage(tree);
-        size_t linear_memory = estimateMemoryUsage(linear);
-        
-        std::cout << "  Árbol KD construido en " << build_time << " ms (memoria estimada: " 
-                  << kdtree_memory << " KB)" << std::endl;
-        
-        // Vectores para almacenar tiempos
-        std::vector<double> kdtree_times;
-        std::vector<double> linear_times;
-        
-        // Para cada consulta
-        for (int q = 0; q < num_queries; q++) {
-            const auto& query = queries[q];
-            
-            // Vectores de tiempos para múltiples ejecuciones
-            std::vector<double> kd_times_run;
-            std::vector<double> linear_times_run;
-            
-            // Realizar múltiples ejecuciones
-            for (int run = 0; run < num_runs; run++) {
-                // Medir tiempo para árbol KD
-                auto kd_start = std::chrono::high_resolution_clock::now();
-                auto kd_result = tree.nearest(query);
-                auto kd_end = std::chrono::high_resolution_clock::now();
-                auto kd_time = std::chrono::duration_cast<std::chrono::microseconds>(kd_end - kd_start).count();
-                kd_times_run.push_back(kd_time);
-                
-                // Medir tiempo para búsqueda lineal
-                auto linear_start = std::chrono::high_resolution_clock::now();
-                auto linear_result = linear.nearest(query);
-                auto linear_end = std::chrono::high_resolution_clock::now();
-                auto linear_time = std::chrono::duration_cast<std::chrono::microseconds>(linear_end - linear_start).count();
-                linear_times_run.push_back(linear_time);
-            }
-            
-            // Calcular estadísticas para esta consulta (promedio de ejecuciones)
-            double kd_avg = std::accumulate(kd_times_run.begin(), kd_times_run.end(), 0.0) / num_runs;
-            double linear_avg = std::accumulate(linear_times_run.begin(), linear_times_run.end(), 0.0) / num_runs;
-            
-            kdtree_times.push_back(kd_avg);
-            linear_times.push_back(linear_avg);
-        }
-        
-        // Calcular estadísticas para KDTree
-        std::sort(kdtree_times.begin(), kdtree_times.end());
-        double kd_mean = std::accumulate(kdtree_times.begin(), kdtree_times.end(), 0.0) / kdtree_times.size();
-        
-        double kd_var = 0.0;
-        for (const auto& time : kdtree_times) {
-            kd_var += (time - kd_mean) * (time - kd_mean);
-        }
-        kd_var /= kdtree_times.size();
-        double kd_stddev = std::sqrt(kd_var);
+        size_t kdtree_memory = tree.memoryUsage().total() / 1024;
+        size_t linear_memory = linear.memoryUsage().total() / 1024;
         
-        double kd_min = kdtree_times.front();
-        double kd_max = kdtree_times.back();
-        double kd_median = kdtree_times[kdtree_times.size() / 2];
-        double kd_p90 = kdtree_times[static_cast<int>(kdtree_times.size() * 0.9)];
+        std::cout << "  Árbol KD construido en " << build_time << " ms (memoria: " 
+                  << kdtree_memory << " KB, pico de construcción: " << build_memory.peak_delta / 1024
+                  << " KB)" << std::endl;
         
-        // Calcular estadísticas para búsqueda lineal
-        std::sort(linear_times.begin(), linear_times.end());
-        double linear_mean = std::accumulate(linear_times.begin(), linear_times.end(), 0.0) / linear_times.size();
+        // Cada motor se mide por separado (sin intercalarlos en el mismo bucle,
+        // donde uno ensuciaría la caché del otro), rotando por las consultas
+        std::string label = std::to_string(size);
+        auto kd_op = [&](long long i) { doNotOptimize(tree.nearest(queries[i % num_queries])); };
+        auto linear_op = [&](long long i) { doNotOptimize(linear.nearest(queries[i % num_queries])); };
+        BenchStats kd = runBenchmark("kdtree/" + label, kd_op, warm);
+        BenchStats kd_cold = runBenchmark("kdtree/" + label, kd_op, cold, &flusher);
+        BenchStats lin = runBenchmark("linear/" + label, linear_op, warm);
+        BenchStats lin_cold = runBenchmark("linear/" + label, linear_op, cold, &flusher);
+        bench.insert(bench.end(), {kd, kd_cold, lin, lin_cold});
         
-        double linear_var = 0.0;
-        for (const auto& time : linear_times) {
-            linear_var += (time - linear_mean) * (time - linear_mean);
-        }
-        linear_var /= linear_times.size();
-        double linear_stddev = std::sqrt(linear_var);
-        
-        double linear_min = linear_times.front();
-        double linear_max = linear_times.back();
-        double linear_median = linear_times[linear_times.size() / 2];
-        double linear_p90 = linear_times[static_cast<int>(linear_times.size() * 0.9)];
-        
-        // Calcular aceleración (speedup)
-        double speedup = linear_mean / kd_mean;
+        // Aceleración (speedup) y significancia de la diferencia en caliente
+        double speedup = kd.mean > 0 ? lin.mean / kd.mean : 0.0;
+        WelchResult welch = welchTest(kd.values, lin.values);
         
         // Guardar resultados
+        const double us = 1e-3;
         results_file << size << "," 
-                    << kd_mean << "," << kd_stddev << "," << kd_min << "," << kd_max << "," 
-                    << kd_median << "," << kd_p90 << "," << kdtree_memory << ","
-                    << linear_mean << "," << linear_stddev << "," << linear_min << "," << linear_max << ","
-                    << linear_median << "," << linear_p90 << "," << linear_memory << ","
-                    << speedup << "\n";
+                    << kd.mean * us << "," << kd.stddev * us << "," << kd.min * us << "," << kd.max * us << "," 
+                    << kd.median * us << "," << kd.p90 * us << "," << kdtree_memory << ","
+                    << lin.mean * us << "," << lin.stddev * us << "," << lin.min * us << "," << lin.max * us << ","
+                    << lin.median * us << "," << lin.p90 * us << "," << linear_memory << ","
+                    << speedup << "," << kd.ci95 * us << "," << lin.ci95 * us << ","
+                    << kd_cold.mean * us << "," << lin_cold.mean * us << "," << welch.p_value << ","
+                    << build_memory.rss_delta / 1024 << "," << build_memory.peak_delta / 1024 << "\n";
         
         // Imprimir resultados parciales
         std::cout << "  Resultados para tamaño " << size << ":" << std::endl;
-        std::cout << "    KD Tree:   " << kd_mean << " µs (stddev: " << kd_stddev << " µs)" << std::endl;
-        std::cout << "    Lineal:    " << linear_mean << " µs (stddev: " << linear_stddev << " µs)" << std::endl;
-        std::cout << "    Speedup:   " << speedup << "x" << std::endl;
+        std::cout << "    KD Tree:   " << kd.mean * us << " ± " << kd.ci95 * us << " µs (en frío: "
+                  << kd_cold.mean * us << " µs)" << std::endl;
+        std::cout << "    Lineal:    " << lin.mean * us << " ± " << lin.ci95 * us << " µs (en frío: "
+                  << lin_cold.mean * us << " µs)" << std::endl;
+        std::cout << "    Speedup:   " << speedup << "x (Welch p = " << welch.p_value << ")" << std::endl;
         std::cout << "    Memoria:   KD Tree: " << kdtree_memory << " KB, Lineal: " << linear_memory << " KB" << std::endl;
     }
     
     results_file.close();
-    std::cout << "Resultados guardados en results/database_size_results.csv" << std::endl;
+    writeBenchJson("results/database_size_bench.json", bench);
+    std::cout << "Resultados guardados en results/database_size_results.csv (muestras en results/database_size_bench.json)" << std::endl;
 }
 
 // Experimento con diferentes tamaños de caso base para el árbol KD
-void experimentLeafSize(const std::vector<DataItem>& database) {
+void experimentLeafSize(const std::vector<DataItem>& database, const IndexConfig& config) {
     std::cout << "\n==== Experimento: Tamaño del Caso Base (Leaf Size) ====\n";
     
     // Definir tamaños de hoja a evaluar
     std::vector<int> leaf_sizes = {1, 5, 10, 20, 50, 100};
     
-    // Archivo para resultados
+    // Archivo para resultados (tiempos en µs por consulta)
     std::ofstream results_file("results/leaf_size_results.csv");
-    results_file << "LeafSize,Mean_Time,StdDev,Min,Max,Median,P90,Memory_KB,Build_Time_ms\n";
+    results_file << "LeafSize,Mean_Time,StdDev,Min,Max,Median,P90,Memory_KB,Build_Time_ms,CI95,Cold_Mean,"
+                 << "Build_RSS_KB,Build_Peak_KB," << kSearchStatsColumns << "\n";
     
-    // Generar consultas para el experimento
+    // Consultas con semilla fija; misma metodología que experimentDatabaseSize
     const int num_queries = 100;
-    const int num_runs = 10; // número de ejecuciones para medir variabilidad
+    const BenchOptions warm(30, 3, 200.0);
+    const BenchOptions cold(num_queries, 0, 0.0, true);
+    CacheFlusher flusher;
+    std::vector<BenchStats> bench;
     
     std::vector<Point> queries = generateQueries(database, num_queries);
     
@@ -205,115 +266,1203 @@ void experimentLeafSize(const std::vector<DataItem>& database) {
         std::cout << "Evaluando tamaño de caso base (leaf size) " << leaf_size << "..." << std::endl;
         
         // Construir árbol KD con el tamaño de hoja específico
+        PhaseMemory build_memory;
         auto build_start = std::chrono::high_resolution_clock::now();
-        KDTree tree(database, leaf_size);  // Asumimos que KDTree acepta leaf_size como segundo parámetro
+        KDTree tree(database, treeOptions(config, leaf_size));
         auto build_end = std::chrono::high_resolution_clock::now();
+        build_memory.end();
         auto build_time = std::chrono::duration_cast<std::chrono::milliseconds>(build_end - build_start).count();
         
         // Medir memoria
-        size_t memory = estimateMemoryUsage(tree);
+        size_t memory = tree.memoryUsage().total() / 1024;
         
-        std::cout << "  Árbol KD construido en " << build_time << " ms (memoria estimada: " 
-                  << memory << " KB)" << std::endl;
+        std::cout << "  Árbol KD construido en " << build_time << " ms (memoria: " 
+                  << memory << " KB, pico de construcción: " << build_memory.peak_delta / 1024
+                  << " KB)" << std::endl;
         
-        // Vector para almacenar tiempos
-        std::vector<double> times;
+        std::string label = "leaf/" + std::to_string(leaf_size);
+        auto op = [&](long long i) { doNotOptimize(tree.nearest(queries[i % num_queries])); };
+        threadSearchStats().reset();
+        BenchStats stats = runBenchmark(label, op, warm);
+        SearchStats counters = threadSearchStats();
+        BenchStats stats_cold = runBenchmark(label, op, cold, &flusher);
+        bench.push_back(stats);
+        bench.push_back(stats_cold);
         
-        // Para cada consulta
-        for (int q = 0; q < num_queries; q++) {
-            const auto& query = queries[q];
+        // Guardar resultados
+        const double us = 1e-3;
+        results_file << leaf_size << "," 
+                    << stats.mean * us << "," << stats.stddev * us << "," << stats.min * us << "," << stats.max * us << "," 
+                    << stats.median * us << "," << stats.p90 * us << "," << memory << "," << build_time << ","
+                    << stats.ci95 * us << "," << stats_cold.mean * us << "," << build_memory.rss_delta / 1024 << ","
+                    << build_memory.peak_delta / 1024 << "," << searchStatsFields(counters) << "\n";
+        
+        // Imprimir resultados parciales
+        std::cout << "  Resultados para leaf size " << leaf_size << ":" << std::endl;
+        std::cout << "    Tiempo medio: " << stats.mean * us << " ± " << stats.ci95 * us << " µs (en frío: "
+                  << stats_cold.mean * us << " µs)" << std::endl;
+        std::cout << "    Memoria:      " << memory << " KB" << std::endl;
+        std::cout << "    Build time:   " << build_time << " ms" << std::endl;
+    }
+    
+    results_file.close();
+    writeBenchJson("results/leaf_size_bench.json", bench);
+    std::cout << "Resultados guardados en results/leaf_size_results.csv (muestras en results/leaf_size_bench.json)" << std::endl;
+}
+
+// Experimento de consultas por lotes: compara el bucle serial contra nearestBatch
+// con distintos números de hilos, para cada motor
+void experimentBatch(const std::vector<DataItem>& database, const IndexConfig& config) {
+    std::cout << "\n==== Experimento: Consultas por Lotes ====\n";
+    
+    const int num_queries = 1000;
+    const int k = 5;
+    const int leaf_size = 10;
+    
+    std::vector<Point> queries = generateQueries(database, num_queries);
+    
+    // Hilos a evaluar: potencias de dos hasta el máximo pedido
+    int max_threads = config.threads > 0 ? config.threads : ThreadPool::hardwareThreads();
+    std::vector<int> thread_counts;
+    for (int t = 1; t < max_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(max_threads);
+    
+    std::ofstream results_file("results/batch_results.csv");
+    results_file << "Engine,Threads,Queries,K,Serial_ms,Batch_ms,Serial_QPS,Batch_QPS,Speedup\n";
+    
+    std::vector<std::string> engines = {"kdtree", "linear", "hnsw"};
+    for (const auto& engine : engines) {
+        std::unique_ptr<Index> index = createIndex(engine, config, leaf_size);
+        index->build(database);
+        std::string name = index->name();
+        
+        // Bucle serial de referencia, una consulta a la vez
+        auto serial_start = std::chrono::high_resolution_clock::now();
+        for (const auto& query : queries) {
+            index->kNearest(query, k);
+        }
+        auto serial_end = std::chrono::high_resolution_clock::now();
+        double serial_ms = std::chrono::duration<double, std::milli>(serial_end - serial_start).count();
+        
+        for (int threads : thread_counts) {
+            auto batch_start = std::chrono::high_resolution_clock::now();
+            index->nearestBatch(queries, k, threads);
+            auto batch_end = std::chrono::high_resolution_clock::now();
+            double batch_ms = std::chrono::duration<double, std::milli>(batch_end - batch_start).count();
+            
+            double serial_qps = num_queries / (serial_ms / 1000.0);
+            double batch_qps = num_queries / (batch_ms / 1000.0);
+            double speedup = serial_ms / batch_ms;
             
-            // Vector de tiempos para múltiples ejecuciones
-            std::vector<double> times_run;
+            results_file << name << "," << threads << "," << num_queries << "," << k << ","
+                        << serial_ms << "," << batch_ms << "," << serial_qps << "," << batch_qps << ","
+                        << speedup << "\n";
             
-            // Realizar múltiples ejecuciones
-            for (int run = 0; run < num_runs; run++) {
-                // Medir tiempo para árbol KD
+            std::cout << "  " << name << " (" << threads << " hilos): serial " << serial_ms
+                      << " ms, lote " << batch_ms << " ms, " << batch_qps << " consultas/s, speedup "
+                      << speedup << "x" << std::endl;
+        }
+    }
+    
+    results_file.close();
+    std::cout << "Resultados guardados en results/batch_results.csv" << std::endl;
+}
+
+// Experimento de búsqueda aproximada: barrido de max_checks y epsilon midiendo
+// tiempo y recall de cada consulta contra la respuesta exacta
+void experimentApproximate(const std::vector<DataItem>& database, const IndexConfig& config) {
+    std::cout << "\n==== Experimento: Búsqueda Aproximada (best-bin-first) ====\n";
+    
+    const int num_queries = 100;
+    const int num_runs = 10;
+    const int k = 10;
+    const int leaf_size = 10;
+    
+    std::vector<int> max_checks_values = {1, 2, 4, 8, 16, 32, 64, 0}; // 0 = sin límite
+    std::vector<double> epsilon_values = {0.0, 0.5, 1.0};
+    
+    std::vector<Point> queries = generateQueries(database, num_queries);
+    KDTree tree(database, treeOptions(config, leaf_size));
+    
+    // Respuestas y tiempos exactos de referencia
+    std::vector<std::vector<Neighbor>> exact(num_queries);
+    double exact_total = 0.0;
+    for (int q = 0; q < num_queries; q++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int run = 0; run < num_runs; run++) {
+            exact[q] = tree.kNearest(queries[q], k);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        exact_total += std::chrono::duration<double, std::micro>(end - start).count() / num_runs;
+    }
+    double exact_mean = exact_total / num_queries;
+    
+    std::ofstream results_file("results/approx_results.csv");
+    results_file << "MaxChecks,Epsilon,Mean_Time,Median,P90,Recall_Mean,Recall_Min,Speedup,"
+                 << kSearchStatsColumns << "\n";
+    std::ofstream queries_file("results/approx_queries.csv");
+    queries_file << "MaxChecks,Epsilon,Query,Time_us,Recall\n";
+    
+    for (double epsilon : epsilon_values) {
+        for (int max_checks : max_checks_values) {
+            SearchParams params(max_checks, epsilon);
+            std::vector<double> times;
+            std::vector<double> recalls;
+            threadSearchStats().reset();
+            
+            for (int q = 0; q < num_queries; q++) {
+                std::vector<Neighbor> result;
                 auto start = std::chrono::high_resolution_clock::now();
-                auto result = tree.nearest(query);
+                for (int run = 0; run < num_runs; run++) {
+                    result = tree.kNearest(queries[q], k, params);
+                }
                 auto end = std::chrono::high_resolution_clock::now();
-                auto time = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
-                times_run.push_back(time);
+                double time = std::chrono::duration<double, std::micro>(end - start).count() / num_runs;
+                double recall = computeRecall(result, exact[q]);
+                
+                times.push_back(time);
+                recalls.push_back(recall);
+                queries_file << max_checks << "," << epsilon << "," << q << "," << time << "," << recall << "\n";
             }
             
-            // Calcular estadísticas para esta consulta (promedio de ejecuciones)
-            double avg = std::accumulate(times_run.begin(), times_run.end(), 0.0) / num_runs;
-            times.push_back(avg);
+            double recall_mean = std::accumulate(recalls.begin(), recalls.end(), 0.0) / recalls.size();
+            double recall_min = *std::min_element(recalls.begin(), recalls.end());
+            std::sort(times.begin(), times.end());
+            double mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+            double median = times[times.size() / 2];
+            double p90 = times[static_cast<int>(times.size() * 0.9)];
+            double speedup = exact_mean / mean;
+            
+            results_file << max_checks << "," << epsilon << "," << mean << "," << median << "," << p90 << ","
+                        << recall_mean << "," << recall_min << "," << speedup << ","
+                        << searchStatsFields(threadSearchStats()) << "\n";
+            
+            std::cout << "  max_checks=" << max_checks << " eps=" << epsilon << ": " << mean
+                      << " µs, recall@" << k << " " << recall_mean << " (min " << recall_min
+                      << "), speedup " << speedup << "x" << std::endl;
         }
+    }
+    
+    results_file.close();
+    queries_file.close();
+    std::cout << "Resultados guardados en results/approx_results.csv y results/approx_queries.csv" << std::endl;
+}
+
+// Experimento de KD-forest: número de árboles contra max_checks, con el recall
+// medido contra la búsqueda lineal exacta
+void experimentForest(const std::vector<DataItem>& database, const IndexConfig& config) {
+    std::cout << "\n==== Experimento: KD-Forest aleatorizado ====\n";
+    
+    const int num_queries = 100;
+    const int num_runs = 10;
+    const int k = 10;
+    const int leaf_size = 10;
+    
+    std::vector<int> tree_counts = {1, 2, 4, 8};
+    std::vector<int> max_checks_values = {4, 16, 64, 256};
+    
+    std::vector<Point> queries = generateQueries(database, num_queries);
+    
+    LinearSearch linear(database, config.element_type, config.metric);
+    std::vector<std::vector<Neighbor>> exact(num_queries);
+    for (int q = 0; q < num_queries; q++) {
+        exact[q] = linear.kNearest(queries[q], k);
+    }
+    
+    std::ofstream results_file("results/forest_results.csv");
+    results_file << "Trees,MaxChecks,Mean_Time,Median,P90,Recall_Mean,Recall_Min,Memory_KB,Build_Time_ms,"
+                 << "Build_RSS_KB,Build_Peak_KB," << kSearchStatsColumns << "\n";
+    
+    for (int num_trees : tree_counts) {
+        KDTreeOptions options = treeOptions(config, leaf_size);
         
-        // Calcular estadísticas
-        std::sort(times.begin(), times.end());
-        double mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+        PhaseMemory build_memory;
+        auto build_start = std::chrono::high_resolution_clock::now();
+        KDForest forest(database, num_trees, options);
+        auto build_end = std::chrono::high_resolution_clock::now();
+        build_memory.end();
+        auto build_time = std::chrono::duration_cast<std::chrono::milliseconds>(build_end - build_start).count();
+        size_t memory = forest.memoryUsage().total() / 1024;
+        
+        std::cout << "Bosque de " << num_trees << " árboles construido en " << build_time
+                  << " ms (memoria: " << memory << " KB)" << std::endl;
         
-        double var = 0.0;
-        for (const auto& time : times) {
-            var += (time - mean) * (time - mean);
+        for (int max_checks : max_checks_values) {
+            SearchParams params(max_checks);
+            std::vector<double> times;
+            std::vector<double> recalls;
+            threadSearchStats().reset();
+            
+            for (int q = 0; q < num_queries; q++) {
+                std::vector<Neighbor> result;
+                auto start = std::chrono::high_resolution_clock::now();
+                for (int run = 0; run < num_runs; run++) {
+                    result = forest.kNearest(queries[q], k, params);
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                times.push_back(std::chrono::duration<double, std::micro>(end - start).count() / num_runs);
+                recalls.push_back(computeRecall(result, exact[q]));
+            }
+            
+            double recall_mean = std::accumulate(recalls.begin(), recalls.end(), 0.0) / recalls.size();
+            double recall_min = *std::min_element(recalls.begin(), recalls.end());
+            std::sort(times.begin(), times.end());
+            double mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+            double median = times[times.size() / 2];
+            double p90 = times[static_cast<int>(times.size() * 0.9)];
+            
+            results_file << num_trees << "," << max_checks << "," << mean << "," << median << "," << p90 << ","
+                        << recall_mean << "," << recall_min << "," << memory << "," << build_time << ","
+                        << build_memory.rss_delta / 1024 << "," << build_memory.peak_delta / 1024 << ","
+                        << searchStatsFields(threadSearchStats()) << "\n";
+            
+            std::cout << "  max_checks=" << max_checks << ": " << mean << " µs, recall@" << k << " "
+                      << recall_mean << " (min " << recall_min << ")" << std::endl;
         }
-        var /= times.size();
-        double stddev = std::sqrt(var);
+    }
+    
+    results_file.close();
+    std::cout << "Resultados guardados en results/forest_results.csv" << std::endl;
+}
+
+// Experimento de motores: todos los índices detrás de la misma interfaz, cada
+// uno con su barrido de parámetros de búsqueda, medidos con el mismo código
+// (construcción, memoria, latencia por consulta y recall contra la búsqueda lineal)
+void experimentEngines(const std::vector<DataItem>& database, const IndexConfig& config) {
+    std::cout << "\n==== Experimento: Comparación de Motores ====\n";
+    
+    const int num_queries = 100;
+    const int num_runs = 10;
+    const int k = 10;
+    const int leaf_size = 10;
+    
+    // Motor y configuraciones de búsqueda a evaluar sobre el mismo índice
+    struct EngineRun {
+        std::string engine;
+        std::vector<SearchParams> settings;
+    };
+    std::vector<EngineRun> runs = {
+        {"linear", {SearchParams()}},
+        {"kdtree", {SearchParams(), SearchParams(16), SearchParams(64)}},
+        {"forest", {SearchParams(16), SearchParams(64), SearchParams(256)}},
+        {"hnsw", {SearchParams(0, 0.0, 10), SearchParams(0, 0.0, 20), SearchParams(0, 0.0, 50),
+                  SearchParams(0, 0.0, 100), SearchParams(0, 0.0, 200)}},
+        {"ivfpq", {SearchParams(1), SearchParams(4), SearchParams(16), SearchParams(64)}}
+    };
+    
+    std::vector<Point> queries = generateQueries(database, num_queries);
+    
+    LinearSearch linear(database, config.element_type, config.metric);
+    std::vector<std::vector<Neighbor>> exact(num_queries);
+    for (int q = 0; q < num_queries; q++) {
+        exact[q] = linear.kNearest(queries[q], k);
+    }
+    
+    std::ofstream results_file("results/engines_results.csv");
+    results_file << "Engine,MaxChecks,Epsilon,Ef,Mean_Time,Median,P90,QPS,Recall_Mean,Recall_Min,"
+                 << "Memory_KB,Build_Time_ms," << kMemoryColumns << "," << kSearchStatsColumns << "\n";
+    
+    for (const auto& run : runs) {
+        std::unique_ptr<Index> index = createIndex(run.engine, config, leaf_size);
         
-        double min = times.front();
-        double max = times.back();
-        double median = times[times.size() / 2];
-        double p90 = times[static_cast<int>(times.size() * 0.9)];
+        PhaseMemory build_memory;
+        auto build_start = std::chrono::high_resolution_clock::now();
+        index->build(database);
+        auto build_end = std::chrono::high_resolution_clock::now();
+        build_memory.end();
+        auto build_time = std::chrono::duration_cast<std::chrono::milliseconds>(build_end - build_start).count();
+        size_t memory = index->memoryBytes() / 1024;
         
-        // Guardar resultados
-        results_file << leaf_size << "," 
-                    << mean << "," << stddev << "," << min << "," << max << "," 
-                    << median << "," << p90 << "," << memory << "," << build_time << "\n";
+        std::cout << index->name() << " construido en " << build_time << " ms (memoria: "
+                  << memory << " KB)" << std::endl;
         
-        // Imprimir resultados parciales
-        std::cout << "  Resultados para leaf size " << leaf_size << ":" << std::endl;
-        std::cout << "    Tiempo medio: " << mean << " µs (stddev: " << stddev << " µs)" << std::endl;
-        std::cout << "    Memoria:      " << memory << " KB" << std::endl;
-        std::cout << "    Build time:   " << build_time << " ms" << std::endl;
+        for (const auto& params : run.settings) {
+            std::vector<double> times;
+            std::vector<double> recalls;
+            threadSearchStats().reset();
+            PhaseMemory query_memory;
+            
+            for (int q = 0; q < num_queries; q++) {
+                std::vector<Neighbor> result;
+                auto start = std::chrono::high_resolution_clock::now();
+                for (int r = 0; r < num_runs; r++) {
+                    result = index->kNearest(queries[q], k, params);
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                times.push_back(std::chrono::duration<double, std::micro>(end - start).count() / num_runs);
+                recalls.push_back(computeRecall(result, exact[q]));
+            }
+            query_memory.end();
+            
+            double recall_mean = std::accumulate(recalls.begin(), recalls.end(), 0.0) / recalls.size();
+            double recall_min = *std::min_element(recalls.begin(), recalls.end());
+            std::sort(times.begin(), times.end());
+            double mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+            double median = times[times.size() / 2];
+            double p90 = times[static_cast<int>(times.size() * 0.9)];
+            double qps = 1e6 / mean;
+            
+            results_file << index->name() << "," << params.max_checks << "," << params.epsilon << ","
+                        << params.ef << "," << mean << "," << median << "," << p90 << "," << qps << ","
+                        << recall_mean << "," << recall_min << "," << memory << "," << build_time << ","
+                        << memoryFields(index->memoryUsage(), build_memory, query_memory) << ","
+                        << searchStatsFields(threadSearchStats()) << "\n";
+            
+            std::cout << "  max_checks=" << params.max_checks << " eps=" << params.epsilon
+                      << " ef=" << params.ef << ": " << mean << " µs, recall@" << k << " "
+                      << recall_mean << " (min " << recall_min << ")" << std::endl;
+        }
+    }
+    
+    results_file.close();
+    std::cout << "Resultados guardados en results/engines_results.csv" << std::endl;
+}
+
+// Curvas recall@k vs QPS con consultas de texto que no están en la base (los
+// títulos de un JSONL, ver loadTitlesFromJsonl), en lugar de filas de la base
+// que se encuentran a sí mismas a distancia 0. El ground truth exacto se calcula
+// una vez con la búsqueda lineal y queda en results/ground_truth.bin; después
+// se barren los parámetros de cada motor (leaf_size y max_checks del árbol KD,
+// árboles y max_checks del bosque, ef de HNSW, listas revisadas de IVF-PQ en
+// max_checks), midiendo cada consulta por
+// separado para reportar p50 y p99 además del throughput de un hilo.
+void experimentRecall(const MappedDatabase& database, const IndexConfig& config, const std::string& queries_file) {
+    std::cout << "\n==== Experimento: Recall vs QPS (consultas de texto) ====\n";
+    
+    const int num_queries = 200;
+    const int passes = 3; // Pasadas cronometradas sobre las consultas (después de una de calentamiento)
+    const int k = 10;
+    
+    std::vector<std::string> titles = loadTitlesFromJsonl(queries_file, num_queries, database.getProcessedLines());
+    if (titles.empty() || database.getDimensions() != embedder.getDimension()) {
+        std::cerr << "No hay consultas de texto compatibles con la base en " << queries_file << std::endl;
+        return;
+    }
+    std::vector<Point> queries(titles.size());
+    for (size_t q = 0; q < titles.size(); q++) {
+        embedder.getEmbedding(titles[q], queries[q]);
+    }
+    std::cout << queries.size() << " consultas tomadas de " << queries_file << std::endl;
+    
+    bool from_cache = false;
+    auto truth_start = std::chrono::high_resolution_clock::now();
+    GroundTruth truth = cachedGroundTruth("results/ground_truth.bin", database, queries, k, config.threads, &from_cache,
+                                           config.metric);
+    auto truth_end = std::chrono::high_resolution_clock::now();
+    std::cout << "Ground truth " << (from_cache ? "cargado de" : "calculado y guardado en")
+              << " results/ground_truth.bin ("
+              << std::chrono::duration_cast<std::chrono::milliseconds>(truth_end - truth_start).count() << " ms)"
+              << std::endl;
+    
+    // Puntos del barrido: motor, parámetros de construcción y de búsqueda
+    struct SweepPoint {
+        std::string engine;
+        int leaf_size;
+        int trees;
+        std::vector<SearchParams> settings;
+    };
+    std::vector<SweepPoint> sweep;
+    sweep.push_back({"linear", config.leaf_size, 0, {SearchParams()}});
+    for (int leaf_size : {5, 10, 20, 50}) {
+        sweep.push_back({"kdtree", leaf_size, 1,
+                         {SearchParams(), SearchParams(16), SearchParams(64), SearchParams(256), SearchParams(1024)}});
+    }
+    for (int trees : {1, 2, 4, 8}) {
+        sweep.push_back({"forest", config.leaf_size, trees,
+                         {SearchParams(16), SearchParams(64), SearchParams(256), SearchParams(1024)}});
+    }
+    sweep.push_back({"hnsw", config.leaf_size, 0,
+                     {SearchParams(0, 0.0, 10), SearchParams(0, 0.0, 20), SearchParams(0, 0.0, 50),
+                      SearchParams(0, 0.0, 100), SearchParams(0, 0.0, 200)}});
+    sweep.push_back({"ivfpq", config.leaf_size, 0,
+                     {SearchParams(1), SearchParams(4), SearchParams(16), SearchParams(64), SearchParams(256)}});
+    
+    std::ofstream results_file("results/recall_qps.csv");
+    results_file << "Engine,LeafSize,Trees,MaxChecks,Epsilon,Ef,Recall_Mean,Recall_Min,QPS,Mean_us,P50_us,P99_us,"
+                 << "Memory_KB,Build_Time_ms," << kMemoryColumns << "," << kSearchStatsColumns << "\n";
+    
+    for (const auto& point : sweep) {
+        IndexConfig engine_config = config;
+        engine_config.forest_trees = point.trees;
+        std::unique_ptr<Index> index = createIndex(point.engine, engine_config, point.leaf_size);
+        
+        PhaseMemory build_memory;
+        auto build_start = std::chrono::high_resolution_clock::now();
+        index->build(database);
+        auto build_end = std::chrono::high_resolution_clock::now();
+        build_memory.end();
+        auto build_time = std::chrono::duration_cast<std::chrono::milliseconds>(build_end - build_start).count();
+        size_t memory = index->memoryBytes() / 1024;
+        
+        std::cout << index->name();
+        if (point.trees > 0) {
+            std::cout << " (leaf_size = " << point.leaf_size << ", árboles = " << point.trees << ")";
+        }
+        std::cout << " construido en " << build_time << " ms (memoria: " << memory << " KB)" << std::endl;
+        
+        for (const auto& params : point.settings) {
+            std::vector<double> recalls(queries.size());
+            std::vector<double> latencies;
+            threadSearchStats().reset();
+            PhaseMemory query_memory;
+            for (int pass = 0; pass <= passes; pass++) {
+                for (size_t q = 0; q < queries.size(); q++) {
+                    uint64_t start = nowNanos();
+                    std::vector<Neighbor> result = index->kNearest(queries[q], k, params);
+                    uint64_t elapsed = nowNanos() - start;
+                    if (pass > 0) {
+                        latencies.push_back(static_cast<double>(elapsed));
+                    } else {
+                        recalls[q] = computeRecall(result, truth.neighbors[q]);
+                    }
+                }
+            }
+            query_memory.end();
+            
+            BenchStats stats = summarizeBench(index->name(), latencies, 1, false);
+            double recall_mean = std::accumulate(recalls.begin(), recalls.end(), 0.0) / recalls.size();
+            double recall_min = *std::min_element(recalls.begin(), recalls.end());
+            double qps = stats.mean > 0 ? 1e9 / stats.mean : 0.0;
+            
+            const double us = 1e-3;
+            results_file << index->name() << "," << point.leaf_size << "," << point.trees << ","
+                        << params.max_checks << "," << params.epsilon << "," << params.ef << ","
+                        << recall_mean << "," << recall_min << "," << qps << "," << stats.mean * us << ","
+                        << stats.median * us << "," << stats.p99 * us << "," << memory << "," << build_time << ","
+                        << memoryFields(index->memoryUsage(), build_memory, query_memory) << ","
+                        << searchStatsFields(threadSearchStats()) << "\n";
+            
+            std::cout << "  max_checks=" << params.max_checks << " ef=" << params.ef << ": recall@" << k << " "
+                      << recall_mean << " (min " << recall_min << "), " << qps << " QPS, p50 "
+                      << stats.median * us << " µs, p99 " << stats.p99 * us << " µs" << std::endl;
+        }
+    }
+    
+    results_file.close();
+    std::cout << "Resultados guardados en results/recall_qps.csv" << std::endl;
+}
+
+// Búsqueda repartida en shards (ver shard.h) con las mismas consultas de texto
+// y el mismo ground truth que experimentRecall: shards locales con reparto por
+// hash (se visitan todos) y por k-means (solo los `probe` más cercanos), y si
+// hay coordinador (--coordinator), los shards remotos con distintos límites de
+// espera por shard. Cada punto reporta recall@k, latencia de un hilo, el
+// tamaño del shard más grande y los shards que no respondieron a tiempo.
+void experimentShards(const MappedDatabase& database, const IndexConfig& config, const std::string& queries_file) {
+    std::cout << "\n==== Experimento: Índice Repartido en Shards ====\n";
+    
+    const int num_queries = 200;
+    const int passes = 3; // Pasadas cronometradas sobre las consultas (después de una de calentamiento)
+    const int k = 10;
+    
+    std::vector<std::string> titles = loadTitlesFromJsonl(queries_file, num_queries, database.getProcessedLines());
+    if (titles.empty() || database.getDimensions() != embedder.getDimension()) {
+        std::cerr << "No hay consultas de texto compatibles con la base en " << queries_file << std::endl;
+        return;
+    }
+    std::vector<Point> queries(titles.size());
+    for (size_t q = 0; q < titles.size(); q++) {
+        embedder.getEmbedding(titles[q], queries[q]);
+    }
+    std::cout << queries.size() << " consultas tomadas de " << queries_file << std::endl;
+    
+    bool from_cache = false;
+    GroundTruth truth = cachedGroundTruth("results/ground_truth.bin", database, queries, k, config.threads, &from_cache,
+                                           config.metric);
+    std::cout << "Ground truth " << (from_cache ? "cargado de" : "calculado y guardado en")
+              << " results/ground_truth.bin" << std::endl;
+    
+    std::ofstream results_file("results/shard_results.csv");
+    results_file << "Mode,Shards,Routing,Probe,Timeout_ms,Largest_Shard,Build_ms,Recall_Mean,QPS,Mean_us,P50_us,"
+                 << "P99_us,Timeouts,Failures\n";
+    
+    // Medir `index` con su probe y límite actuales
+    auto measure = [&](ShardedIndex& index, const std::string& mode, long long build_time) {
+        const ShardMap& map = index.getMap();
+        size_t largest = 0;
+        for (int s = 0; s < map.shardCount(); s++) {
+            largest = std::max(largest, map.shardMembers(s).size());
+        }
+        long long timeouts_start = index.getTimeouts();
+        long long failures_start = index.getFailures();
+        std::vector<double> recalls(queries.size());
+        std::vector<double> latencies;
+        for (int pass = 0; pass <= passes; pass++) {
+            for (size_t q = 0; q < queries.size(); q++) {
+                uint64_t start = nowNanos();
+                std::vector<Neighbor> result = index.kNearest(queries[q], k, config.search);
+                uint64_t elapsed = nowNanos() - start;
+                if (pass > 0) {
+                    latencies.push_back(static_cast<double>(elapsed));
+                }
+                if (pass == passes) {
+                    recalls[q] = computeRecall(result, truth.neighbors[q]);
+                }
+            }
+        }
+        long long timeouts = index.getTimeouts() - timeouts_start;
+        long long failures = index.getFailures() - failures_start;
+        
+        BenchStats stats = summarizeBench(index.name(), latencies, 1, false);
+        double recall_mean = std::accumulate(recalls.begin(), recalls.end(), 0.0) / recalls.size();
+        double qps = stats.mean > 0 ? 1e9 / stats.mean : 0.0;
+        const ShardOptions& options = index.getOptions();
+        int probe = options.routing == ShardRouting::KMeans ? options.probe : 0;
+        
+        const double us = 1e-3;
+        results_file << mode << "," << map.shardCount() << "," << shardRoutingName(options.routing) << "," << probe
+                     << "," << options.timeout_ms << "," << largest << "," << build_time << "," << recall_mean << ","
+                     << qps << "," << stats.mean * us << "," << stats.median * us << "," << stats.p99 * us << ","
+                     << timeouts << "," << failures << "\n";
+        
+        std::cout << "  " << map.shardCount() << " shards " << shardRoutingName(options.routing);
+        if (probe > 0) {
+            std::cout << " (probe " << probe << ")";
+        }
+        if (options.timeout_ms > 0) {
+            std::cout << ", límite " << options.timeout_ms << " ms";
+        }
+        std::cout << ": recall@" << k << " " << recall_mean << ", " << qps << " QPS, p50 " << stats.median * us
+                  << " µs, p99 " << stats.p99 * us << " µs";
+        if (timeouts + failures > 0) {
+            std::cout << " (" << timeouts << " sin respuesta a tiempo, " << failures << " fallas)";
+        }
+        std::cout << std::endl;
+    };
+    
+    // Shards locales: mismo motor por shard, el reparto cambia
+    std::string shard_engine = config.shard.engine == "sharded" ? "kdtree" : config.shard.engine;
+    std::cout << "Shards locales con " << shard_engine << std::endl;
+    for (int shards : {1, 2, 4, 8}) {
+        for (ShardRouting routing : {ShardRouting::Hash, ShardRouting::KMeans}) {
+            if (shards == 1 && routing == ShardRouting::KMeans) {
+                continue;
+            }
+            ShardOptions options = config.shard;
+            options.shards = shards;
+            options.routing = routing;
+            options.timeout_ms = 0;
+            ShardedIndex index(options, [&config, &shard_engine]() {
+                return createIndex(shard_engine, config, config.leaf_size);
+            });
+            auto build_start = std::chrono::high_resolution_clock::now();
+            index.build(database);
+            auto build_end = std::chrono::high_resolution_clock::now();
+            long long build_time = std::chrono::duration_cast<std::chrono::milliseconds>(build_end - build_start).count();
+            
+            if (routing == ShardRouting::Hash) {
+                measure(index, "local", build_time);
+                continue;
+            }
+            // Con k-means: los 1 y 2 shards más cercanos, y todos
+            for (int probe : {1, 2, 0}) {
+                if (probe >= shards) {
+                    continue;
+                }
+                index.setProbe(probe);
+                measure(index, "local", build_time);
+            }
+        }
+    }
+    
+#ifdef KDTREE_WITH_HTTP
+    // Shards remotos: el reparto de --coordinator con límites de espera cada vez más cortos
+    if (!config.shard_urls.empty()) {
+        std::unique_ptr<ShardedIndex> remote = connectShards(config.shard_map, config.shard_urls, config.shard);
+        if (!remote) {
+            std::cerr << "No se pudo conectar con los shards remotos" << std::endl;
+        } else if (remote->size() != database.size()) {
+            std::cerr << "El reparto " << config.shard_map << " no corresponde a la base (" << remote->size()
+                      << " documentos, la base tiene " << database.size() << ")" << std::endl;
+        } else {
+            std::cout << "Shards remotos: " << config.shard_urls.size() << " servidores" << std::endl;
+            std::vector<int> probes(1, remote->getOptions().probe);
+            if (remote->getOptions().routing == ShardRouting::KMeans && remote->getOptions().probe != 0) {
+                probes.push_back(0);
+            }
+            for (int probe : probes) {
+                remote->setProbe(probe);
+                for (int timeout_ms : {0, 50, 5, 1}) {
+                    remote->setTimeout(timeout_ms);
+                    measure(*remote, "remoto", 0);
+                }
+            }
+        }
     }
+#endif
     
     results_file.close();
-    std::cout << "Resultados guardados en results/leaf_size_results.csv" << std::endl;
+    std::cout << "Resultados guardados en results/shard_results.csv" << std::endl;
 }
 
 // Prueba estadística para determinar si hay diferencias significativas
+// (t de Welch de dos colas al 5%, ver benchmark.h)
 bool areSignificantlyDifferent(const std::vector<double>& times1, const std::vector<double>& times2) {
-    // Implementación simple: comparar medias y desviaciones estándar
-    // En una implementación completa, se debería usar una prueba t o similar
+    return welchTest(times1, times2).significant();
+}
+
+// Inserciones y borrados en línea: el índice dinámico parte de la mitad de la
+// base e inserta el resto mientras un hilo lector consulta sin parar, borrando
+// un documento de cada diez insertados. En cada décimo del recorrido se mide el
+// costo por inserción, la latencia de las consultas concurrentes y los
+// segmentos, y se compara el resultado con la búsqueda lineal sobre los vivos.
+void experimentDynamic(const std::vector<DataItem>& database, const IndexConfig& config) {
+    std::cout << "\n==== Experimento: Índice Dinámico (inserciones y borrados) ====\n";
+    
+    const int num_queries = 50;
+    const int k = 10;
+    const int checkpoints = 10;
+    int initial = static_cast<int>(database.size()) / 2;
+    
+    std::vector<DataItem> base(database.begin(), database.begin() + initial);
+    DynamicKDTreeOptions options(treeOptions(config, config.leaf_size));
+    DynamicKDTree tree(base, options);
+    std::vector<Point> queries = generateQueries(database, num_queries);
+    
+    // Lector concurrente: consultas contra la instantánea vigente
+    std::atomic<bool> done(false);
+    std::atomic<long long> query_count(0);
+    std::atomic<long long> query_nanos(0); // En ns: una consulta suele tardar menos de 1 µs
+    std::thread reader([&]() {
+        KDSearchContext context;
+        std::vector<Neighbor> result;
+        int q = 0;
+        while (!done) {
+            uint64_t start = nowNanos();
+            tree.kNearest(queries[q], k, SearchParams(), context, result);
+            query_nanos += static_cast<long long>(nowNanos() - start);
+            query_count++;
+            q = (q + 1) % num_queries;
+            std::this_thread::yield();
+        }
+    });
+    
+    std::mt19937 rng(7);
+    std::vector<bool> alive(database.size(), false);
+    std::fill(alive.begin(), alive.begin() + initial, true);
+    int deleted = 0;
+    
+    std::ofstream results_file("results/dynamic_results.csv");
+    results_file << "Inserted,Deleted,Live,Segments,Rebuilds,Insert_Mean_us,Query_Mean_us,Concurrent_Queries,"
+                 << "Mismatches\n";
+    
+    int inserts = static_cast<int>(database.size()) - initial;
+    int step = std::max(1, inserts / checkpoints);
+    int mismatches_total = 0;
+    for (int begin = initial; begin < static_cast<int>(database.size()); begin += step) {
+        int end = std::min(static_cast<int>(database.size()), begin + step);
+        long long queries_before = query_count;
+        long long nanos_before = query_nanos;
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = begin; i < end; i++) {
+            // Los ids crecen junto con las posiciones de la base
+            alive[tree.insert(database[i])] = true;
+            if ((i - initial) % 10 == 9) {
+                std::uniform_int_distribution<int> pick(0, i);
+                int victim = pick(rng);
+                if (tree.remove(victim)) {
+                    alive[victim] = false;
+                    deleted++;
+                }
+            }
+        }
+        auto finish = std::chrono::high_resolution_clock::now();
+        double insert_us = std::chrono::duration<double, std::micro>(finish - start).count() / (end - begin);
+        // Si el lector no alcanzó a consultar durante las inserciones (p. ej. con
+        // un solo núcleo) la latencia queda vacía en el CSV, no en 0
+        long long checkpoint_queries = query_count - queries_before;
+        double query_us = checkpoint_queries > 0 ?
+            1e-3 * static_cast<double>(query_nanos - nanos_before) / checkpoint_queries : 0.0;
+        
+        // Exactitud sobre la instantánea actual contra la búsqueda lineal de los vivos
+        std::shared_ptr<const DynamicKDTree::Snapshot> snapshot = tree.snapshot();
+        std::vector<DataItem> live;
+        for (int id = 0; id < end; id++) {
+            if (alive[id]) {
+                live.push_back(database[id]);
+            }
+        }
+        LinearSearch linear(live, config.element_type, config.metric);
+        int mismatches = 0;
+        for (int q = 0; q < num_queries; q++) {
+            std::vector<Neighbor> expected = linear.kNearest(queries[q], k);
+            std::vector<Neighbor> got = snapshot->kNearest(queries[q], k);
+            if (expected.size() != got.size()) {
+                mismatches++;
+                continue;
+            }
+            // Con empates los ids pueden diferir: se comparan las distancias
+            for (size_t r = 0; r < got.size(); r++) {
+                if (std::abs(got[r].first - expected[r].first) > 1e-6 || !alive[got[r].second]) {
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+        mismatches_total += mismatches;
+        
+        results_file << end - initial << "," << deleted << "," << snapshot->size() << ","
+                     << snapshot->getSegmentCount() << "," << tree.getRebuildCount() << ","
+                     << insert_us << ",";
+        if (checkpoint_queries > 0) {
+            results_file << query_us;
+        }
+        results_file << "," << checkpoint_queries << "," << mismatches << "\n";
+        std::cout << "Insertados " << end - initial << ", borrados " << deleted << ": "
+                  << snapshot->getSegmentCount() << " segmentos, " << insert_us << " µs por inserción, ";
+        if (checkpoint_queries > 0) {
+            std::cout << query_us << " µs por consulta concurrente (" << checkpoint_queries << " consultas), ";
+        } else {
+            std::cout << "sin consultas concurrentes, ";
+        }
+        std::cout << mismatches << " consultas distintas de la lineal" << std::endl;
+    }
+    
+    done = true;
+    reader.join();
+    results_file.close();
+    
+    // Referencia: reconstruir todo el árbol sobre los vivos
+    std::vector<DataItem> live;
+    for (int id = 0; id < static_cast<int>(database.size()); id++) {
+        if (alive[id]) {
+            live.push_back(database[id]);
+        }
+    }
+    auto rebuild_start = std::chrono::high_resolution_clock::now();
+    KDTree rebuilt(live, treeOptions(config, config.leaf_size));
+    auto rebuild_end = std::chrono::high_resolution_clock::now();
+    double rebuild_ms = std::chrono::duration<double, std::milli>(rebuild_end - rebuild_start).count();
+    
+    std::cout << tree.getRebuildCount() << " segmentos reconstruidos (" << tree.getRebuiltPoints()
+              << " puntos); reconstruir el árbol completo toma " << rebuild_ms << " ms" << std::endl;
+    std::cout << (mismatches_total == 0 ? "Todas las consultas coinciden con la búsqueda lineal" :
+                  "Hay consultas que no coinciden con la búsqueda lineal") << std::endl;
+    std::cout << "Resultados guardados en results/dynamic_results.csv" << std::endl;
+}
+
+// Detección de casi duplicados: para cada documento, radiusSearch en el KD-tree
+// devuelve los que están a distancia <= radius; se guardan los pares (a < b)
+void experimentDuplicates(const std::vector<DataItem>& database, const IndexConfig& config, double radius) {
+    std::cout << "\n==== Experimento: Casi duplicados (radio " << radius << ") ====\n";
+    
+    KDTree tree(database, treeOptions(config, config.leaf_size));
+    KDSearchContext context;
+    std::vector<Neighbor> neighbors;
+    std::vector<std::pair<int, Neighbor>> pairs;
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int a = 0; a < static_cast<int>(database.size()); a++) {
+        tree.radiusSearch(database[a].embedding, radius, context, neighbors);
+        for (const auto& neighbor : neighbors) {
+            if (neighbor.second > a) {
+                pairs.push_back(std::make_pair(a, neighbor));
+            }
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double total_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    
+    std::ofstream results_file("results/duplicates.csv");
+    results_file << "Id_A,Id_B,Distance\n";
+    for (const auto& pair : pairs) {
+        results_file << pair.first << "," << pair.second.second << "," << pair.second.first << "\n";
+    }
+    results_file.close();
+    
+    std::cout << pairs.size() << " pares a distancia <= " << radius << " entre " << database.size()
+              << " documentos (" << total_ms << " ms, " << total_ms * 1000.0 / std::max<size_t>(1, database.size())
+              << " µs por consulta)" << std::endl;
+    for (size_t i = 0; i < pairs.size() && i < 3; i++) {
+        std::cout << "  " << pairs[i].first << " ~ " << pairs[i].second.second << " (distancia "
+                  << pairs[i].second.first << "): " << database[pairs[i].first].text.substr(0, 80) << std::endl;
+    }
+    std::cout << "Resultados guardados en results/duplicates.csv" << std::endl;
+}
+
+// Construir el motor del modo interactivo o del servicio sobre la base
+// (mapeada si la hay, sin copiarla)
+std::shared_ptr<const Index> buildServingIndex(const std::vector<DataItem>& database, const MappedDatabase* mapped,
+                                               const IndexConfig& config) {
+#ifdef KDTREE_WITH_HTTP
+    // Coordinador: los shards ya están construidos en sus servidores
+    if (!config.shard_urls.empty()) {
+        return std::shared_ptr<const Index>(connectShards(config.shard_map, config.shard_urls, config.shard).release());
+    }
+#endif
+    std::shared_ptr<Index> index(createIndex(config.engine, config, config.leaf_size).release());
+    if (mapped) {
+        index->build(*mapped);
+    } else {
+        index->build(database);
+    }
+    return index;
+}
+
+// Servicio concurrente: las consultas de la entrada estándar (una por línea) se
+// responden con `threads` trabajadores sin esperar a que termine la anterior, y
+// las respuestas se imprimen en el orden de entrada. "recargar" reconstruye el
+// índice en segundo plano y lo publica sin detener el servicio.
+void serveMode(const std::vector<DataItem>& database, const MappedDatabase* mapped, const IndexConfig& config,
+               int threads) {
+    std::cout << "\n==== Servicio de Consultas Concurrente ====\n";
+    
+    auto build_start = std::chrono::high_resolution_clock::now();
+    std::shared_ptr<const Index> index = buildServingIndex(database, mapped, config);
+    auto build_end = std::chrono::high_resolution_clock::now();
+    if (!index) {
+        return;
+    }
+    std::cout << index->name() << " construido en "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(build_end - build_start).count()
+              << " ms sobre " << index->size() << " documentos" << std::endl;
+    
+    SearchService service(embedder, index, threads, config.search, 0, config.cache_entries);
+    index.reset();
+    std::cout << "Atendiendo con " << service.getThreadCount() << " hilos; una consulta por línea, "
+              << "'recargar' publica un índice reconstruido y 'salir' termina" << std::endl;
+    
+    // Las respuestas se imprimen en orden mientras los trabajadores siguen con las siguientes
+    typedef std::pair<std::string, std::future<SearchResponse>> Pending;
+    BoundedQueue<std::shared_ptr<Pending>> pending(1024);
+    std::thread printer([&]() {
+        std::shared_ptr<Pending> next;
+        while (pending.pop(next)) {
+            SearchResponse response = next->second.get();
+            std::cout << "[v" << response.generation << "] \"" << next->first << "\" (embedding: "
+                      << response.embed_us << " µs, búsqueda: " << response.search_us << " µs"
+                      << (response.cached ? ", caché" : "") << ")\n";
+            for (size_t i = 0; i < response.neighbors.size(); i++) {
+                std::cout << "  " << (i + 1) << ". " << response.neighbors[i].first << "  "
+                          << response.texts[i].substr(0, 100) << "\n";
+            }
+            std::cout << std::flush;
+        }
+    });
+    
+    std::thread rebuilder;
+    std::atomic<bool> rebuilding(false);
+    auto start = std::chrono::high_resolution_clock::now();
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line == "salir" || line == "exit" || line == "q") {
+            break;
+        }
+        if (line.empty()) {
+            continue;
+        }
+        if (line == "recargar") {
+            if (rebuilding) {
+                std::cout << "Ya hay una reconstrucción en curso" << std::endl;
+                continue;
+            }
+            if (rebuilder.joinable()) {
+                rebuilder.join();
+            }
+            rebuilding = true;
+            rebuilder = std::thread([&]() {
+                auto rebuild_start = std::chrono::high_resolution_clock::now();
+                std::shared_ptr<const Index> rebuilt = buildServingIndex(database, mapped, config);
+                if (rebuilt) {
+                    long long generation = service.publish(rebuilt);
+                    auto rebuild_end = std::chrono::high_resolution_clock::now();
+                    std::cout << "Índice reconstruido y publicado (v" << generation << ") en "
+                              << std::chrono::duration_cast<std::chrono::milliseconds>(rebuild_end - rebuild_start).count()
+                              << " ms" << std::endl;
+                }
+                rebuilding = false;
+            });
+            continue;
+        }
+        std::shared_ptr<Pending> request = std::make_shared<Pending>(line, service.submit(line, 5));
+        pending.push(request);
+    }
+    
+    pending.close();
+    printer.join();
+    if (rebuilder.joinable()) {
+        rebuilder.join();
+    }
+    service.stop();
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << service.getAnswered() << " consultas respondidas en " << seconds << " s ("
+              << service.getAnswered() / std::max(seconds, 1e-9) << " consultas/s)" << std::endl;
+    if (service.getCache()) {
+        std::cout << "Caché de consultas: " << service.getCache()->getHits() << " aciertos, "
+                  << service.getCache()->getMisses() << " fallos" << std::endl;
+    }
+}
+
+// Carga concurrente sobre el servicio: clientes en lazo cerrado (cada uno
+// envía la consulta siguiente al recibir la respuesta) contra 1..8
+// trabajadores, mientras otro hilo reconstruye el índice y lo publica cada
+// 200 ms. Mide el rendimiento y la latencia, cuenta las versiones del índice
+// que ven las respuestas y verifica que los índices reemplazados se liberen.
+void experimentServe(const std::vector<DataItem>& database, const IndexConfig& config) {
+    std::cout << "\n==== Experimento: Servicio Concurrente con Intercambio de Índice ====\n";
+    
+    const double duration_s = 1.0;
+    const int swap_every_ms = 200;
+    std::vector<int> worker_counts = {1, 2, 4, 8};
+    
+    // Consultas de texto: el comienzo de documentos de la base
+    std::vector<std::string> queries;
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> pick(0, static_cast<int>(database.size()) - 1);
+    for (int i = 0; i < 200; i++) {
+        queries.push_back(database[pick(rng)].text.substr(0, 60));
+    }
+    
+    std::ofstream results_file("results/serve_results.csv");
+    results_file << "Workers,Clients,Queries,QPS,Mean_us,P50_us,P99_us,Swaps,Generations_Seen,Failures,Reclaimed\n";
+    
+    for (int workers : worker_counts) {
+        std::shared_ptr<const Index> first = buildServingIndex(database, nullptr, config);
+        std::weak_ptr<const Index> first_alive = first;
+        SearchService service(embedder, first, workers, config.search);
+        first.reset();
+        
+        int clients = 2 * workers;
+        std::atomic<bool> done(false);
+        std::vector<std::vector<double>> latencies(clients);
+        std::vector<long long> min_generation(clients, std::numeric_limits<long long>::max());
+        std::vector<long long> max_generation(clients, 0);
+        std::atomic<int> failures(0);
+        
+        std::vector<std::thread> client_threads;
+        for (int c = 0; c < clients; c++) {
+            client_threads.push_back(std::thread([&, c]() {
+                size_t q = c;
+                while (!done) {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    SearchResponse response = service.submit(queries[q % queries.size()], 10).get();
+                    auto end = std::chrono::high_resolution_clock::now();
+                    latencies[c].push_back(std::chrono::duration<double, std::micro>(end - start).count());
+                    if (response.generation < 0 || response.neighbors.empty()) {
+                        failures++;
+                    } else {
+                        min_generation[c] = std::min(min_generation[c], response.generation);
+                        max_generation[c] = std::max(max_generation[c], response.generation);
+                    }
+                    q += clients;
+                }
+            }));
+        }
+        
+        // Reconstruir y publicar mientras los clientes consultan
+        int swaps = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        auto next_swap = start + std::chrono::milliseconds(swap_every_ms);
+        while (std::chrono::high_resolution_clock::now() - start < std::chrono::duration<double>(duration_s)) {
+            std::this_thread::sleep_until(next_swap);
+            service.publish(buildServingIndex(database, nullptr, config));
+            swaps++;
+            next_swap += std::chrono::milliseconds(swap_every_ms);
+        }
+        done = true;
+        for (auto& thread : client_threads) {
+            thread.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        service.stop();
+        
+        std::vector<double> all;
+        long long lowest = std::numeric_limits<long long>::max();
+        long long highest = 0;
+        for (int c = 0; c < clients; c++) {
+            all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+            lowest = std::min(lowest, min_generation[c]);
+            highest = std::max(highest, max_generation[c]);
+        }
+        std::sort(all.begin(), all.end());
+        double mean = all.empty() ? 0.0 : std::accumulate(all.begin(), all.end(), 0.0) / all.size();
+        double p50 = all.empty() ? 0.0 : all[all.size() / 2];
+        double p99 = all.empty() ? 0.0 : all[static_cast<size_t>(all.size() * 0.99)];
+        double qps = all.size() / seconds;
+        long long generations_seen = highest >= lowest ? highest - lowest + 1 : 0;
+        bool reclaimed = first_alive.expired();
+        
+        results_file << workers << "," << clients << "," << all.size() << "," << qps << "," << mean << ","
+                     << p50 << "," << p99 << "," << swaps << "," << generations_seen << "," << failures << ","
+                     << (reclaimed ? 1 : 0) << "\n";
+        std::cout << workers << " trabajadores, " << clients << " clientes: " << qps << " consultas/s, "
+                  << "latencia media " << mean << " µs (p50 " << p50 << ", p99 " << p99 << "), "
+                  << swaps << " intercambios, " << generations_seen << " versiones vistas, " << failures
+                  << " fallas, índice inicial " << (reclaimed ? "liberado" : "todavía vivo") << std::endl;
+    }
     
-    double mean1 = std::accumulate(times1.begin(), times1.end(), 0.0) / times1.size();
-    double mean2 = std::accumulate(times2.begin(), times2.end(), 0.0) / times2.size();
+    results_file.close();
+    std::cout << "Resultados guardados en results/serve_results.csv" << std::endl;
+}
+
+#ifdef KDTREE_WITH_LLM
+// RAG contra un servidor de completions en `url`: las preguntas (títulos de
+// `queries_file`) se responden primero una por una y después todas a la vez por
+// el pipeline no bloqueante (recuperación de unas mientras se generan otras),
+// sin lotes y en lotes de 8 prompts por solicitud. Mide el tiempo de
+// recuperación, el del primer token (streaming) y el total por pregunta.
+void experimentRag(const MappedDatabase& database, const IndexConfig& config, const std::string& url,
+                   const std::string& queries_file) {
+    std::cout << "\n==== Experimento: RAG con el servidor LLM ====\n";
+    
+    const int num_questions = 32;
+    std::vector<std::string> questions = loadTitlesFromJsonl(queries_file, num_questions, database.getProcessedLines());
+    if (questions.empty() || database.getDimensions() != embedder.getDimension()) {
+        std::cerr << "No hay preguntas compatibles con la base en " << queries_file << std::endl;
+        return;
+    }
+    
+    std::shared_ptr<const Index> index = buildServingIndex(std::vector<DataItem>(), &database, config);
+    SearchService service(embedder, index, config.threads, config.search);
+    index.reset();
+    std::cout << questions.size() << " preguntas de " << queries_file << " sobre " << database.size()
+              << " documentos (" << config.engine << "), servidor " << url << std::endl;
     
-    double var1 = 0.0, var2 = 0.0;
-    for (const auto& t : times1) var1 += (t - mean1) * (t - mean1);
-    for (const auto& t : times2) var2 += (t - mean2) * (t - mean2);
-    var1 /= times1.size();
-    var2 /= times2.size();
+    struct Mode {
+        std::string name;
+        bool concurrent;
+        int batch;
+    };
+    std::vector<Mode> modes = {{"secuencial", false, 1}, {"concurrente", true, 1}, {"concurrente_lotes", true, 8}};
     
-    // Cálculo simplificado del estadístico t
-    double t_stat = std::abs(mean1 - mean2) / std::sqrt((var1 / times1.size()) + (var2 / times2.size()));
+    std::ofstream results_file("results/rag_results.csv");
+    results_file << "Mode,Batch,Questions,Errors,Seconds,Questions_per_s,Retrieval_ms,TTFT_ms_Mean,TTFT_ms_P50,"
+                    "Total_ms_Mean,Total_ms_P50,Total_ms_P99\n";
+    
+    for (const Mode& mode : modes) {
+        LLMClientOptions llm_options(url);
+        llm_options.stream = true;
+        llm_options.max_batch = mode.batch;
+        LLMClient llm(llm_options);
+        RagPipeline rag(service, llm);
+        
+        std::vector<RagAnswer> answers;
+        auto start = std::chrono::steady_clock::now();
+        if (mode.concurrent) {
+            std::vector<std::future<RagAnswer>> futures;
+            for (const auto& question : questions) {
+                futures.push_back(rag.ask(question));
+            }
+            for (auto& future : futures) {
+                answers.push_back(future.get());
+            }
+        } else {
+            for (const auto& question : questions) {
+                answers.push_back(rag.ask(question).get());
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        int errors = 0;
+        double retrieval = 0;
+        std::vector<double> ttft;
+        std::vector<double> total;
+        for (const auto& answer : answers) {
+            retrieval += answer.retrieval_ms;
+            if (!answer.llm.ok()) {
+                errors++;
+                continue;
+            }
+            ttft.push_back(answer.retrieval_ms + answer.llm.queue_ms + answer.llm.first_token_ms);
+            total.push_back(answer.total_ms);
+        }
+        if (errors > 0) {
+            for (const auto& answer : answers) {
+                if (!answer.llm.ok()) {
+                    std::cerr << "  " << answer.llm.error << std::endl;
+                    break;
+                }
+            }
+        }
+        std::sort(ttft.begin(), ttft.end());
+        std::sort(total.begin(), total.end());
+        double ttft_mean = ttft.empty() ? 0.0 : std::accumulate(ttft.begin(), ttft.end(), 0.0) / ttft.size();
+        double total_mean = total.empty() ? 0.0 : std::accumulate(total.begin(), total.end(), 0.0) / total.size();
+        double ttft_p50 = ttft.empty() ? 0.0 : ttft[ttft.size() / 2];
+        double total_p50 = total.empty() ? 0.0 : total[total.size() / 2];
+        double total_p99 = total.empty() ? 0.0 : total[static_cast<size_t>(total.size() * 0.99)];
+        
+        results_file << mode.name << "," << mode.batch << "," << answers.size() << "," << errors << "," << seconds
+                     << "," << answers.size() / seconds << "," << retrieval / answers.size() << "," << ttft_mean
+                     << "," << ttft_p50 << "," << total_mean << "," << total_p50 << "," << total_p99 << "\n";
+        std::cout << mode.name << " (lotes de " << mode.batch << "): " << answers.size() / seconds
+                  << " preguntas/s, recuperación " << retrieval / answers.size() << " ms, primer token "
+                  << ttft_mean << " ms (p50 " << ttft_p50 << "), total " << total_mean << " ms (p99 " << total_p99
+                  << "), " << errors << " errores" << std::endl;
+    }
     
-    // Valor crítico aproximado para 95% de confianza
-    double critical_value = 1.96;
+    results_file.close();
+    std::cout << "Resultados guardados en results/rag_results.csv" << std::endl;
+}
+#endif
+
+// Servir la base (normalmente un archivo de --partition) como shard de un
+// coordinador remoto, con el motor de --shard-engine, hasta que se corte el
+// proceso
+void serveShard(const MappedDatabase& database, const IndexConfig& config, int port) {
+    std::string shard_engine = config.shard.engine == "sharded" ? "kdtree" : config.shard.engine;
+    std::unique_ptr<Index> index = createIndex(shard_engine, config, config.leaf_size);
+    auto build_start = std::chrono::high_resolution_clock::now();
+    index->build(database);
+    auto build_end = std::chrono::high_resolution_clock::now();
+    std::cout << index->name() << " construido en "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(build_end - build_start).count()
+              << " ms sobre " << index->size() << " documentos" << std::endl;
     
-    return t_stat > critical_value;
+    ShardServer server(*index, database.getDimensions());
+    if (!server.listen(port)) {
+        return;
+    }
+    std::cout << "Shard escuchando en el puerto " << port << " (GET /info, POST /knn, POST /text)" << std::endl;
+    server.run();
 }
 
 // Modo interactivo mejorado
-void interactiveMode(const std::vector<DataItem>& database) {
+// Con `mapped` los índices se construyen sobre la base mapeada (sin copiar las
+// filas en los motores que lo permiten) y `database` puede venir vacío
+void interactiveMode(const std::vector<DataItem>& database, const MappedDatabase* mapped,
+                     const IndexConfig& config) {
     std::cout << "\n==== Modo Interactivo de Búsqueda Semántica ====\n";
-    std::cout << "Base de datos cargada con " << database.size() << " elementos.\n";
+    std::cout << "Base de datos cargada con " << (mapped ? mapped->size() : database.size())
+              << " elementos" << (mapped ? " (mapeada)" : "") << ".\n";
     
-    // Construir árbol KD (puedes ajustar el tamaño de hoja según tus experimentos)
-    int leaf_size = 10; // Valor por defecto, podría ser ajustable
+    // Construir el motor elegido (el tamaño de hoja se elige con --leaf-size)
+    int leaf_size = config.leaf_size;
     
-    std::cout << "Construyendo árbol KD (leaf_size = " << leaf_size << ")..." << std::endl;
+    std::unique_ptr<Index> index = createIndex(config.engine, config, leaf_size);
+    std::cout << "Construyendo " << index->name() << " (leaf_size = " << leaf_size << ", tipo = "
+              << elementTypeName(config.element_type) << ", métrica = " << metricName(config.metric) << ")..."
+              << std::endl;
     auto build_start = std::chrono::high_resolution_clock::now();
-    KDTree tree(database, leaf_size);
+    if (mapped) {
+        index->build(*mapped);
+    } else {
+        index->build(database);
+    }
     auto build_end = std::chrono::high_resolution_clock::now();
     auto build_time = std::chrono::duration_cast<std::chrono::milliseconds>(build_end - build_start).count();
-    std::cout << "Árbol KD construido en " << build_time << " ms\n";
+    std::cout << index->name() << " construido en " << build_time << " ms (memoria: "
+              << index->memoryBytes() / 1024 << " KB)\n";
     
     // Inicializar búsqueda lineal
-    LinearSearch linear(database);
+    LinearIndex linear(config.element_type, config.metric);
+    if (mapped) {
+        linear.build(*mapped);
+    } else {
+        linear.build(database);
+    }
     
+    // Las consultas repetidas (mismo texto normalizado) salen de la caché sin
+    // embedding ni búsqueda; el índice no cambia en este modo (versión 0)
+    QueryCache cache(config.cache_entries);
+    const int k = 5;
+    
+    Point query_embedding;
+    std::vector<Neighbor> top_results;
+    std::vector<Neighbor> linear_results;
     while (true) {
         std::cout << "\nIngrese su consulta (o 'salir' para terminar): ";
         std::string query;
@@ -327,48 +1476,81 @@ void interactiveMode(const std::vector<DataItem>& database) {
             continue;
         }
         
-        // Generar embedding para la consulta usando nuestro modelo
-        Point query_embedding = embedder.getEmbedding(query);
+        auto cache_start = std::chrono::high_resolution_clock::now();
+        std::string key = QueryCache::normalize(query);
+        if (cache.lookup(key, k, 0, top_results)) {
+            auto cache_end = std::chrono::high_resolution_clock::now();
+            auto cache_time = std::chrono::duration_cast<std::chrono::microseconds>(cache_end - cache_start).count();
+            std::cout << "\n=== Resultados de la búsqueda (caché) ===\n";
+            std::cout << "Consulta: \"" << query << "\" (respondida desde la caché en " << cache_time << " µs; "
+                      << cache.getHits() << " aciertos de " << cache.getHits() + cache.getMisses() << " consultas)\n";
+            std::cout << "\nResultados de " << index->name() << " (top " << k << "):\n";
+            for (size_t i = 0; i < top_results.size(); i++) {
+                std::cout << (i+1) << ". Distancia: " << top_results[i].first
+                          << "\n   Texto: " << index->text(top_results[i].second) << "\n";
+            }
+            continue;
+        }
         
-        // Búsqueda con árbol KD
+        // Generar embedding para la consulta usando nuestro modelo, en el
+        // mismo vector en cada consulta
+        auto embed_start = std::chrono::high_resolution_clock::now();
+        embedder.getEmbedding(query, query_embedding);
+        auto embed_end = std::chrono::high_resolution_clock::now();
+        auto embed_time = std::chrono::duration_cast<std::chrono::microseconds>(embed_end - embed_start).count();
+        
+        // Búsqueda con el motor elegido: un solo recorrido da el top-1 y el top-k
         auto kd_start = std::chrono::high_resolution_clock::now();
-        auto kd_result = tree.nearest(query_embedding);
+        top_results = index->kNearest(query_embedding, k, config.search);
         auto kd_end = std::chrono::high_resolution_clock::now();
         auto kd_time = std::chrono::duration_cast<std::chrono::microseconds>(kd_end - kd_start).count();
         
-        // Búsqueda lineal
+        // Búsqueda lineal (también la referencia del recall)
         auto linear_start = std::chrono::high_resolution_clock::now();
-        auto linear_result = linear.nearest(query_embedding);
+        linear_results = linear.kNearest(query_embedding, k);
         auto linear_end = std::chrono::high_resolution_clock::now();
         auto linear_time = std::chrono::duration_cast<std::chrono::microseconds>(linear_end - linear_start).count();
         
+        cache.store(key, k, 0, top_results);
+        if (top_results.empty() || linear_results.empty()) {
+            std::cout << "Sin resultados: la base está vacía\n";
+            continue;
+        }
+        
         // Mostrar resultados
         std::cout << "\n=== Resultados de la búsqueda ===\n";
-        std::cout << "Consulta: \"" << query << "\"\n\n";
+        std::cout << "Consulta: \"" << query << "\" (embedding: " << embed_time << " µs)\n\n";
         
-        // Resultado del árbol KD
-        std::cout << "Resultado del árbol KD (tiempo: " << kd_time << " µs):\n";
-        std::cout << "Distancia: " << kd_result.first << "\n";
-        std::cout << "Texto: " << kd_result.second << "\n\n";
+        // Resultado del motor elegido
+        std::cout << "Resultado de " << index->name() << " (tiempo: " << kd_time << " µs):\n";
+        std::cout << "Distancia: " << top_results[0].first << "\n";
+        std::cout << "Texto: " << index->text(top_results[0].second) << "\n\n";
         
         // Resultado de búsqueda lineal
         std::cout << "Resultado de búsqueda lineal (tiempo: " << linear_time << " µs):\n";
-        std::cout << "Distancia: " << linear_result.first << "\n";
-        std::cout << "Texto: " << linear_result.second << "\n\n";
+        std::cout << "Distancia: " << linear_results[0].first << "\n";
+        std::cout << "Texto: " << linear.text(linear_results[0].second) << "\n\n";
         
         // Comparación de rendimiento
-        double speedup = static_cast<double>(linear_time) / kd_time;
+        double speedup = static_cast<double>(linear_time) / std::max<long long>(kd_time, 1);
         std::cout << "Comparación de rendimiento:\n";
-        std::cout << "- Árbol KD: " << kd_time << " µs\n";
+        std::cout << "- " << index->name() << ": " << kd_time << " µs\n";
         std::cout << "- Búsqueda lineal: " << linear_time << " µs\n";
         std::cout << "- Aceleración: " << speedup << "x\n";
         
-        // Mostrar top 3 resultados
-        std::cout << "\nResultados adicionales (top 5):\n";
-        auto top_results = tree.kNearest(query_embedding, 5);
+        // Mostrar los demás del mismo recorrido
+        std::cout << "\nResultados adicionales (top " << k << "):\n";
         for (size_t i = 0; i < top_results.size(); i++) {
             std::cout << (i+1) << ". Distancia: " << top_results[i].first 
-                      << "\n   Texto: " << top_results[i].second << "\n";
+                      << "\n   Texto: " << index->text(top_results[i].second) << "\n";
+        }
+        
+        // En modo aproximado, informar el recall contra la búsqueda exacta
+        if (!config.search.isExact() || config.engine == "forest" || config.engine == "hnsw" ||
+            config.engine == "ivfpq") {
+            double recall = computeRecall(top_results, linear_results);
+            std::cout << "Recall@" << k << " (max_checks = " << config.search.max_checks << ", eps = "
+                      << config.search.epsilon << ", ef = " << config.search.ef << "): " << recall << "\n";
         }
     }
 }
@@ -384,8 +1566,26 @@ int main(int argc, char* argv[]) {
     bool interactive = false;
     bool exp_db_size = false;
     bool exp_leaf_size = false;
+    bool exp_batch = false;
+    bool exp_approx = false;
+    bool exp_forest = false;
+    double duplicates_radius = -1.0;
+    bool exp_dynamic = false;
+    bool exp_serve = false;
+    int serve_threads = -1;
+    bool exp_engines = false;
+    bool exp_recall = false;
+    std::string rag_url = "";
+    bool exp_shards = false;
+    std::string partition_prefix = "";
+    int shard_port = -1;
+    std::string queries_file = "";
     std::string filename = "";
+    std::string save_filename = "";
+    bool save_tree = false;
     int max_lines = -1;
+    std::string token_cache_file = "";
+    IndexConfig config;
     
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -399,12 +1599,276 @@ int main(int argc, char* argv[]) {
         else if (arg == "--exp-leaf-size" || arg == "-l") {
             exp_leaf_size = true;
         }
+        else if (arg == "--exp-batch" || arg == "-b") {
+            exp_batch = true;
+        }
+        else if (arg == "--exp-approx" || arg == "-a") {
+            exp_approx = true;
+        }
+        else if (arg == "--exp-forest" || arg == "-f") {
+            exp_forest = true;
+        }
+        else if (arg == "--serve" || arg == "-S") {
+            if (i + 1 < argc) {
+                serve_threads = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--exp-serve" || arg == "-z") {
+            exp_serve = true;
+        }
+        else if (arg == "--exp-dynamic" || arg == "-y") {
+            exp_dynamic = true;
+        }
+        else if (arg == "--duplicates" || arg == "-D") {
+            if (i + 1 < argc) {
+                duplicates_radius = std::stod(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--exp-engines" || arg == "-x") {
+            exp_engines = true;
+        }
+        else if (arg == "--exp-recall" || arg == "-R") {
+            // Archivo de consultas opcional: títulos de un JSONL
+            exp_recall = true;
+            if (i + 1 < argc && std::string(argv[i + 1]).find(".jsonl") != std::string::npos) {
+                queries_file = argv[i + 1];
+                i++;
+            }
+        }
+        else if (arg == "--exp-rag") {
+            // URL del endpoint de completions; las preguntas salen del mismo archivo que --exp-recall
+            if (i + 1 < argc) {
+                rag_url = argv[i + 1];
+                i++;
+            }
+#ifndef KDTREE_WITH_LLM
+            std::cerr << "--exp-rag necesita compilar con LLM=1 (libcurl)" << std::endl;
+            return 1;
+#endif
+        }
+        else if (arg == "--engine" || arg == "-n") {
+            if (i + 1 < argc) {
+                config.engine = argv[i + 1];
+                if (!createIndex(config.engine, config, 1)) {
+                    std::cerr << "Motor desconocido: " << argv[i + 1]
+                              << " (use kdtree, forest, hnsw, ivfpq, linear, dynamic o sharded)" << std::endl;
+                    return 1;
+                }
+                i++;
+            }
+        }
+        else if (arg == "--trees") {
+            if (i + 1 < argc) {
+                config.forest_trees = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--hnsw-m" || arg == "-M") {
+            if (i + 1 < argc) {
+                config.hnsw.M = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--ef-construction" || arg == "-C") {
+            if (i + 1 < argc) {
+                config.hnsw.ef_construction = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--ef-search" || arg == "-s") {
+            if (i + 1 < argc) {
+                config.hnsw.ef_search = std::stoi(argv[i + 1]);
+                config.search.ef = config.hnsw.ef_search;
+                i++;
+            }
+        }
+        else if (arg == "--nlist") {
+            if (i + 1 < argc) {
+                config.ivfpq.nlist = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--pq-m") {
+            if (i + 1 < argc) {
+                config.ivfpq.m = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--nprobe") {
+            if (i + 1 < argc) {
+                config.ivfpq.nprobe = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--pq-precompute") {
+            // Términos por lista del IVF-PQ (nlist * m * 256 floats, ver IVFPQOptions)
+            config.ivfpq.precompute = true;
+        }
+        else if (arg == "--query-cache") {
+            // Respuestas en caché del modo interactivo y del servicio (0 = sin caché)
+            if (i + 1 < argc) {
+                config.cache_entries = static_cast<size_t>(std::max(0, std::stoi(argv[i + 1])));
+                i++;
+            }
+        }
+        else if (arg == "--shards") {
+            if (i + 1 < argc) {
+                config.shard.shards = std::max(1, std::stoi(argv[i + 1]));
+                i++;
+            }
+        }
+        else if (arg == "--routing") {
+            if (i + 1 < argc) {
+                if (!parseShardRouting(argv[i + 1], config.shard.routing)) {
+                    std::cerr << "Reparto desconocido: " << argv[i + 1] << " (use hash o kmeans)" << std::endl;
+                    return 1;
+                }
+                i++;
+            }
+        }
+        else if (arg == "--shard-probe") {
+            // Shards visitados por consulta con --routing kmeans (0 = todos)
+            if (i + 1 < argc) {
+                config.shard.probe = std::max(0, std::stoi(argv[i + 1]));
+                i++;
+            }
+        }
+        else if (arg == "--shard-timeout") {
+            // Límite de espera por shard remoto en ms (0 = sin límite)
+            if (i + 1 < argc) {
+                config.shard.timeout_ms = std::max(0, std::stoi(argv[i + 1]));
+                i++;
+            }
+        }
+        else if (arg == "--shard-engine") {
+            if (i + 1 < argc) {
+                config.shard.engine = argv[i + 1];
+                if (config.shard.engine == "sharded" || !createIndex(config.shard.engine, config, 1)) {
+                    std::cerr << "Motor de shard desconocido: " << argv[i + 1]
+                              << " (use kdtree, forest, hnsw, ivfpq, linear o dynamic)" << std::endl;
+                    return 1;
+                }
+                i++;
+            }
+        }
+        else if (arg == "--partition") {
+            // Escribir PREFIJO.shardN.kdv y PREFIJO.shards con --shards y --routing
+            if (i + 1 < argc) {
+                partition_prefix = argv[i + 1];
+                i++;
+            }
+        }
+        else if (arg == "--serve-shard") {
+            if (i + 1 < argc) {
+                shard_port = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--coordinator") {
+            // Reparto de --partition y URLs de los shards separadas por comas
+            if (i + 2 < argc) {
+                config.shard_map = argv[i + 1];
+                std::stringstream urls(argv[i + 2]);
+                std::string url;
+                while (std::getline(urls, url, ',')) {
+                    if (!url.empty()) {
+                        config.shard_urls.push_back(url);
+                    }
+                }
+                i += 2;
+            }
+#ifndef KDTREE_WITH_HTTP
+            std::cerr << "--coordinator necesita compilar con HTTP=1 (libcurl)" << std::endl;
+            return 1;
+#endif
+        }
+        else if (arg == "--exp-shards") {
+            // Mismo archivo de consultas opcional que --exp-recall
+            exp_shards = true;
+            if (i + 1 < argc && std::string(argv[i + 1]).find(".jsonl") != std::string::npos) {
+                queries_file = argv[i + 1];
+                i++;
+            }
+        }
+        else if (arg == "--max-checks" || arg == "-c") {
+            if (i + 1 < argc) {
+                config.search.max_checks = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--epsilon" || arg == "-e") {
+            if (i + 1 < argc) {
+                config.search.epsilon = std::stod(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--threads" || arg == "-j") {
+            if (i + 1 < argc) {
+                config.threads = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--save" || arg == "-o") {
+            if (i + 1 < argc) {
+                save_filename = argv[i + 1];
+                i++;
+            }
+        }
+        else if (arg == "--with-tree" || arg == "-w") {
+            save_tree = true;
+        }
+        else if (arg == "--leaf-size" || arg == "-L") {
+            if (i + 1 < argc) {
+                config.leaf_size = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (arg == "--token-cache") {
+            if (i + 1 < argc) {
+                token_cache_file = argv[i + 1];
+                i++;
+            }
+        }
+        else if (arg == "--token-cache-size") {
+            if (i + 1 < argc) {
+                embedder.getCache().setCapacity(std::stoul(argv[i + 1]));
+                i++;
+            }
+        }
         else if (arg == "--max-lines" || arg == "-m") {
             if (i + 1 < argc) {
                 max_lines = std::stoi(argv[i + 1]);
                 i++;
             }
         }
+        else if (arg == "--dtype" || arg == "-t") {
+            if (i + 1 < argc) {
+                if (!parseElementType(argv[i + 1], config.element_type)) {
+                    std::cerr << "Tipo de elemento desconocido: " << argv[i + 1]
+                              << " (use f64, f32 o int8)" << std::endl;
+                    return 1;
+                }
+                i++;
+            }
+        }
+        else if (arg == "--metric" || arg == "-g") {
+            if (i + 1 < argc) {
+                if (!parseMetric(argv[i + 1], config.metric)) {
+                    std::cerr << "Métrica desconocida: " << argv[i + 1]
+                              << " (use l2, ip o cosine)" << std::endl;
+                    return 1;
+                }
+                i++;
+            }
+        }
+        else if (arg == "--rerank" || arg == "-r") {
+            if (i + 1 < argc) {
+                config.rerank = std::stoi(argv[i + 1]);
+                i++;
+            }
+        }
         else if (arg[0] != '-') {
             filename = arg;
         }
@@ -413,21 +1877,65 @@ int main(int argc, char* argv[]) {
     // Usado para generación determinista de embeddings
     std::cout << "Usando generador de embeddings determinístico..." << std::endl;
     
+    bool run_experiments = exp_db_size || exp_leaf_size || exp_batch || exp_approx || exp_forest || exp_engines ||
+                           exp_dynamic || exp_serve || exp_recall || !rag_url.empty() || exp_shards ||
+                           !partition_prefix.empty() || duplicates_radius >= 0;
+    
+    // Tabla de vectores de token: se carga antes de embeber nada y, si no
+    // existía, se precalcula con los textos de la base
+    bool token_cache_loaded = !token_cache_file.empty() && embedder.loadTokenCache(token_cache_file);
+    size_t token_cache_start = embedder.getCache().size();
+    
     // Cargar o generar la base de datos
     std::vector<DataItem> database;
+    MappedDatabase mapped;
     
-    if (filename.empty()) {
-        std::cout << "No se proporcionó archivo. Generando base de datos de prueba." << std::endl;
-        database = generateMockDatabase(1000, 384);
-    } else {
-        // Determinar el tipo de archivo por extensión
-        if (filename.substr(filename.find_last_of(".") + 1) == "jsonl") {
-            std::cout << "Cargando archivo JSONL: " << filename << std::endl;
-            database = loadDatabaseFromJsonl(filename, max_lines);
+    // Un JSONL se ingiere en streaming al formato mapeable (por defecto
+    // processed_database.bin) y después se usa mapeado como cualquier base
+    bool from_jsonl = !filename.empty() && filename.substr(filename.find_last_of(".") + 1) == "jsonl";
+    std::string database_file = filename;
+    if (from_jsonl && save_filename == filename) {
+        std::cerr << "Error: --save no puede sobrescribir el archivo de entrada" << std::endl;
+        database_file.clear();
+    } else if (from_jsonl) {
+        database_file = save_filename.empty() ? "processed_database.bin" : save_filename;
+        std::cout << "Procesando archivo JSONL: " << filename << " -> " << database_file << std::endl;
+        if (!ingestJsonlToFile(filename, database_file, max_lines, config.threads)) {
+            database_file.clear();
+        } else if (save_tree && mapped.open(database_file)) {
+            // Con --with-tree se agrega un árbol KD construido sobre la base, que
+            // el modo interactivo carga sin reconstruir
+            std::cout << "Construyendo árbol KD para guardar (leaf_size = " << config.leaf_size << ", tipo = "
+                      << elementTypeName(config.element_type) << ")..." << std::endl;
+            // Sobre las filas mapeadas, sin copiar la base a DataItem (serialize no usa los textos)
+            KDTree tree(mapped, treeOptions(config, config.leaf_size));
+            mapped.close();
+            appendTreeSection(database_file, [&tree](uint64_t checksum) { return tree.serialize(checksum); });
+        }
+    }
+    
+    if (!database_file.empty() && MappedDatabase::isDatabaseFile(database_file)) {
+        // Formato mapeable: abrir es O(1); los DataItem solo se copian si
+        // hacen falta (experimentos o guardar en otro archivo)
+        std::cout << "Mapeando archivo binario: " << database_file << std::endl;
+        if (mapped.open(database_file)) {
+            std::cout << "Base de datos mapeada con " << mapped.size() << " elementos de dimensión "
+                      << mapped.getDimensions() << " (" << elementTypeName(mapped.getElementType()) << ")"
+                      << std::endl;
+            if (run_experiments || (!save_filename.empty() && !from_jsonl)) {
+                database = mapped.toDataItems();
+            }
         } else {
-            std::cout << "Intentando cargar archivo binario: " << filename << std::endl;
-            database = loadDatabase(filename);
+            std::cout << "No se pudo cargar la base de datos. Generando base de datos de prueba." << std::endl;
+            database = generateMockDatabase(1000, 384);
         }
+    } else if (database_file.empty()) {
+        std::cout << (from_jsonl ? "No se pudo procesar el JSONL" : "No se proporcionó archivo")
+                  << ". Generando base de datos de prueba." << std::endl;
+        database = generateMockDatabase(1000, 384);
+    } else {
+        std::cout << "Intentando cargar archivo binario: " << filename << std::endl;
+        database = loadDatabase(filename);
         
         // Si no se pudo cargar, generar una base de datos de prueba
         if (database.empty()) {
@@ -436,23 +1944,122 @@ int main(int argc, char* argv[]) {
         }
     }
     
-    // Guardar la base de datos procesada en formato binario si viene de JSONL
-    if (!filename.empty() && filename.substr(filename.find_last_of(".") + 1) == "jsonl") {
-        std::cout << "Guardando base de datos procesada en formato binario..." << std::endl;
-        saveDatabase(database, "processed_database.bin", max_lines);
+    // Una base que no viene del formato mapeable (formato antiguo o de prueba)
+    // pasa a un almacén en memoria con el mismo formato, así el resto sigue el
+    // mismo camino que un archivo mapeado: una sola copia que los motores usan
+    // como vista, y DataItem solo para los experimentos o guardar
+    if (!mapped.isOpen() && !database.empty()) {
+        mapped.assign(database, ElementType::Float64, max_lines);
+        if (run_experiments || !save_filename.empty()) {
+            database = mapped.toDataItems();
+        }
+    }
+    
+    if (!token_cache_file.empty()) {
+        if (!token_cache_loaded && !from_jsonl) {
+            int count = mapped.isOpen() ? mapped.size() : static_cast<int>(database.size());
+            ThreadPool::global().parallelFor(count, ThreadPool::hardwareThreads(), [&](int i) {
+                embedder.precompute(mapped.isOpen() ? mapped.text(i) : database[i].text);
+            });
+        }
+        if (embedder.getCache().size() > token_cache_start) {
+            embedder.saveTokenCache(token_cache_file);
+        }
+    }
+    
+    // Convertir la base cargada (p. ej. del formato anterior) al formato mapeable,
+    // con --with-tree junto a un árbol KD que el modo interactivo carga sin reconstruir
+    if (!save_filename.empty() && !from_jsonl) {
+        if (save_filename == filename) {
+            std::cerr << "Error: --save no puede sobrescribir el archivo de entrada" << std::endl;
+        } else {
+            std::unique_ptr<KDTree> saved_tree;
+            if (save_tree) {
+                std::cout << "Construyendo árbol KD para guardar (leaf_size = " << config.leaf_size << ", tipo = "
+                          << elementTypeName(config.element_type) << ")..." << std::endl;
+                saved_tree.reset(new KDTree(database, treeOptions(config, config.leaf_size)));
+            }
+            saveDatabase(database, save_filename, mapped.isOpen() ? mapped.getProcessedLines() : max_lines,
+                         saved_tree.get());
+        }
     }
     
     // Ejecutar experimentos o modo interactivo según se solicite
     if (exp_db_size) {
-        experimentDatabaseSize(database);
+        experimentDatabaseSize(mapped, config);
     }
     
     if (exp_leaf_size) {
-        experimentLeafSize(database);
+        experimentLeafSize(database, config);
+    }
+    
+    if (exp_batch) {
+        experimentBatch(database, config);
+    }
+    
+    if (exp_approx) {
+        experimentApproximate(database, config);
+    }
+    
+    if (exp_forest) {
+        experimentForest(database, config);
+    }
+    
+    if (exp_engines) {
+        experimentEngines(database, config);
+    }
+    
+    // Sin archivo: los títulos del JSONL de entrada o los de data/wikihow2.jsonl
+    if (queries_file.empty()) {
+        queries_file = from_jsonl ? filename : "data/wikihow2.jsonl";
+    }
+    
+    if (exp_recall) {
+        experimentRecall(mapped, config, queries_file);
+    }
+    
+    if (!partition_prefix.empty()) {
+        ShardMap map = ShardMap::assign(DatabaseRows{mapped, 0, mapped.size()}, config.shard, config.threads);
+        if (writeShardFiles(mapped, map, partition_prefix)) {
+            std::cout << "Base repartida en " << map.shardCount() << " shards ("
+                      << shardRoutingName(map.getRouting()) << "):";
+            for (int s = 0; s < map.shardCount(); s++) {
+                std::cout << " " << shardFileName(partition_prefix, s) << " (" << map.shardMembers(s).size() << ")";
+            }
+            std::cout << ", reparto en " << shardMapFileName(partition_prefix) << std::endl;
+        } else {
+            std::cerr << "Error al escribir los shards " << partition_prefix << std::endl;
+        }
+    }
+    
+    if (exp_shards) {
+        experimentShards(mapped, config, queries_file);
+    }
+    
+#ifdef KDTREE_WITH_LLM
+    if (!rag_url.empty()) {
+        experimentRag(mapped, config, rag_url, queries_file);
+    }
+#endif
+    
+    if (exp_dynamic) {
+        experimentDynamic(database, config);
+    }
+    
+    if (duplicates_radius >= 0) {
+        experimentDuplicates(database, config, duplicates_radius);
+    }
+    
+    if (exp_serve) {
+        experimentServe(database, config);
     }
     
-    if (interactive || (!exp_db_size && !exp_leaf_size)) {
-        interactiveMode(database);
+    if (shard_port >= 0) {
+        serveShard(mapped, config, shard_port);
+    } else if (serve_threads >= 0) {
+        serveMode(database, mapped.isOpen() ? &mapped : nullptr, config, serve_threads);
+    } else if (interactive || !run_experiments) {
+        interactiveMode(database, mapped.isOpen() ? &mapped : nullptr, config);
     }
     
     return 0;